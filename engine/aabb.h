@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vector.h"
+
+// axis aligned bounding box, lower <= upper on every axis
+struct aabb
+{
+	vector3 lower;
+	vector3 upper;
+
+	// touching counts as overlapping
+	bool Overlaps(const aabb& b) const
+	{
+		return lower.x <= b.upper.x && b.lower.x <= upper.x
+			&& lower.y <= b.upper.y && b.lower.y <= upper.y
+			&& lower.z <= b.upper.z && b.lower.z <= upper.z;
+	}
+	bool Contains(const aabb& b) const
+	{
+		return lower.x <= b.lower.x && lower.y <= b.lower.y && lower.z <= b.lower.z
+			&& b.upper.x <= upper.x && b.upper.y <= upper.y && b.upper.z <= upper.z;
+	}
+	aabb Union(const aabb& b) const
+	{
+		aabb result;
+		result.lower = vector3(lower.x < b.lower.x ? lower.x : b.lower.x, lower.y < b.lower.y ? lower.y : b.lower.y, lower.z < b.lower.z ? lower.z : b.lower.z);
+		result.upper = vector3(upper.x > b.upper.x ? upper.x : b.upper.x, upper.y > b.upper.y ? upper.y : b.upper.y, upper.z > b.upper.z ? upper.z : b.upper.z);
+		return result;
+	}
+	aabb Expanded(float margin) const
+	{
+		return { lower - vector3(margin), upper + vector3(margin) };
+	}
+	// half the surface area, only ever used to compare boxes
+	float GetCost() const
+	{
+		const vector3 d = upper - lower;
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+	// true if the segment from + (to - from) * t for t in [0, maxFraction] passes through the box (slab test)
+	bool IntersectsSegment(const vector3& from, const vector3& to, float maxFraction) const
+	{
+		const float start[3] = { from.x, from.y, from.z };
+		const float dir[3] = { to.x - from.x, to.y - from.y, to.z - from.z };
+		const float lo[3] = { lower.x, lower.y, lower.z };
+		const float hi[3] = { upper.x, upper.y, upper.z };
+		float tMin = 0.0f;
+		float tMax = maxFraction;
+		for (int i = 0; i < 3; i++)
+		{
+			if (dir[i] == 0.0f)
+			{
+				// parallel, it has to start inside the slab
+				if (start[i] < lo[i] || start[i] > hi[i])
+					return false;
+				continue;
+			}
+			const float inv = 1.0f / dir[i];
+			float t1 = (lo[i] - start[i]) * inv;
+			float t2 = (hi[i] - start[i]) * inv;
+			if (t1 > t2)
+			{
+				const float t = t1;
+				t1 = t2;
+				t2 = t;
+			}
+			tMin = t1 > tMin ? t1 : tMin;
+			tMax = t2 < tMax ? t2 : tMax;
+			if (tMin > tMax)
+				return false;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,428 @@
+#include "aabb_tree.h"
+#include "lib.h"
+#include <algorithm>
+
+// deep enough for any tree balanced to within one level (about 1.44 * log2 of the node count)
+static constexpr int AABB_TREE_STACK_SIZE = 256;
+
+//******************************************************************************
+AABBTree::AABBTree()
+{
+	m_nodes.reserve(64);
+}
+//******************************************************************************
+int AABBTree::AllocateNode()
+{
+	if (m_freeList < 0)
+	{
+		m_nodes.emplace_back();
+		return (int)m_nodes.size() - 1;
+	}
+	const int node = m_freeList;
+	m_freeList = m_nodes[node].parent;
+	m_nodes[node] = Node();
+	return node;
+}
+//******************************************************************************
+void AABBTree::FreeNode(int node)
+{
+	m_nodes[node].parent = m_freeList;
+	m_nodes[node].height = -1;
+	m_nodes[node].userData = nullptr;
+	m_freeList = node;
+}
+//******************************************************************************
+int AABBTree::AddProxy(const aabb& box, void* userData)
+{
+	const int leaf = AllocateNode();
+	Node& n = m_nodes[leaf];
+	n.fat = box.Expanded(AABB_TREE_MARGIN);
+	n.box = box;
+	n.userData = userData;
+	n.height = 0;
+	InsertLeaf(leaf);
+	MarkMoved(leaf);
+	return leaf;
+}
+//******************************************************************************
+void AABBTree::RemoveProxy(int proxy)
+{
+	assert(m_nodes[proxy].IsLeaf() && m_nodes[proxy].height == 0);
+	RemoveLeaf(proxy);
+	m_nodes[proxy].userData = nullptr;
+	m_nodes[proxy].height = -1;
+	// keep the id out of the free list until Update has reported its pairs as removed
+	m_removedProxies.push_back(proxy);
+}
+//******************************************************************************
+void AABBTree::MoveProxy(int proxy, const aabb& box)
+{
+	Node& n = m_nodes[proxy];
+	assert(n.IsLeaf() && n.height == 0);
+	n.box = box;
+	if (n.fat.Contains(box))
+	{
+		return; // still inside its margin, the tree doesn't need to know
+	}
+	RemoveLeaf(proxy);
+	m_nodes[proxy].fat = box.Expanded(AABB_TREE_MARGIN);
+	InsertLeaf(proxy);
+	MarkMoved(proxy);
+}
+//******************************************************************************
+void AABBTree::MarkMoved(int leaf)
+{
+	if (!m_nodes[leaf].moved)
+	{
+		m_nodes[leaf].moved = true;
+		m_moved.push_back(leaf);
+	}
+}
+//******************************************************************************
+void AABBTree::InsertLeaf(int leaf)
+{
+	if (m_root < 0)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = -1;
+		return;
+	}
+
+	// walk down to the sibling that costs the least: the new parent's area, plus what every
+	// ancestor grows by to hold the leaf (see Box2D's b2DynamicTree)
+	const aabb leafBox = m_nodes[leaf].fat;
+	int index = m_root;
+	while (!m_nodes[index].IsLeaf())
+	{
+		const Node& node = m_nodes[index];
+		const float cost = node.fat.Union(leafBox).GetCost();
+		const float parentCost = 2.0f * cost;                      // making a new parent for node and leaf here
+		const float inheritanceCost = 2.0f * (cost - node.fat.GetCost()); // what pushing the leaf further down adds at this level
+
+		float childCosts[2];
+		const int children[2] = { node.child1, node.child2 };
+		for (int i = 0; i < 2; i++)
+		{
+			const Node& child = m_nodes[children[i]];
+			const float grown = child.fat.Union(leafBox).GetCost();
+			childCosts[i] = (child.IsLeaf() ? grown : grown - child.fat.GetCost()) + inheritanceCost;
+		}
+
+		if (parentCost < childCosts[0] && parentCost < childCosts[1])
+		{
+			break;
+		}
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+
+	// put a new parent above the sibling holding both of them
+	const int sibling = index;
+	const int oldParent = m_nodes[sibling].parent;
+	const int newParent = AllocateNode();
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].fat = m_nodes[sibling].fat.Union(leafBox);
+	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].child1 = sibling;
+	m_nodes[newParent].child2 = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+	if (oldParent < 0)
+	{
+		m_root = newParent;
+	}
+	else if (m_nodes[oldParent].child1 == sibling)
+	{
+		m_nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		m_nodes[oldParent].child2 = newParent;
+	}
+
+	FixUpwards(newParent);
+}
+//******************************************************************************
+void AABBTree::RemoveLeaf(int leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = -1;
+		return;
+	}
+
+	// the sibling takes the parent's place
+	const int parent = m_nodes[leaf].parent;
+	const int grandParent = m_nodes[parent].parent;
+	const int sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+	m_nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+	m_nodes[leaf].parent = -1;
+	if (grandParent < 0)
+	{
+		m_root = sibling;
+		return;
+	}
+	if (m_nodes[grandParent].child1 == parent)
+	{
+		m_nodes[grandParent].child1 = sibling;
+	}
+	else
+	{
+		m_nodes[grandParent].child2 = sibling;
+	}
+	FixUpwards(grandParent);
+}
+//******************************************************************************
+void AABBTree::FixUpwards(int node)
+{
+	while (node >= 0)
+	{
+		node = Balance(node);
+		Node& n = m_nodes[node];
+		const Node& c1 = m_nodes[n.child1];
+		const Node& c2 = m_nodes[n.child2];
+		n.height = 1 + max(c1.height, c2.height);
+		n.fat = c1.fat.Union(c2.fat);
+		node = n.parent;
+	}
+}
+//******************************************************************************
+// If one child of a is more than one level taller than the other, rotate the taller child up into
+// a's place.  It keeps its own taller child, its shorter child goes to a in its place, and a becomes
+// its other child.  Same as the rotations in an AVL tree, so the heights stay within one of each other.
+int AABBTree::Balance(int a)
+{
+	Node& A = m_nodes[a];
+	if (A.IsLeaf() || A.height < 2)
+	{
+		return a;
+	}
+
+	const int b = A.child1;
+	const int c = A.child2;
+	const int balance = m_nodes[c].height - m_nodes[b].height;
+	if (balance >= -1 && balance <= 1)
+	{
+		return a;
+	}
+
+	// rotate the taller child (up) into a's place, its taller child stays under it and the shorter moves to a
+	const int up = balance > 1 ? c : b;
+	Node& U = m_nodes[up];
+	const int f = U.child1;
+	const int g = U.child2;
+
+	U.child1 = a;
+	U.parent = A.parent;
+	A.parent = up;
+	if (U.parent < 0)
+	{
+		m_root = up;
+	}
+	else if (m_nodes[U.parent].child1 == a)
+	{
+		m_nodes[U.parent].child1 = up;
+	}
+	else
+	{
+		m_nodes[U.parent].child2 = up;
+	}
+
+	const bool keepF = m_nodes[f].height > m_nodes[g].height;
+	const int taller = keepF ? f : g;
+	const int shorter = keepF ? g : f;
+	U.child2 = taller;
+	if (balance > 1)
+	{
+		A.child2 = shorter;
+	}
+	else
+	{
+		A.child1 = shorter;
+	}
+	m_nodes[shorter].parent = a;
+
+	A.fat = m_nodes[A.child1].fat.Union(m_nodes[A.child2].fat);
+	A.height = 1 + max(m_nodes[A.child1].height, m_nodes[A.child2].height);
+
+	// a new leaf can end up next to a much taller subtree, so one rotation isn't always enough.
+	// a can still be off (its new child came from further down), and then so can up
+	const int newA = Balance(a);
+	U.child1 = newA;
+	U.fat = m_nodes[newA].fat.Union(m_nodes[taller].fat);
+	U.height = 1 + max(m_nodes[newA].height, m_nodes[taller].height);
+	return Balance(up);
+}
+//******************************************************************************
+void AABBTree::Update()
+{
+	// fat pairs can only change where a fat box did
+	size_t kept = 0;
+	for (const BroadphasePair& pair : m_fatPairs)
+	{
+		const Node& a = m_nodes[pair.a];
+		const Node& b = m_nodes[pair.b];
+		if (a.height == 0 && b.height == 0 && !a.moved && !b.moved)
+		{
+			m_fatPairs[kept++] = pair;
+		}
+	}
+	m_fatPairs.resize(kept);
+
+	// everything that was reinserted looks itself up in the tree
+	int stack[AABB_TREE_STACK_SIZE];
+	for (int proxy : m_moved)
+	{
+		const Node& p = m_nodes[proxy];
+		if (p.height != 0 || m_root < 0)
+		{
+			continue; // removed since it moved
+		}
+
+		int count = 0;
+		stack[count++] = m_root;
+		while (count > 0)
+		{
+			const int index = stack[--count];
+			const Node& node = m_nodes[index];
+			if (!node.fat.Overlaps(p.fat))
+			{
+				continue;
+			}
+			if (!node.IsLeaf())
+			{
+				assert(count + 2 <= AABB_TREE_STACK_SIZE);
+				stack[count++] = node.child1;
+				stack[count++] = node.child2;
+				continue;
+			}
+			// if both moved only the lower id adds it
+			if (index != proxy && (!node.moved || proxy < index))
+			{
+				m_fatPairs.push_back({ min(proxy, index), max(proxy, index) });
+			}
+		}
+	}
+	for (int proxy : m_moved)
+	{
+		m_nodes[proxy].moved = false;
+	}
+	m_moved.clear();
+
+	// the carried over pairs are still sorted, so only the new ones need sorting before merging them in
+	std::sort(m_fatPairs.begin() + kept, m_fatPairs.end());
+	std::inplace_merge(m_fatPairs.begin(), m_fatPairs.begin() + kept, m_fatPairs.end());
+
+	// the real boxes sit inside the fat ones, so the overlapping pairs are a subset of the fat pairs
+	m_newPairs.clear();
+	for (const BroadphasePair& pair : m_fatPairs)
+	{
+		if (m_nodes[pair.a].box.Overlaps(m_nodes[pair.b].box))
+		{
+			m_newPairs.push_back(pair);
+		}
+	}
+	CommitNewPairs();
+
+	for (int proxy : m_removedProxies)
+	{
+		FreeNode(proxy);
+	}
+	m_removedProxies.clear();
+}
+//******************************************************************************
+void AABBTree::Query(const aabb& region, BroadphaseQueryFn fn, void* userData) const
+{
+	if (m_root < 0)
+	{
+		return;
+	}
+	int stack[AABB_TREE_STACK_SIZE];
+	int count = 0;
+	stack[count++] = m_root;
+	while (count > 0)
+	{
+		const int index = stack[--count];
+		const Node& node = m_nodes[index];
+		if (!node.fat.Overlaps(region))
+		{
+			continue;
+		}
+		if (node.IsLeaf())
+		{
+			if (node.box.Overlaps(region) && !fn(index, userData))
+			{
+				return;
+			}
+			continue;
+		}
+		assert(count + 2 <= AABB_TREE_STACK_SIZE);
+		stack[count++] = node.child1;
+		stack[count++] = node.child2;
+	}
+}
+//******************************************************************************
+void AABBTree::RayCast(const vector3& from, const vector3& to, BroadphaseRayFn fn, void* userData) const
+{
+	if (m_root < 0)
+	{
+		return;
+	}
+	float maxFraction = 1.0f;
+	int stack[AABB_TREE_STACK_SIZE];
+	int count = 0;
+	stack[count++] = m_root;
+	while (count > 0 && maxFraction > 0.0f)
+	{
+		const int index = stack[--count];
+		const Node& node = m_nodes[index];
+		if (!node.fat.IntersectsSegment(from, to, maxFraction))
+		{
+			continue;
+		}
+		if (node.IsLeaf())
+		{
+			if (node.box.IntersectsSegment(from, to, maxFraction))
+			{
+				const float clipped = fn(index, maxFraction, userData); // min() is a macro, don't call fn twice
+				maxFraction = min(maxFraction, clipped);
+			}
+			continue;
+		}
+		assert(count + 2 <= AABB_TREE_STACK_SIZE);
+		stack[count++] = node.child1;
+		stack[count++] = node.child2;
+	}
+}
+#ifdef TEST_PROGRAM
+//******************************************************************************
+void AABBTree::Validate() const
+{
+	if (m_root < 0)
+	{
+		return;
+	}
+	assert(m_nodes[m_root].parent < 0);
+	std::vector<int> stack(1, m_root);
+	while (!stack.empty())
+	{
+		const int index = stack.back();
+		stack.pop_back();
+		const Node& node = m_nodes[index];
+		if (node.IsLeaf())
+		{
+			assert(node.height == 0 && node.child2 < 0);
+			assert(node.fat.Contains(node.box));
+			continue;
+		}
+		const Node& c1 = m_nodes[node.child1];
+		const Node& c2 = m_nodes[node.child2];
+		assert(c1.parent == index && c2.parent == index);
+		assert(node.height == 1 + max(c1.height, c2.height));
+		assert(c1.height - c2.height <= 1 && c2.height - c1.height <= 1);
+		assert(node.fat.Contains(c1.fat) && node.fat.Contains(c2.fat));
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+}
+#endif
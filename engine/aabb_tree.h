@@ -0,0 +1,68 @@
+#pragma once
+
+#include "broadphase.h"
+
+//******************************************************************************
+// AABBTree - dynamic bounding volume hierarchy
+//   Leaves hold a "fat" copy of each proxy's box, grown by AABB_TREE_MARGIN, so a
+//   proxy that moves a little stays where it is and only gets reinserted once it
+//   leaves its fat box.  Inserts pick the sibling that grows the tree the least
+//   and the tree is kept balanced with AVL rotations on the way back up, so a
+//   few reinserts per tick stay cheap no matter how many proxies there are.
+//   The tree also keeps every pair whose fat boxes overlap.  Only proxies that
+//   were (re)inserted have to look themselves up to refresh that list, so
+//   Update is a walk over the fat pairs checking their real boxes plus one
+//   query per reinsert, and proxies jittering inside their margins cost nothing.
+//******************************************************************************
+static constexpr float AABB_TREE_MARGIN = 0.1f;
+
+class AABBTree : public Broadphase
+{
+public:
+	AABBTree();
+
+	virtual int   AddProxy(const aabb& box, void* userData);
+	virtual void  RemoveProxy(int proxy);
+	virtual void  MoveProxy(int proxy, const aabb& box);
+	virtual void* GetUserData(int proxy) const { return m_nodes[proxy].userData; }
+	virtual void  Update();
+	// these test the fat boxes down the tree and the proxies' own boxes at the leaves
+	virtual void  Query(const aabb& region, BroadphaseQueryFn fn, void* userData) const;
+	virtual void  RayCast(const vector3& from, const vector3& to, BroadphaseRayFn fn, void* userData) const;
+
+	const aabb& GetFatAABB(int proxy) const { return m_nodes[proxy].fat; }
+	int  GetHeight() const { return m_root < 0 ? 0 : m_nodes[m_root].height; }
+#ifdef TEST_PROGRAM
+	// asserts that every parent bounds its children and the heights and balance are right
+	void Validate() const;
+#endif
+
+private:
+	struct Node
+	{
+		aabb  fat;           // bounds of everything under this node
+		aabb  box;           // leaves: the proxy's own box
+		void* userData = nullptr;
+		int   parent = -1;   // or the next free node
+		int   child1 = -1;   // -1 for leaves
+		int   child2 = -1;
+		int   height = -1;   // leaves are 0, free nodes -1
+		bool  moved = false; // leaves: fat box changed since the last Update
+		bool  IsLeaf() const { return child1 < 0; }
+	};
+
+	int  AllocateNode();
+	void FreeNode(int node);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	int  Balance(int node);     // returns the node that ends up where node was
+	void FixUpwards(int node);  // refit and rebalance from node to the root
+	void MarkMoved(int leaf);
+
+	std::vector<Node> m_nodes;
+	int               m_root = -1;
+	int               m_freeList = -1;
+	std::vector<int>  m_moved;          // leaves to query in the next Update
+	std::vector<BroadphasePair> m_fatPairs; // pairs whose fat boxes overlap, sorted
+	std::vector<int>  m_removedProxies; // leaves freed after the next Update
+};
@@ -0,0 +1,172 @@
+#include "broadphase.h"
+#include "lib.h"
+#include <algorithm>
+
+//******************************************************************************
+void Broadphase::CommitNewPairs()
+{
+	std::sort(m_newPairs.begin(), m_newPairs.end());
+
+	// both lists are sorted, so a merge gives us what changed
+	m_addedPairs.clear();
+	m_removedPairs.clear();
+	size_t oldIndex = 0;
+	size_t newIndex = 0;
+	while (oldIndex < m_pairs.size() || newIndex < m_newPairs.size())
+	{
+		if (newIndex == m_newPairs.size() || (oldIndex < m_pairs.size() && m_pairs[oldIndex] < m_newPairs[newIndex]))
+		{
+			m_removedPairs.push_back(m_pairs[oldIndex++]);
+		}
+		else if (oldIndex == m_pairs.size() || m_newPairs[newIndex] < m_pairs[oldIndex])
+		{
+			m_addedPairs.push_back(m_newPairs[newIndex++]);
+		}
+		else
+		{
+			oldIndex++;
+			newIndex++;
+		}
+	}
+	m_pairs.swap(m_newPairs);
+}
+//******************************************************************************
+int SweepAndPrune::AddProxy(const aabb& box, void* userData)
+{
+	int proxy;
+	if (!m_freeProxies.empty())
+	{
+		proxy = m_freeProxies.back();
+		m_freeProxies.pop_back();
+	}
+	else
+	{
+		proxy = (int)m_proxies.size();
+		m_proxies.emplace_back();
+	}
+
+	Proxy& p = m_proxies[proxy];
+	p.box = box;
+	p.userData = userData;
+	p.alive = true;
+
+	// tacked on the end, the next Update sorts them into place
+	m_endpoints.push_back({ box.lower.x, (uint32_t)proxy << 1 });
+	m_endpoints.push_back({ box.upper.x, ((uint32_t)proxy << 1) | 1 });
+	m_numUnsorted += 2;
+	return proxy;
+}
+//******************************************************************************
+void SweepAndPrune::RemoveProxy(int proxy)
+{
+	assert(m_proxies[proxy].alive);
+	m_proxies[proxy].alive = false;
+	m_proxies[proxy].userData = nullptr;
+	m_removedProxies.push_back(proxy);
+
+	// its endpoints are dropped by the next Update, along with everything else removed by then,
+	// which reports its pairs as removed
+}
+//******************************************************************************
+void SweepAndPrune::MoveProxy(int proxy, const aabb& box)
+{
+	assert(m_proxies[proxy].alive);
+	m_proxies[proxy].box = box;
+}
+//******************************************************************************
+void SweepAndPrune::Update()
+{
+	if (!m_removedProxies.empty())
+	{
+		// removing keeps the rest in order
+		m_endpoints.erase(std::remove_if(m_endpoints.begin(), m_endpoints.end(),
+			[this](const Endpoint& e) { return !m_proxies[e.GetProxy()].alive; }), m_endpoints.end());
+	}
+
+	// pick up the new positions, then sort
+	for (Endpoint& e : m_endpoints)
+	{
+		const aabb& box = m_proxies[e.GetProxy()].box;
+		e.value = e.IsUpper() ? box.upper.x : box.lower.x;
+	}
+
+	constexpr int MAX_INSERTION_SORTED = 64;
+	if (m_numUnsorted > MAX_INSERTION_SORTED)
+	{
+		std::sort(m_endpoints.begin(), m_endpoints.end());
+	}
+	else
+	{
+		for (int i = 1; i < (int)m_endpoints.size(); i++)
+		{
+			const Endpoint e = m_endpoints[i];
+			int j = i - 1;
+			for (; j >= 0 && e < m_endpoints[j]; j--)
+			{
+				m_endpoints[j + 1] = m_endpoints[j];
+			}
+			m_endpoints[j + 1] = e;
+		}
+	}
+	m_numUnsorted = 0;
+
+	// sweep along x: everything in the active list overlaps the current box on x, so only check y and z
+	m_newPairs.clear();
+	m_active.clear();
+	for (const Endpoint& e : m_endpoints)
+	{
+		const int proxy = e.GetProxy();
+		Proxy& p = m_proxies[proxy];
+		if (e.IsUpper())
+		{
+			// swap and pop
+			const int last = m_active.back();
+			m_active[p.activeIndex] = last;
+			m_proxies[last].activeIndex = p.activeIndex;
+			m_active.pop_back();
+			p.activeIndex = -1;
+			continue;
+		}
+
+		for (int other : m_active)
+		{
+			const aabb& b = m_proxies[other].box;
+			if (p.box.lower.y <= b.upper.y && b.lower.y <= p.box.upper.y &&
+				p.box.lower.z <= b.upper.z && b.lower.z <= p.box.upper.z)
+			{
+				m_newPairs.push_back({ min(proxy, other), max(proxy, other) });
+			}
+		}
+		p.activeIndex = (int)m_active.size();
+		m_active.push_back(proxy);
+	}
+	CommitNewPairs();
+
+	// only reuse ids once their pairs have been reported as removed
+	m_freeProxies.insert(m_freeProxies.end(), m_removedProxies.begin(), m_removedProxies.end());
+	m_removedProxies.clear();
+}
+//******************************************************************************
+void SweepAndPrune::Query(const aabb& region, BroadphaseQueryFn fn, void* userData) const
+{
+	for (int i = 0; i < (int)m_proxies.size(); i++)
+	{
+		if (m_proxies[i].alive && m_proxies[i].box.Overlaps(region) && !fn(i, userData))
+		{
+			return;
+		}
+	}
+}
+//******************************************************************************
+void SweepAndPrune::RayCast(const vector3& from, const vector3& to, BroadphaseRayFn fn, void* userData) const
+{
+	float maxFraction = 1.0f;
+	for (int i = 0; i < (int)m_proxies.size() && maxFraction > 0.0f; i++)
+	{
+		if (m_proxies[i].alive && m_proxies[i].box.IntersectsSegment(from, to, maxFraction))
+		{
+			const float clipped = fn(i, maxFraction, userData); // min() is a macro, don't call fn twice
+			maxFraction = min(maxFraction, clipped);
+		}
+	}
+}
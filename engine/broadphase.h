@@ -0,0 +1,112 @@
+#pragma once
+
+#include "aabb.h"
+#include <vector>
+#include <cstdint>
+
+//******************************************************************************
+// Broadphase - cheap AABB tests to find the pairs worth handing to the narrowphase
+//******************************************************************************
+
+// two proxies whose boxes overlap, always a < b
+struct BroadphasePair
+{
+	int a;
+	int b;
+
+	uint64_t GetKey() const { return ((uint64_t)a << 32) | (uint32_t)b; }
+	bool operator<(const BroadphasePair& o) const { return GetKey() < o.GetKey(); }
+	bool operator==(const BroadphasePair& o) const { return a == o.a && b == o.b; }
+	// beats lib.h's swap template, which would otherwise be ambiguous with std::swap inside std::sort
+	friend void swap(BroadphasePair& x, BroadphasePair& y) { const BroadphasePair t = x; x = y; y = t; }
+};
+
+// callbacks for the queries below, userData is passed straight through
+typedef bool  (*BroadphaseQueryFn)(int proxy, void* userData);                  // return false to stop looking
+typedef float (*BroadphaseRayFn)(int proxy, float maxFraction, void* userData); // return the fraction to clip the ray to (0 stops)
+
+//******************************************************************************
+// Broadphase - the interface the physics uses, so the structure can be picked per scene
+//   Proxies are boxes with a user pointer.  Update() finds every pair of proxies whose boxes
+//   overlap, and what changed since the last Update.
+//******************************************************************************
+class Broadphase
+{
+public:
+	virtual ~Broadphase() {}
+
+	// proxy ids are reused after the Update that follows their removal
+	virtual int   AddProxy(const aabb& box, void* userData) = 0;
+	virtual void  RemoveProxy(int proxy) = 0;
+	virtual void  MoveProxy(int proxy, const aabb& box) = 0;
+	virtual void* GetUserData(int proxy) const = 0;
+
+	// Finds every overlapping pair, call after moving the proxies
+	virtual void  Update() = 0;
+
+	// every proxy whose box overlaps region (as of the last move, not the last Update)
+	virtual void  Query(const aabb& region, BroadphaseQueryFn fn, void* userData) const = 0;
+	// every proxy whose box the segment from -> to passes through, in no particular order.  The callback
+	// can shorten the segment to skip anything further away than what it has already found.
+	virtual void  RayCast(const vector3& from, const vector3& to, BroadphaseRayFn fn, void* userData) const = 0;
+
+	// every pair overlapping as of the last Update, sorted by a then b
+	const std::vector<BroadphasePair>& GetPairs() const { return m_pairs; }
+	// the pairs that started or stopped overlapping in the last Update (pairs with a removed proxy count as stopped)
+	const std::vector<BroadphasePair>& GetAddedPairs() const { return m_addedPairs; }
+	const std::vector<BroadphasePair>& GetRemovedPairs() const { return m_removedPairs; }
+
+protected:
+	// sorts m_newPairs, works out what was added and removed, then makes them the current pairs
+	void CommitNewPairs();
+
+	std::vector<BroadphasePair> m_pairs;
+	std::vector<BroadphasePair> m_newPairs;
+	std::vector<BroadphasePair> m_addedPairs;
+	std::vector<BroadphasePair> m_removedPairs;
+};
+
+//******************************************************************************
+// SweepAndPrune
+//   Keeps the box endpoints on one axis sorted, and sweeps them to find the overlaps.
+//   Objects barely move from one step to the next so the endpoints are nearly sorted
+//   already, and an insertion sort puts them back in order in close to linear time.
+//******************************************************************************
+class SweepAndPrune : public Broadphase
+{
+public:
+	virtual int   AddProxy(const aabb& box, void* userData);
+	virtual void  RemoveProxy(int proxy);
+	virtual void  MoveProxy(int proxy, const aabb& box);
+	virtual void* GetUserData(int proxy) const { return m_proxies[proxy].userData; }
+	virtual void  Update();
+	// nothing to narrow these down with, they check every proxy
+	virtual void  Query(const aabb& region, BroadphaseQueryFn fn, void* userData) const;
+	virtual void  RayCast(const vector3& from, const vector3& to, BroadphaseRayFn fn, void* userData) const;
+
+private:
+	struct Proxy
+	{
+		aabb  box;
+		void* userData = nullptr;
+		int   activeIndex = -1; // where it is in m_active during the sweep
+		bool  alive = false;
+	};
+	struct Endpoint
+	{
+		float    value;
+		uint32_t data; // proxy << 1 | 1 if this is the upper end
+		bool IsUpper() const { return (data & 1) != 0; }
+		int  GetProxy() const { return (int)(data >> 1); }
+		// lower ends go first on a tie so boxes that just touch count as overlapping
+		bool operator<(const Endpoint& o) const { return value < o.value || (value == o.value && IsUpper() < o.IsUpper()); }
+		friend void swap(Endpoint& x, Endpoint& y) { const Endpoint t = x; x = y; y = t; } // see BroadphasePair
+	};
+
+	std::vector<Proxy>          m_proxies;
+	std::vector<int>            m_freeProxies;
+	std::vector<int>            m_removedProxies; // free after the next Update
+	std::vector<Endpoint>       m_endpoints; // sorted along x after Update
+	int                         m_numUnsorted = 0; // endpoints added since the last sort, too many and a full sort is quicker
+	std::vector<int>            m_active;
+};
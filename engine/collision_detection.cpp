@@ -6,256 +6,256 @@
 #include "plane.h"
 #include "util.h"
 #include <limits>
-#include <vector>
-#include <algorithm>
 #include "simplex.h"
+#include "worker_pool.h"
 
 // Some documentation for reference:
 // https://graphics.stanford.edu/courses/cs448b-00-winter/papers/gilbert.pdf
 // https://ora.ox.ac.uk/objects/uuid:69c743d9-73de-4aff-8e6f-b4dd7c010907/download_file?safe_filename=GJK.PDF&file_format=application%2Fpdf&type_of_work=Journal+article
 
 //******************************************************************************
-static void SolveLine(Simplex& simplex)
+// Simplex solvers:
+// ----------------------
+// Find the point on a segment/triangle/tetrahedron closest to the origin by testing which Voronoi
+// region the origin is in (see Ericson, Real-Time Collision Detection, 5.1).  The simplex is reduced
+// to the smallest feature holding that point, and every point left gets its barycentric weight so
+// the closest point is sum(weight * p).  The same weights applied to A and B give the witness points.
+//******************************************************************************
+static int ClosestOnSegment(const SimplexPoint& a, const SimplexPoint& b, SimplexPoint* out)
 {
-    vector3 a = simplex.verts[0].p;
-    vector3 b = simplex.verts[1].p;
+	const vector3 ab = b.p - a.p;
+	const float denom = ab.dot(ab);
+	const float t = -a.p.dot(ab);
 
-	// if it is not between A and B, remove the segment it is further from.
 	//           |                      |
 	// region A  |       region AB      |  region B
 	//           A                      B
-	//  u<0      *----------------------*   u>1
+	//  t<0      *----------------------*   t>1
 	// remove b  |       keep both      |   remove a
 	//           |                      |
-	float u;
-	LineRegion region = ClosestPoint_LinePointRatio(vector3(), a, b, u);
+	if (t <= 0.0f || denom == 0.0f)
+	{
+		out[0] = a;
+		out[0].weight = 1.0f;
+		return 1;
+	}
+	if (t >= denom)
+	{
+		out[0] = b;
+		out[0].weight = 1.0f;
+		return 1;
+	}
+
+	out[0] = a;
+	out[1] = b;
+	out[1].weight = t / denom;
+	out[0].weight = 1.0f - out[1].weight;
+	return 2;
+}
+//******************************************************************************
+static float ClosestDistanceSq(const SimplexPoint* points, int count)
+{
+	vector3 v;
+	for (int i = 0; i < count; i++)
+	{
+		v = v + points[i].p * points[i].weight;
+	}
+	return v.magnitude_sq();
+}
+//******************************************************************************
+static int ClosestOnTriangle(const SimplexPoint& a, const SimplexPoint& b, const SimplexPoint& c, SimplexPoint* out)
+{
+	const vector3 ab = b.p - a.p;
+	const vector3 ac = c.p - a.p;
 
-	switch (region)
+	// region A
+	const float d1 = -ab.dot(a.p);
+	const float d2 = -ac.dot(a.p);
+	if (d1 <= 0.0f && d2 <= 0.0f)
 	{
-		case LineRegion_A:
+		out[0] = a;
+		out[0].weight = 1.0f;
+		return 1;
+	}
+
+	// region B
+	const float d3 = -ab.dot(b.p);
+	const float d4 = -ac.dot(b.p);
+	if (d3 >= 0.0f && d4 <= d3)
+	{
+		out[0] = b;
+		out[0].weight = 1.0f;
+		return 1;
+	}
+
+	// region AB
+	const float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		return ClosestOnSegment(a, b, out);
+	}
+
+	// region C
+	const float d5 = -ab.dot(c.p);
+	const float d6 = -ac.dot(c.p);
+	if (d6 >= 0.0f && d5 <= d6)
+	{
+		out[0] = c;
+		out[0].weight = 1.0f;
+		return 1;
+	}
+
+	// region AC
+	const float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		return ClosestOnSegment(a, c, out);
+	}
+
+	// region BC
+	const float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+	{
+		return ClosestOnSegment(b, c, out);
+	}
+
+	// region ABC
+	const float denom = va + vb + vc;
+	if (denom <= FLT_EPSILON * ab.magnitude_sq() * ac.magnitude_sq())
+	{
+		// the points are (nearly) in a line, the best of the edges covers them all
+		SimplexPoint edges[3][2];
+		const int counts[3] = { ClosestOnSegment(a, b, edges[0]), ClosestOnSegment(a, c, edges[1]), ClosestOnSegment(b, c, edges[2]) };
+		int best = 0;
+		for (int i = 1; i < 3; i++)
 		{
-			simplex.verts.resize(1);
+			if (ClosestDistanceSq(edges[i], counts[i]) < ClosestDistanceSq(edges[best], counts[best]))
+			{
+				best = i;
+			}
 		}
-		break;
-
-		case LineRegion_B:
+		for (int i = 0; i < counts[best]; i++)
 		{
-			simplex.verts[0] = simplex.verts[1];
-			simplex.verts.resize(1);
+			out[i] = edges[best][i];
 		}
-		break;
+		return counts[best];
+	}
 
-		default:
-		{
-			simplex.verts.resize(2);
+	out[0] = a;
+	out[1] = b;
+	out[2] = c;
+	out[1].weight = vb / denom;
+	out[2].weight = vc / denom;
+	out[0].weight = 1.0f - out[1].weight - out[2].weight;
+	return 3;
+}
+//******************************************************************************
+static int ClosestOnTetrahedron(const SimplexPoint& a, const SimplexPoint& b, const SimplexPoint& c, const SimplexPoint& d, SimplexPoint* out)
+{
+	// the origin is outside a face if it is on the other side of the face's plane from the 4th point
+	struct Face { const SimplexPoint* v[3]; const SimplexPoint* opposite; };
+	const Face faces[4] = {
+		{ { &a, &b, &c }, &d },
+		{ { &a, &c, &d }, &b },
+		{ { &a, &d, &b }, &c },
+		{ { &b, &d, &c }, &a },
+	};
+
+	float bestDistSq = FLT_MAX;
+	int bestCount = 0;
+	bool inside = true;
+	for (int i = 0; i < 4; i++)
+	{
+		const vector3& fa = faces[i].v[0]->p;
+		const vector3 n = (faces[i].v[1]->p - fa).cross(faces[i].v[2]->p - fa);
+		const float signOrigin = -n.dot(fa);
+		const float signOpposite = n.dot(faces[i].opposite->p - fa);
+		// a flat tetrahedron has no inside, check every face then
+		const bool flat = signOpposite * signOpposite <= FLT_EPSILON * n.magnitude_sq() * (faces[i].opposite->p - fa).magnitude_sq();
+		if (!flat && signOrigin * signOpposite >= 0.0f)
+		{
+			continue;
+		}
+
+		inside = false;
+		SimplexPoint candidate[3];
+		const int count = ClosestOnTriangle(*faces[i].v[0], *faces[i].v[1], *faces[i].v[2], candidate);
+		const float distSq = ClosestDistanceSq(candidate, count);
+		if (distSq < bestDistSq)
+		{
+			bestDistSq = distSq;
+			bestCount = count;
+			for (int j = 0; j < count; j++)
+			{
+				out[j] = candidate[j];
+			}
 		}
-		break;
+	}
+
+	if (inside)
+	{
+		// weights are the volumes of the tetrahedrons made by swapping each point for the origin
+		const float volume = (b.p - a.p).dot((c.p - a.p).cross(d.p - a.p));
+		out[0] = a;
+		out[1] = b;
+		out[2] = c;
+		out[3] = d;
+		out[1].weight = (-a.p).dot((c.p - a.p).cross(d.p - a.p)) / volume;
+		out[2].weight = (b.p - a.p).dot((-a.p).cross(d.p - a.p)) / volume;
+		out[3].weight = (b.p - a.p).dot((c.p - a.p).cross(-a.p)) / volume;
+		out[0].weight = 1.0f - out[1].weight - out[2].weight - out[3].weight;
+		return 4;
+	}
+
+	return bestCount;
+}
+//******************************************************************************
+static void SolveLine(Simplex& simplex)
+{
+	SimplexPoint out[2];
+	const int count = ClosestOnSegment(simplex.verts[0], simplex.verts[1], out);
+	simplex.verts.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		simplex.verts[i] = out[i];
 	}
 }
 //******************************************************************************
 static void SolveTriangle(Simplex& simplex)
 {
-	const vector3& va = simplex.verts[0].p;
-	const vector3& vb = simplex.verts[1].p;
-	const vector3& vc = simplex.verts[2].p;
-	float u,v;
-	TriangleRegion region = ClosestPoint_TrianglePointRatio(vector3(), va, vb, vc, u, v);
-	switch (region)
-	{
-		case TriangleRegion_ABC:
-		{
-			// within the triangle
-			//simplex.verts[1].edgeWeight = u;
-			//simplex.verts[2].edgeWeight = v;
-			return;
-		}
-		case TriangleRegion_A:
-		{
-			// set the simplex to just A
-			simplex.verts.resize(1);
-			return;
-		}
-		case TriangleRegion_B:
-		{
-			// set the simplex to just B
-			simplex.verts[0] = simplex.verts[1];
-			simplex.verts.resize(1);
-			return;
-		}
-		case TriangleRegion_C:
-		{
-			// set the simplex to just C
-			simplex.verts[0] = simplex.verts[2];
-			simplex.verts.resize(1);
-			return;
-		}
-		case TriangleRegion_AB:
-		{
-			// set the simplex to AB
-			//simplex.verts[1].edgeWeight = u;
-			simplex.verts.resize(2);
-			return;
-		}
-		case TriangleRegion_AC:
-		{
-			simplex.verts[1] = simplex.verts[2];
-			//simplex.verts[1].edgeWeight = u;
-			simplex.verts.resize(2);
-			return;
-		}
-		case TriangleRegion_BC:
-		{
-			simplex.verts[0] = simplex.verts[1];
-			simplex.verts[1] = simplex.verts[2];
-			//simplex.verts[0].edgeWeight = u;
-			//simplex.verts[1].edgeWeight = v;
-			simplex.verts.resize(2);
-			return;
-		}
+	SimplexPoint out[3];
+	const int count = ClosestOnTriangle(simplex.verts[0], simplex.verts[1], simplex.verts[2], out);
+	simplex.verts.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		simplex.verts[i] = out[i];
 	}
-	// should never get here
-	assert(false);
 }
-
 //******************************************************************************
 static void SolveTetrahedron(Simplex& simplex)
 {
-	const vector3& va = simplex.verts[0].p;
-	const vector3& vb = simplex.verts[1].p;
-	const vector3& vc = simplex.verts[2].p;
-	const vector3& vd = simplex.verts[3].p;
-
-	float u,v,w;
-	TetrahedronRegion region = ClosestPoint_TetrahedronPointRatio(vector3(), va, vb, vc, vd, u, v, w);
-
-	switch (region)
+	SimplexPoint out[4];
+	const int count = ClosestOnTetrahedron(simplex.verts[0], simplex.verts[1], simplex.verts[2], simplex.verts[3], out);
+	simplex.verts.resize(count);
+	for (int i = 0; i < count; i++)
 	{
-		case TetrahedronRegion_ABCD:
-		{
-			// within the tetrahedron
-			//simplex.verts[1].edgeWeight = u;
-			//simplex.verts[2].edgeWeight = v;
-			//simplex.verts[3].edgeWeight = w;
-			return;
-		}
-		case TetrahedronRegion_A:
-		{
-			// region A
-			simplex.verts.resize(1);
-			return;
-		}
-		case TetrahedronRegion_B:
-		{
-			// region B
-			simplex.verts[0] = simplex.verts[1];
-			simplex.verts.resize(1);
-			return;
-		}
-		case TetrahedronRegion_C:
-		{
-			// region C
-			simplex.verts[0] = simplex.verts[2];
-			simplex.verts.resize(1);
-			return;
-		}
-		case TetrahedronRegion_D:
-		{
-			simplex.verts[0] = simplex.verts[3];
-			simplex.verts.resize(1);
-			return;
-		}
-		case TetrahedronRegion_AB:
-		{
-			// region AB
-			//simplex.verts[1].edgeWeight = u;
-			simplex.verts.resize(2);
-			return;
-		}
-		case TetrahedronRegion_AC:
-		{
-			// region AC
-			simplex.verts[1] = simplex.verts[2];
-			//simplex.verts[1].edgeWeight = u;
-			simplex.verts.resize(2);
-			return;
-		}
-		case TetrahedronRegion_AD:
-		{
-			// region AD
-			simplex.verts[1] = simplex.verts[3];
-			//simplex.verts[1].edgeWeight = u;
-			simplex.verts.resize(2);
-			return;
-		}
-		case TetrahedronRegion_BC:
-		{
-			// region BC
-			simplex.verts[0] = simplex.verts[1];
-			simplex.verts[1] = simplex.verts[2];
-			//simplex.verts[1].edgeWeight = u;
-			simplex.verts.resize(2);
-			return;
-		}
-		case TetrahedronRegion_BD:
-		{
-			// region BD
-			simplex.verts[0] = simplex.verts[1];
-			simplex.verts[1] = simplex.verts[3];
-			//simplex.verts[1].edgeWeight = u;
-			simplex.verts.resize(2);
-			return;
-		}
-		case TetrahedronRegion_CD:
-		{
-			// region CD
-			simplex.verts[0] = simplex.verts[2];
-			simplex.verts[1] = simplex.verts[3];
-			//simplex.verts[1].edgeWeight = u;
-			simplex.verts.resize(2);
-			return;
-		}
-		case TetrahedronRegion_ABC:
-		{
-			// region ABC
-			//simplex.verts[1].edgeWeight = u;
-			//simplex.verts[2].edgeWeight = v;
-			simplex.verts.resize(3);
-			return;
-		}
-		case TetrahedronRegion_ABD:
-		{
-			// region ABD
-			simplex.verts[2] = simplex.verts[3];
-			//simplex.verts[1].edgeWeight = u;
-			//simplex.verts[2].edgeWeight = v;
-			simplex.verts.resize(3);
-			return;
-		}
-		case TetrahedronRegion_ACD:
-		{
-			// region ACD
-			simplex.verts[1] = simplex.verts[2];
-			simplex.verts[2] = simplex.verts[3];
-			//simplex.verts[1].edgeWeight = u;
-			//simplex.verts[2].edgeWeight = v;
-			simplex.verts.resize(3);
-			return;
-		}
-		case TetrahedronRegion_BCD:
-		{
-			// region BCD
-			simplex.verts[0] = simplex.verts[1];
-			simplex.verts[1] = simplex.verts[2];
-			simplex.verts[2] = simplex.verts[3];
-			//simplex.verts[1].edgeWeight = u;
-			//simplex.verts[2].edgeWeight = v;
-			simplex.verts.resize(3);
-			return;
-		}
-		default: assert(false);
+		simplex.verts[i] = out[i];
+	}
+}
+//******************************************************************************
+// the closest point to the origin found by the last solve, and the matching points on A and B
+static void GetWeightedPoints(const Simplex& simplex, vector3* p, vector3* a, vector3* b)
+{
+	*p = vector3();
+	*a = vector3();
+	*b = vector3();
+	for (int i = 0; i < simplex.size(); i++)
+	{
+		const SimplexPoint& v = simplex.verts[i];
+		*p = *p + v.p * v.weight;
+		*a = *a + v.A * v.weight;
+		*b = *b + v.B * v.weight;
 	}
-
-	assert(false);
 }
 //******************************************************************************
 static void GetClosestEdgeToOrigin(const Simplex& simplex, float& distance, float& u, int& startIndex, int& endIndex)
@@ -285,50 +285,37 @@ static void GetClosestEdgeToOrigin(const Simplex& simplex, float& distance, floa
 
 	// make sure we actually found something
 	assert(bestDistSq != FLT_MAX);
-	distance = sqrt(bestDistSq);
+	distance = Math_Sqrt(bestDistSq);
 	u = bestU;
 }
 //******************************************************************************
-static void GetClosestTriangleToOrigin(const Simplex& simplex, float& distance, float& u, float& v, int& face_index)
+static bool IsDegenerateTriangle(const vector3& a, const vector3& b, const vector3& c)
 {
-	//  - distance = distance from the origin
-	//  - u,v = percentage along the edge (A + u(B-A) + v(C-A)) to get the intersection point
-	const vector3 origin;
-	float bestDistSq = FLT_MAX;
-	float bestU = 0.0f;
-	float bestV = 0.0f;
-	for (int i = 0; i < simplex.faces.size(); i++)
-	{
-		int va = simplex.faces[i].point_index[0];
-		int vb = simplex.faces[i].point_index[1];
-		int vc = simplex.faces[i].point_index[2];
-		const vector3& a = simplex.verts[va].p;
-		const vector3& b = simplex.verts[vb].p;
-		const vector3& c = simplex.verts[vc].p;
-		float u, v;
-		ClosestPoint_TrianglePointRatio(origin, a, b, c, u, v);
-		float distanceSq = (a + (b - a) * u + (c - a) * v).magnitude_sq();
-		if (distanceSq < bestDistSq)
-		{
-			bestDistSq = distanceSq;
-			face_index = i;
-			bestU = u;
-			bestV = v;
-		}
-	}
-
-	// make sure we actually found something
-	assert(bestDistSq != FLT_MAX);
-	distance = sqrt(bestDistSq);
-	u = bestU;
-	v = bestV;
+	// same test ClosestPoint_TrianglePointRatio asserts on, curved shapes can produce slivers
+	const vector3 ab = b - a;
+	const vector3 ac = c - a;
+	const float abDotAc = ab.dot(ac);
+	return FloatEquals(4.0f * (ab.magnitude_sq() * ac.magnitude_sq() - abDotAc * abDotAc), 0.0f) || FloatEquals(ac.magnitude_sq(), 0.0f);
 }
 //******************************************************************************
 vector3 GetSearchDirection(const Simplex& simplex)
 {
+	if (simplex.size() == 1)
+	{
+		return GetDirectionToOrigin(simplex.verts[0].p);
+	}
+
+	// head straight for the origin from the closest point the solver found
+	vector3 p, a, b;
+	GetWeightedPoints(simplex, &p, &a, &b);
+	if (!FloatEquals(p.magnitude_sq(), 0.0f))
+	{
+		return -p;
+	}
+
+	// the origin is on the simplex, any way off it will do
 	switch (simplex.size())
 	{
-	case 1: return GetDirectionToOrigin(simplex.verts[0].p);
 	case 2: return GetDirectionToOrigin(simplex.verts[0].p, simplex.verts[1].p);
 	case 3: return GetDirectionToOrigin(simplex.verts[0].p, simplex.verts[1].p, simplex.verts[2].p);
 	}
@@ -384,31 +371,92 @@ static void GetClosestNormalAwayFromOrigin(const Simplex& simplex, bool is3D, ve
 	}
 	else
 	{
-		// First: find the closest edge in our simplex to the origin
-		float distance = 0.0f;
-		float u, v;
-		int face_index;
-		GetClosestTriangleToOrigin(simplex, distance, u, v, face_index);
-
-		int va = simplex.faces[face_index].point_index[0];
-		int vb = simplex.faces[face_index].point_index[1];
-		int vc = simplex.faces[face_index].point_index[2];
-
-		const vector3& a = simplex.verts[va].p;
-		const vector3& b = simplex.verts[vb].p;
-		const vector3& c = simplex.verts[vc].p;
-		const vector3 ab = (b - a);
-		const vector3 ac = (c - a);
-		const vector3 n = (ab.cross(ac)).normalize();
-		const vector3 closest_point_to_origin = a + (b - a) * u + (c - a) * v;
-		const vector3 normal = closest_point_to_origin.dot(n) > 0.0f ? n : -n; // pick the normal going away from the origin
+		// First: find the closest face in our polytope to the origin, the heap keeps it at the top
+		const int face_index = simplex.GetClosestFace();
 
 		*out_face_index = face_index;
-		*outDistance = distance;
+		*outDistance = simplex.faces[face_index].distance;
 		*outNormal = simplex.faces[face_index].normal;
 	}
 }
 //******************************************************************************
+// HorizonEdges:
+// Open-addressed set of directed polytope edges, keyed on the vertex pair.  An edge shared by two
+// removed faces shows up once in each direction and cancels out, what's left is the horizon.
+struct HorizonEdges
+{
+	static constexpr int TABLE_SIZE = 512; // power of two, at least twice SIMPLEX_MAX_EDGES
+	static constexpr int EMPTY = -1;
+	static constexpr int REMOVED = -2;
+	static_assert(TABLE_SIZE >= 2 * SIMPLEX_MAX_EDGES, "horizon edge table is too small");
+
+	int keys[TABLE_SIZE];
+	FixedArray<int, SIMPLEX_MAX_EDGES> slots; // in the order they were added, so the output is deterministic
+
+	HorizonEdges() { memset(keys, 0xff, sizeof(keys)); }
+
+	static int Key(int va, int vb) { return va * SIMPLEX_MAX_VERTS + vb; }
+	static int Hash(int key) { return (int)(((unsigned int)key * 2654435761u) >> 23) & (TABLE_SIZE - 1); }
+
+	void Toggle(int va, int vb)
+	{
+		// if the reverse edge exists, erase it.. we'll get degenerate triangles
+		// otherwise, add it, this is a unique outer edge
+		const int reverse = Key(vb, va);
+		int slot = Hash(reverse);
+		while (keys[slot] != EMPTY)
+		{
+			if (keys[slot] == reverse)
+			{
+				keys[slot] = REMOVED;
+				return;
+			}
+			slot = (slot + 1) & (TABLE_SIZE - 1);
+		}
+
+		// removed slots aren't reused, every edge is added at most once so the table can't fill up
+		slot = Hash(Key(va, vb));
+		while (keys[slot] != EMPTY)
+		{
+			slot = (slot + 1) & (TABLE_SIZE - 1);
+		}
+		keys[slot] = Key(va, vb);
+		slots.push_back(slot);
+	}
+};
+//******************************************************************************
+// the closest point to the origin on an edge/face of the Minkowski difference, as points on A and B
+static void SetContactPoints(const SimplexPoint& a, const SimplexPoint& b, CollisionData* outCollision)
+{
+	const vector3 edge = b.p - a.p;
+	const float lengthSq = edge.magnitude_sq();
+	const float t = FloatEquals(lengthSq, 0.0f) ? 0.0f : -a.p.dot(edge) / lengthSq;
+	const float u = clamp(t, 0.0f, 1.0f);
+	outCollision->a_point = a.A + (b.A - a.A) * u;
+	outCollision->b_point = a.B + (b.B - a.B) * u;
+}
+static void SetContactPoints(const SimplexPoint& a, const SimplexPoint& b, const SimplexPoint& c, CollisionData* outCollision)
+{
+	if (IsDegenerateTriangle(a.p, b.p, c.p))
+	{
+		// a sliver, its longest edge is as good as the face
+		const float ab = (b.p - a.p).magnitude_sq();
+		const float bc = (c.p - b.p).magnitude_sq();
+		const float ca = (a.p - c.p).magnitude_sq();
+		if (ab >= bc && ab >= ca)
+			SetContactPoints(a, b, outCollision);
+		else if (bc >= ca)
+			SetContactPoints(b, c, outCollision);
+		else
+			SetContactPoints(c, a, outCollision);
+		return;
+	}
+	float u, v;
+	ClosestPoint_TrianglePointRatio(vector3(), a.p, b.p, c.p, u, v);
+	outCollision->a_point = a.A + (b.A - a.A) * u + (c.A - a.A) * v;
+	outCollision->b_point = a.B + (b.B - a.B) * u + (c.B - a.B) * v;
+}
+//******************************************************************************
 static bool FindIntersectionPointsStep(const CollisionParams& params, Simplex& simplex, bool is3D, CollisionData* outCollision)
 {
 	assert(simplex.m_containsOrigin);
@@ -420,37 +468,59 @@ static bool FindIntersectionPointsStep(const CollisionParams& params, Simplex& s
 	vector3 normal;
 	GetClosestNormalAwayFromOrigin(simplex, is3D, &normal, &distance, &simplex_a, &simplex_b, &face_index);
 
+	// a 3D face that happens to pass close to the origin isn't necessarily on the hull, only the support
+	// point can tell us that.  The 2D edges don't have a unit normal to test against so they stop here
 	constexpr float TOLERANCE = 0.01f;
-	if (distance > TOLERANCE)
+	if (is3D || distance > TOLERANCE)
 	{
 		// Second: try and expand the simplex by 'pushing out' that edge in the direction of its normal
-		const vector3 a_support = params.a->GetPointFurthestInDirection(normal, params.aTransform, is3D);
-		const vector3 b_support = params.b->GetPointFurthestInDirection(-normal, params.bTransform, is3D);
+		//         (warm-starting the support search from a point on that edge)
+		const SimplexPoint& closest = simplex.verts[is3D ? simplex.faces[face_index].point_index[0] : simplex_a];
+		int a_index = closest.a_index;
+		int b_index = closest.b_index;
+		const vector3 a_support = params.a->GetPointFurthestInDirection(normal, params.aTransform, is3D, &a_index);
+		const vector3 b_support = params.b->GetPointFurthestInDirection(-normal, params.bTransform, is3D, &b_index);
 		const vector3 support = a_support - b_support;
 
 		// Third: Given the new point that we found (the position furthest away from the closest edge to the origin)
 		//        if that point is already in our simplex, then the edge we have found must be on the exterior hull 
 		//        of the minkowski difference.  Therefore, the distance to this edge is the penetration depth
 		//        and the penetration direction is the normal to this edge
-		for (int i = 0; i < simplex.verts.size(); i++)
+		if (is3D)
 		{
-			if (vector3::Equals(a_support, simplex.verts[i].A, TOLERANCE) &&
-				vector3::Equals(b_support, simplex.verts[i].B, TOLERANCE))
+			// faces know their plane, if the support point doesn't get meaningfully past it the face is on the hull
+			closeEnough = normal.dot(support) - distance < TOLERANCE;
+		}
+		else
+		{
+			for (int i = 0; i < simplex.verts.size(); i++)
 			{
-				// if we already added this support point, then the last iteration must have found
-				// the same support point being the closest to the origin, and we must have reached our
-				// exterior hull
-				closeEnough = true;
-				break;
+				if (vector3::Equals(a_support, simplex.verts[i].A, TOLERANCE) &&
+					vector3::Equals(b_support, simplex.verts[i].B, TOLERANCE))
+				{
+					// if we already added this support point, then the last iteration must have found
+					// the same support point being the closest to the origin, and we must have reached our
+					// exterior hull
+					closeEnough = true;
+					break;
+				}
 			}
 		}
 
+		if (!closeEnough && simplex.verts.full())
+		{
+			// the polytope is out of room, the current closest feature is the best answer we can give
+			closeEnough = true;
+		}
+
 		if (!closeEnough)
 		{
 			// we didn't find a match, so add this point and tell the algorithm to continue
 			SimplexPoint new_point;
 			new_point.A = a_support;
 			new_point.B = b_support;
+			new_point.a_index = a_index;
+			new_point.b_index = b_index;
 			new_point.p = support;
 			if (!is3D)
 			{
@@ -466,58 +536,71 @@ static bool FindIntersectionPointsStep(const CollisionParams& params, Simplex& s
 				// keep all the unique outer edges and add them relative to the new point
 
 				
-				struct UniqueEdges
+				HorizonEdges horizon;
+				FixedArray<int, SIMPLEX_MAX_FACES> visible;
+
+				// find every face the new point can see, nothing is removed until we know the new faces fit
+				for (int i = 0; i < simplex.faces.size(); i++)
 				{
-					struct Edge
-					{
-						int va;
-						int vb;
-					};
-					std::vector<Edge> edges;
-					void AddIfUnique(int va, int vb)
+					const SimplexFace& face = simplex.faces[i];
+					const vector3& a = simplex.verts[face.point_index[0]].p;
+					const bool faceIsInDirectionOfSupport = face.normal.dot(support - a) > 0;
+					if (faceIsInDirectionOfSupport)
 					{
-						// if the reverse edge exists, erase it.. we'll get degenerate triangles
-						// otherwise, add it, this is a unique outer edge
-						auto it = std::find_if(edges.begin(), edges.end(), [va,vb](const Edge& e) { return e.va == vb && e.vb == va; });
-						if (it != edges.end())
-						{
-							edges.erase(it);
-						}
-						else
-						{
-							edges.push_back({va, vb});
-						}
+						horizon.Toggle(face.point_index[0], face.point_index[1]);
+						horizon.Toggle(face.point_index[1], face.point_index[2]);
+						horizon.Toggle(face.point_index[2], face.point_index[0]);
+						visible.push_back(i);
 					}
-				};
-				UniqueEdges uniqueEdges;
+				}
 
-				for (auto it = simplex.faces.begin(); it != simplex.faces.end();)
+				// one new face per horizon edge.  without an epsilon on the visibility test the visible faces
+				// don't have to make a single disk, so the horizon can be longer than the faces it replaces
+				int horizonCount = 0;
+				for (int i = 0; i < horizon.slots.size(); i++)
 				{
-					const SimplexFace& face = *it;
-					const bool faceIsInDirectionOfSupport = face.normal.dot(support) > 0;
-					if (faceIsInDirectionOfSupport)
+					if (horizon.keys[horizon.slots[i]] >= 0)
 					{
-						uniqueEdges.AddIfUnique(face.point_index[0], face.point_index[1]);
-						uniqueEdges.AddIfUnique(face.point_index[1], face.point_index[2]);
-						uniqueEdges.AddIfUnique(face.point_index[2], face.point_index[0]);
-
-						it = simplex.faces.erase(it);
+						++horizonCount;
 					}
-					else
+				}
+
+				if (visible.size() == simplex.faces.size())
+				{
+					// the new point can see every face, so the polytope never really enclosed the origin.
+					// the closest face we had is the best answer we can give
+					closeEnough = true;
+				}
+				else if (simplex.faces.size() - visible.size() + horizonCount > simplex.faces.capacity())
+				{
+					// out of room for the new faces, same as running out of verts
+					closeEnough = true;
+				}
+				else
+				{
+					// highest index first, so the face swapped into each hole has already been looked at
+					for (int i = visible.size() - 1; i >= 0; i--)
 					{
-						++it;
+						simplex.RemoveFace(visible[i]);
 					}
-				}
 
-				int new_index = simplex.insert(new_point);
+					int new_index = simplex.insert(new_point);
 
-				for (int i = 0; i < uniqueEdges.edges.size(); i++)
-				{
-					simplex.AddFace(uniqueEdges.edges[i].va, uniqueEdges.edges[i].vb, new_index);
+					for (int i = 0; i < horizon.slots.size(); i++)
+					{
+						const int key = horizon.keys[horizon.slots[i]];
+						if (key >= 0)
+						{
+							simplex.AddFace(key / SIMPLEX_MAX_VERTS, key % SIMPLEX_MAX_VERTS, new_index);
+						}
+					}
 				}
 			}
-			
-			return false;
+
+			if (!closeEnough)
+			{
+				return false;
+			}
 		}
 	}
 	else
@@ -530,6 +613,17 @@ static bool FindIntersectionPointsStep(const CollisionParams& params, Simplex& s
 	outCollision->penetrationDirection = -normal.normalize();
 	outCollision->depth = distance;
 
+	// the closest point on the face is where A and B overlap the most, the same weights give the points on each shape
+	if (is3D)
+	{
+		const SimplexFace& face = simplex.faces[face_index];
+		SetContactPoints(simplex.verts[face.point_index[0]], simplex.verts[face.point_index[1]], simplex.verts[face.point_index[2]], outCollision);
+	}
+	else
+	{
+		SetContactPoints(simplex.verts[simplex_a], simplex.verts[simplex_b], outCollision);
+	}
+
 	// No idea if this is right, total shot in the dark
 	//const vector3& ai = simplex.verts[va].A;
 	//const vector3& aj = simplex.verts[vb].A;
@@ -566,24 +660,30 @@ bool FindIntersectionPoints(const CollisionParams& params, Simplex& simplex, int
 	}
 	else if (is3D && simplex.verts.size() >= 3)
 	{
+		// GJK bailed out on a triangle, there is no polytope (faces) to search, the triangle itself is the closest feature
+		const vector3& a = simplex.verts[0].p;
+		const vector3& b = simplex.verts[1].p;
+		const vector3& c = simplex.verts[2].p;
+		vector3 closest_point_to_origin;
+		if (!IsDegenerateTriangle(a, b, c))
+		{
+			float u, v;
+			ClosestPoint_TrianglePointRatio(vector3(), a, b, c, u, v);
+			closest_point_to_origin = a + (b - a) * u + (c - a) * v;
+		}
+		else
+		{
+			// the points are in a line (curved shapes can hand back nearly the same point twice), the longest edge covers them all
+			const vector3* start = &a;
+			const vector3* end = &b;
+			if ((c - a).magnitude_sq() > (*end - *start).magnitude_sq()) { end = &c; }
+			if ((c - b).magnitude_sq() > (*end - *start).magnitude_sq()) { start = &b; end = &c; }
+			closest_point_to_origin = FloatEquals((*end - *start).magnitude_sq(), 0.0f) ? *start : ClosestPoint_LinePoint(vector3(), *start, *end);
+		}
 
-		float distance = 0.0f;
-		float u, v;
-		int face_index;
-		GetClosestTriangleToOrigin(simplex, distance, u, v, face_index);
-
-		int va = simplex.faces[face_index].point_index[0];
-		int vb = simplex.faces[face_index].point_index[1];
-		int vc = simplex.faces[face_index].point_index[2];
-
-		const vector3& a = simplex.verts[va].p;
-		const vector3& b = simplex.verts[vb].p;
-		const vector3& c = simplex.verts[vc].p;
-
-		const vector3 closest_point_to_origin = a + (b - a) * u + (c - a) * v;
-
-		outCollision->depth = distance;
+		outCollision->depth = closest_point_to_origin.magnitude();
 		outCollision->penetrationDirection = closest_point_to_origin.normalize();
+		SetContactPoints(simplex.verts[0], simplex.verts[1], simplex.verts[2], outCollision);
 
 		return true;
 	}
@@ -600,6 +700,7 @@ bool FindIntersectionPoints(const CollisionParams& params, Simplex& simplex, int
 
 		outCollision->depth = u;
 		outCollision->penetrationDirection = closest_point_to_origin;
+		SetContactPoints(simplex.verts[startIndex], simplex.verts[endIndex], outCollision);
 
 		return true;
 	}
@@ -619,7 +720,14 @@ bool FindIntersectionPoints(const CollisionParams& params, Simplex& simplex, int
 //******************************************************************************
 COLLISION_RESULT DetectCollisionStep(const CollisionParams& params, bool is3D, Simplex& simplex)
 {
-	const std::vector<SimplexPoint> oldPoints = simplex.verts;
+	// the solvers below shrink the simplex, remember what we had so we can tell if we stopped making progress
+	SimplexPoint oldPoints[4];
+	const int numOldPoints = simplex.size();
+	assert(numOldPoints > 0 && numOldPoints <= 4);
+	for (int i = 0; i < numOldPoints; ++i)
+	{
+		oldPoints[i] = simplex.verts[i];
+	}
 
 	switch (simplex.size())
 	{
@@ -657,12 +765,12 @@ COLLISION_RESULT DetectCollisionStep(const CollisionParams& params, bool is3D, S
 		return COLLISION_RESULT_NO_OVERLAP;
 	}
 
-	// TODO: for Mesh geometries that are consider each vertex
-	//       there might be an optimization here where we pass in the last point we considered and 
-	//       only look at points adjacent to it and pick the next furthest point, rather than
-	//       iterating the entire vertex list
-	vector3 a_support = params.a->GetPointFurthestInDirection(d, params.aTransform, is3D);
-	vector3 b_support = params.b->GetPointFurthestInDirection(-d, params.bTransform, is3D);
+	// warm-start the support search from the last point we added, mesh shapes can then
+	// walk to the adjacent vertices rather than iterating the entire vertex list
+	int a_index = oldPoints[numOldPoints - 1].a_index;
+	int b_index = oldPoints[numOldPoints - 1].b_index;
+	vector3 a_support = params.a->GetPointFurthestInDirection(d, params.aTransform, is3D, &a_index);
+	vector3 b_support = params.b->GetPointFurthestInDirection(-d, params.bTransform, is3D, &b_index);
 	vector3 support = a_support - b_support;
 	if (d.dot(support) < 0)
 	{
@@ -671,7 +779,7 @@ COLLISION_RESULT DetectCollisionStep(const CollisionParams& params, bool is3D, S
 
 	// If we got a point that we already had, there must be no more room towards the origin
 	// in this simplex, therefore there is no way to encapsulate the origin, therefore no overlap
-	for (int i = 0; i < oldPoints.size(); ++i)
+	for (int i = 0; i < numOldPoints; ++i)
 	{
 		if (a_support == oldPoints[i].A && b_support == oldPoints[i].B)
 		{
@@ -683,25 +791,46 @@ COLLISION_RESULT DetectCollisionStep(const CollisionParams& params, bool is3D, S
 	SimplexPoint p;
 	p.A = a_support;
 	p.B = b_support;
-	//p.a_index = a_index;
-	//p.b_index = b_index;
+	p.a_index = a_index;
+	p.b_index = b_index;
 	p.p = support;
 	simplex.verts.push_back(p);
 
 	return COLLISION_RESULT_CONTINUE;
 }
 //******************************************************************************
-bool DetectCollision(const CollisionParams& params, bool is3D, CollisionData* outCollision)
+// true if projecting both shapes onto the axis leaves a gap between them (A below B),
+// which proves there is no overlap without running GJK
+static bool AxisSeparates(const CollisionParams& params, bool is3D, const vector3& axis, int* a_index, int* b_index)
+{
+	const vector3 a_support = params.a->GetPointFurthestInDirection(axis, params.aTransform, is3D, a_index);
+	const vector3 b_support = params.b->GetPointFurthestInDirection(-axis, params.bTransform, is3D, b_index);
+	return axis.dot(a_support - b_support) < 0.0f;
+}
+//******************************************************************************
+bool DetectCollision(const CollisionParams& params, bool is3D, CollisionData* outCollision, CollisionCache* cache)
 {
 	Simplex simplex;
 
-	// TODO: broad phase AABB boxes
+	if (cache && cache->valid && AxisSeparates(params, is3D, cache->axis, &cache->a_index, &cache->b_index))
+	{
+		// the axis that separated them last time still does, there is nothing more to do
+		if (outCollision)
+		{
+			outCollision->overlap = false;
+			outCollision->success = false;
+		}
+		return false;
+	}
 
 	// start with any point in the geometries
 	simplex.verts.resize(1);
-	simplex.verts[0].A = params.a->GetPointFurthestInDirection({ 1,1,1 }, params.aTransform, is3D);
-	simplex.verts[0].B = params.b->GetPointFurthestInDirection({ -1,-1,-1 }, params.bTransform, is3D);
-	simplex.verts[0].p = simplex.verts[0].B - simplex.verts[0].A;
+	simplex.verts[0].a_index = cache ? cache->a_index : -1;
+	simplex.verts[0].b_index = cache ? cache->b_index : -1;
+	simplex.verts[0].A = params.a->GetPointFurthestInDirection({ 1,1,1 }, params.aTransform, is3D, &simplex.verts[0].a_index);
+	simplex.verts[0].B = params.b->GetPointFurthestInDirection({ -1,-1,-1 }, params.bTransform, is3D, &simplex.verts[0].b_index);
+	simplex.verts[0].p = simplex.verts[0].A - simplex.verts[0].B;
+	simplex.verts[0].weight = 1.0f;
 
 	const vector3 destination = { 0.0f, 0.0f, 0.0f }; // origin
 	constexpr int maxIterations = 20;
@@ -725,9 +854,165 @@ bool DetectCollision(const CollisionParams& params, bool is3D, CollisionData* ou
 
 	if (outCollision)
 	{
+		outCollision->overlap = (result == COLLISION_RESULT_OVERLAP);
 		outCollision->success = FindIntersectionPoints(params, simplex, maxIterations, is3D, outCollision);
 	}
 
+	if (cache)
+	{
+		// remember an axis that separates them (or the way out if they overlap), that's the best guess for next time,
+		// along with the support vertices in that axis so the next AxisSeparates starts from them
+		cache->valid = false;
+		cache->a_index = simplex.verts[0].a_index;
+		cache->b_index = simplex.verts[0].b_index;
+		if (result == COLLISION_RESULT_NO_OVERLAP)
+		{
+			// the last search direction usually separates them, if not the line between the two origins often does
+			const vector3 candidates[2] = {
+				simplex.size() < 4 ? GetSearchDirection(simplex) : vector3(),
+				params.bTransform.translation_get() - params.aTransform.translation_get(),
+			};
+			for (int i = 0; i < 2 && !cache->valid; i++)
+			{
+				int a_index = simplex.verts[0].a_index;
+				int b_index = simplex.verts[0].b_index;
+				if (!FloatEquals(candidates[i].magnitude_sq(), 0.0f) && AxisSeparates(params, is3D, candidates[i], &a_index, &b_index))
+				{
+					cache->axis = candidates[i];
+					cache->a_index = a_index;
+					cache->b_index = b_index;
+					cache->valid = true;
+				}
+			}
+		}
+		else if (result == COLLISION_RESULT_OVERLAP && outCollision && outCollision->success)
+		{
+			cache->axis = -outCollision->penetrationDirection;
+			cache->valid = !FloatEquals(cache->axis.magnitude_sq(), 0.0f);
+			if (cache->valid)
+			{
+				// the simplex's first vertex was found in some other direction, look up the ones on the cached axis
+				params.a->GetPointFurthestInDirection(cache->axis, params.aTransform, is3D, &cache->a_index);
+				params.b->GetPointFurthestInDirection(-cache->axis, params.bTransform, is3D, &cache->b_index);
+			}
+		}
+	}
+
 	return (result == COLLISION_RESULT_OVERLAP);
 }
 //******************************************************************************
+//******************************************************************************
+struct CollisionBatch
+{
+	const CollisionParams*   pairs;
+	CollisionData*           out;
+	CollisionCache* const*   caches;
+};
+static void DetectCollisionBatchRange(int begin, int end, int /*threadIndex*/, void* userData)
+{
+	// every query keeps its simplex/polytope on this thread's stack, so workers never share scratch memory
+	const CollisionBatch& batch = *(const CollisionBatch*)userData;
+	for (int i = begin; i < end; i++)
+	{
+		DetectCollision(batch.pairs[i], true, &batch.out[i], batch.caches ? batch.caches[i] : nullptr);
+	}
+}
+//******************************************************************************
+void DetectCollisionBatch(const CollisionParams* pairs, size_t n, CollisionData* out, CollisionCache* const* caches)
+{
+	// big enough to be worth handing to another thread, small enough that a few slow (EPA) pairs balance out
+	constexpr int PAIRS_PER_CHUNK = 16;
+
+	CollisionBatch batch = { pairs, out, caches };
+	WorkerPool_ParallelFor((int)n, PAIRS_PER_CHUNK, DetectCollisionBatchRange, &batch);
+}
+//******************************************************************************
+//******************************************************************************
+// Closest Points:
+// ----------------------
+// GJK run as a distance query (Gilbert, Johnson, Keerthi).  Rather than stopping as soon as the
+// simplex can't reach the origin, keep pulling the closest point v of the simplex towards the
+// origin until the support in -v doesn't get any closer.  The simplex weights then give the
+// closest points on A and B.
+//******************************************************************************
+bool GetClosestPoints(const CollisionParams& params, bool is3D, float maxDistance, DistanceData* out)
+{
+	assert(out);
+	out->overlap = false;
+
+	// the origins are a decent guess for which way the shapes face each other
+	vector3 d = params.bTransform.translation_get() - params.aTransform.translation_get();
+	if (FloatEquals(d.magnitude_sq(), 0.0f))
+	{
+		d = { 1.0f, 1.0f, 1.0f };
+	}
+
+	Simplex simplex;
+	simplex.verts.resize(1);
+	simplex.verts[0].A = params.a->GetPointFurthestInDirection(d, params.aTransform, is3D, &simplex.verts[0].a_index);
+	simplex.verts[0].B = params.b->GetPointFurthestInDirection(-d, params.bTransform, is3D, &simplex.verts[0].b_index);
+	simplex.verts[0].p = simplex.verts[0].A - simplex.verts[0].B;
+	simplex.verts[0].weight = 1.0f;
+
+	constexpr int maxIterations = 32;
+	constexpr float RELATIVE_TOLERANCE = 1e-6f; // stop once a new point closes less than this fraction of |v|^2
+	vector3 v, a_point, b_point;
+	for (int iteration = 0; iteration < maxIterations; iteration++)
+	{
+		GetWeightedPoints(simplex, &v, &a_point, &b_point);
+		const float vSq = v.magnitude_sq();
+		if (simplex.size() == 4 || (!is3D && simplex.size() == 3) || FloatEquals(vSq, 0.0f))
+		{
+			out->overlap = true;
+			out->distance = 0.0f;
+			return false;
+		}
+
+		const SimplexPoint& last = simplex.verts[simplex.size() - 1];
+		SimplexPoint w;
+		w.a_index = last.a_index;
+		w.b_index = last.b_index;
+		w.A = params.a->GetPointFurthestInDirection(-v, params.aTransform, is3D, &w.a_index);
+		w.B = params.b->GetPointFurthestInDirection(v, params.bTransform, is3D, &w.b_index);
+		w.p = w.A - w.B;
+
+		// nothing in A-B is closer than v.w/|v|, if that's already too far there's no point refining it
+		const float vw = v.dot(w.p);
+		if (vw > 0.0f && vw * vw > maxDistance * maxDistance * vSq)
+		{
+			out->distance = vw / Math_Sqrt(vSq);
+			return false;
+		}
+
+		// the new point barely gets us closer, v is as good as it's going to get
+		if (vSq - vw <= RELATIVE_TOLERANCE * vSq)
+		{
+			break;
+		}
+		bool duplicate = false;
+		for (int i = 0; i < simplex.size(); i++)
+		{
+			duplicate |= (w.A == simplex.verts[i].A && w.B == simplex.verts[i].B);
+		}
+		if (duplicate)
+		{
+			break;
+		}
+
+		simplex.verts.push_back(w);
+		switch (simplex.size())
+		{
+		case 2: SolveLine(simplex); break;
+		case 3: SolveTriangle(simplex); break;
+		case 4: SolveTetrahedron(simplex); break;
+		default: assert(false);
+		}
+	}
+
+	// A-B is closest at v, so B is -v away from A
+	out->distance = v.magnitude();
+	out->a_point = a_point;
+	out->b_point = b_point;
+	out->normal = v * (-1.0f / out->distance);
+	return out->distance <= maxDistance;
+}
@@ -0,0 +1,393 @@
+#include "contact_solver.h"
+
+#include "worker_pool.h"
+#include "lib.h"
+#include <algorithm>
+
+// sliding slower than this at the start of a step counts as sticking, and gets the static friction coefficient
+static constexpr float CONTACT_STICKING_SPEED = 0.05f;
+
+//******************************************************************************
+// ContactManifold
+//******************************************************************************
+static void GetTangents(const vector3& n, vector3* t0, vector3* t1)
+{
+	// any two directions perpendicular to n and each other, built from whichever axis is furthest from n
+	if (fabsf(n.x) >= 0.57735f)
+	{
+		*t0 = vector3(n.y, -n.x, 0.0f).normalize();
+	}
+	else
+	{
+		*t0 = vector3(0.0f, n.z, -n.y).normalize();
+	}
+	*t1 = n.cross(*t0);
+}
+//******************************************************************************
+void ContactManifold::Refresh(const matrix4& aTransform, const matrix4& bTransform)
+{
+	const matrix3 aRotation = aTransform.rotation_get();
+	const matrix3 bRotation = bTransform.rotation_get();
+	const vector3 aPosition = aTransform.translation_get();
+	const vector3 bPosition = bTransform.translation_get();
+	for (int i = 0; i < numPoints;)
+	{
+		ContactPoint& point = points[i];
+		const vector3 a = aRotation * point.localA + aPosition;
+		const vector3 b = bRotation * point.localB + bPosition;
+		const float depth = (b - a).dot(normal);
+		const vector3 drift = (a - b) + normal * depth; // what's left once the overlap along the normal is taken out
+		if (depth < -CONTACT_BREAKING_THRESHOLD || drift.magnitude_sq() > CONTACT_BREAKING_THRESHOLD * CONTACT_BREAKING_THRESHOLD)
+		{
+			points[i] = points[--numPoints];
+			continue;
+		}
+		const vector3 middle = (a + b) * 0.5f;
+		point.depth = depth;
+		point.rA = middle - aPosition;
+		point.rB = middle - bPosition;
+		i++;
+	}
+}
+//******************************************************************************
+static int GetPointToReplace(const ContactPoint* points, const ContactPoint& point)
+{
+	// never lose the deepest point, of the rest drop the one that leaves the biggest area (in A's space, same as Bullet)
+	int deepest = -1;
+	float maxDepth = point.depth;
+	for (int i = 0; i < CONTACT_MAX_POINTS; i++)
+	{
+		if (points[i].depth > maxDepth)
+		{
+			maxDepth = points[i].depth;
+			deepest = i;
+		}
+	}
+
+	const vector3& p = point.localA;
+	float area[CONTACT_MAX_POINTS] = {};
+	if (deepest != 0) area[0] = (p - points[1].localA).cross(points[3].localA - points[2].localA).magnitude_sq();
+	if (deepest != 1) area[1] = (p - points[0].localA).cross(points[3].localA - points[2].localA).magnitude_sq();
+	if (deepest != 2) area[2] = (p - points[0].localA).cross(points[3].localA - points[1].localA).magnitude_sq();
+	if (deepest != 3) area[3] = (p - points[0].localA).cross(points[2].localA - points[1].localA).magnitude_sq();
+
+	int best = deepest == 0 ? 1 : 0;
+	for (int i = 0; i < CONTACT_MAX_POINTS; i++)
+	{
+		if (i != deepest && area[i] > area[best])
+		{
+			best = i;
+		}
+	}
+	return best;
+}
+//******************************************************************************
+void ContactManifold::AddPoint(const CollisionData& data, const matrix4& aTransform, const matrix4& bTransform)
+{
+	// the newest normal is the best one, every point is measured against it
+	normal = data.penetrationDirection;
+	GetTangents(normal, &tangent[0], &tangent[1]);
+
+	ContactPoint point;
+	point.localA = aTransform.rotation_get().transpose_get() * (data.a_point - aTransform.translation_get());
+	point.localB = bTransform.rotation_get().transpose_get() * (data.b_point - bTransform.translation_get());
+	point.depth = data.depth;
+
+	int closest = -1;
+	float closestDistanceSq = CONTACT_BREAKING_THRESHOLD * CONTACT_BREAKING_THRESHOLD;
+	for (int i = 0; i < numPoints; i++)
+	{
+		const float distanceSq = (points[i].localA - point.localA).magnitude_sq();
+		if (distanceSq < closestDistanceSq)
+		{
+			closestDistanceSq = distanceSq;
+			closest = i;
+		}
+	}
+
+	if (closest >= 0)
+	{
+		// the same contact as before, keep its impulses
+		point.normalImpulse = points[closest].normalImpulse;
+		point.tangentImpulse[0] = points[closest].tangentImpulse[0];
+		point.tangentImpulse[1] = points[closest].tangentImpulse[1];
+		points[closest] = point;
+	}
+	else if (numPoints < CONTACT_MAX_POINTS)
+	{
+		points[numPoints++] = point;
+	}
+	else
+	{
+		points[GetPointToReplace(points, point)] = point;
+	}
+
+	Refresh(aTransform, bTransform);
+}
+
+//******************************************************************************
+// ContactSolver
+//******************************************************************************
+static vector3 GetRelativeVelocity(const SolverBody& a, const SolverBody& b, const ContactPoint& point)
+{
+	return a.linearVelocity + a.angularVelocity.cross(point.rA) - b.linearVelocity - b.angularVelocity.cross(point.rB);
+}
+static vector3 GetRelativePushVelocity(const SolverBody& a, const SolverBody& b, const ContactPoint& point)
+{
+	return a.pushLinearVelocity + a.pushAngularVelocity.cross(point.rA) - b.pushLinearVelocity - b.pushAngularVelocity.cross(point.rB);
+}
+// bodies the solver can't move are shared between islands, they're never written to
+static void ApplyImpulse(SolverBody& a, SolverBody& b, const ContactPoint& point, const vector3& impulse)
+{
+	if (a.invMass > 0.0f)
+	{
+		a.linearVelocity = a.linearVelocity + impulse * a.invMass;
+		a.angularVelocity = a.angularVelocity + a.invInertia * point.rA.cross(impulse);
+	}
+	if (b.invMass > 0.0f)
+	{
+		b.linearVelocity = b.linearVelocity - impulse * b.invMass;
+		b.angularVelocity = b.angularVelocity - b.invInertia * point.rB.cross(impulse);
+	}
+}
+static void ApplyPushImpulse(SolverBody& a, SolverBody& b, const ContactPoint& point, const vector3& impulse)
+{
+	if (a.invMass > 0.0f)
+	{
+		a.pushLinearVelocity = a.pushLinearVelocity + impulse * a.invMass;
+		a.pushAngularVelocity = a.pushAngularVelocity + a.invInertia * point.rA.cross(impulse);
+	}
+	if (b.invMass > 0.0f)
+	{
+		b.pushLinearVelocity = b.pushLinearVelocity - impulse * b.invMass;
+		b.pushAngularVelocity = b.pushAngularVelocity - b.invInertia * point.rB.cross(impulse);
+	}
+}
+static float GetEffectiveMass(const SolverBody& a, const SolverBody& b, const ContactPoint& point, const vector3& direction)
+{
+	const vector3 rnA = point.rA.cross(direction);
+	const vector3 rnB = point.rB.cross(direction);
+	const float k = a.invMass + b.invMass + rnA.dot(a.invInertia * rnA) + rnB.dot(b.invInertia * rnB);
+	return k > 0.0f ? 1.0f / k : 0.0f;
+}
+//******************************************************************************
+int ContactSolver::FindRoot(int body)
+{
+	while (m_parent[body] != body)
+	{
+		m_parent[body] = m_parent[m_parent[body]]; // path halving
+		body = m_parent[body];
+	}
+	return body;
+}
+//******************************************************************************
+void ContactSolver::BuildIslands(SolverBody* bodies, int numBodies, ContactManifold* const* manifolds, int numManifolds)
+{
+	// join everything that touches, the lower index always ends up the root so the islands come out the same every time
+	m_parent.resize(numBodies);
+	for (int i = 0; i < numBodies; i++)
+	{
+		m_parent[i] = i;
+	}
+	for (int i = 0; i < numManifolds; i++)
+	{
+		const ContactManifold* manifold = manifolds[i];
+		if (bodies[manifold->bodyA].invMass > 0.0f && bodies[manifold->bodyB].invMass > 0.0f)
+		{
+			const int a = FindRoot(manifold->bodyA);
+			const int b = FindRoot(manifold->bodyB);
+			if (a != b)
+			{
+				m_parent[max(a, b)] = min(a, b);
+			}
+		}
+	}
+
+	// number the islands in order of their first body, then lay the bodies out island by island
+	m_islands.clear();
+	m_rootIsland.assign(numBodies, -1);
+	for (int i = 0; i < numBodies; i++)
+	{
+		bodies[i].island = -1;
+		if (bodies[i].invMass > 0.0f)
+		{
+			const int root = FindRoot(i);
+			if (m_rootIsland[root] < 0)
+			{
+				m_rootIsland[root] = (int)m_islands.size();
+				m_islands.push_back({ 0, 0, 0, 0 });
+			}
+			bodies[i].island = m_rootIsland[root];
+			m_islands[bodies[i].island].numBodies++;
+		}
+	}
+	for (int i = 0; i < numManifolds; i++)
+	{
+		const int island = bodies[manifolds[i]->bodyA].island >= 0 ? bodies[manifolds[i]->bodyA].island : bodies[manifolds[i]->bodyB].island;
+		if (island >= 0)
+		{
+			m_islands[island].numManifolds++;
+		}
+	}
+
+	int bodyCount = 0;
+	int manifoldCount = 0;
+	for (ContactIsland& island : m_islands)
+	{
+		island.firstBody = bodyCount;
+		island.firstManifold = manifoldCount;
+		bodyCount += island.numBodies;
+		manifoldCount += island.numManifolds;
+		island.numBodies = 0;
+		island.numManifolds = 0;
+	}
+	m_islandBodies.resize(bodyCount);
+	m_islandManifolds.resize(manifoldCount);
+	for (int i = 0; i < numBodies; i++)
+	{
+		if (bodies[i].island >= 0)
+		{
+			ContactIsland& island = m_islands[bodies[i].island];
+			m_islandBodies[island.firstBody + island.numBodies++] = i;
+		}
+	}
+	for (int i = 0; i < numManifolds; i++)
+	{
+		const int index = bodies[manifolds[i]->bodyA].island >= 0 ? bodies[manifolds[i]->bodyA].island : bodies[manifolds[i]->bodyB].island;
+		if (index >= 0)
+		{
+			ContactIsland& island = m_islands[index];
+			m_islandManifolds[island.firstManifold + island.numManifolds++] = manifolds[i];
+		}
+	}
+}
+//******************************************************************************
+void ContactSolver::SolveIsland(const ContactIsland& island) const
+{
+	const PhysicsSolverSettings& settings = *m_settings;
+	const float invDt = m_dt > 0.0f ? 1.0f / m_dt : 0.0f;
+	ContactManifold* const* manifolds = &m_islandManifolds[island.firstManifold];
+
+	// work out everything that stays the same over the iterations, then start from last step's impulses
+	for (int m = 0; m < island.numManifolds; m++)
+	{
+		ContactManifold& manifold = *manifolds[m];
+		SolverBody& a = m_bodies[manifold.bodyA];
+		SolverBody& b = m_bodies[manifold.bodyB];
+		for (int i = 0; i < manifold.numPoints; i++)
+		{
+			ContactPoint& point = manifold.points[i];
+			point.normalMass = GetEffectiveMass(a, b, point, manifold.normal);
+			point.tangentMass[0] = GetEffectiveMass(a, b, point, manifold.tangent[0]);
+			point.tangentMass[1] = GetEffectiveMass(a, b, point, manifold.tangent[1]);
+
+			// only bounce off things hit hard enough, resting contacts would never settle otherwise
+			const vector3 dv = GetRelativeVelocity(a, b, point);
+			const float vn = dv.dot(manifold.normal);
+			point.velocityBias = (vn < -settings.restitutionThreshold) ? -manifold.restitution * vn : 0.0f;
+
+			const float penetration = point.depth - settings.linearSlop;
+			const float correction = settings.baumgarte * invDt * max(penetration, 0.0f);
+			point.pushBias = settings.splitImpulse ? correction : 0.0f;
+			point.velocityBias += settings.splitImpulse ? 0.0f : correction;
+			point.pushImpulse = 0.0f;
+
+			const vector3 slide = dv - manifold.normal * vn;
+			const bool sticking = slide.magnitude_sq() < CONTACT_STICKING_SPEED * CONTACT_STICKING_SPEED;
+			point.friction = (sticking || manifold.dynamicFriction == 0.0f) ? manifold.staticFriction : manifold.dynamicFriction;
+
+			if (settings.warmStarting)
+			{
+				const vector3 impulse = manifold.normal * point.normalImpulse + manifold.tangent[0] * point.tangentImpulse[0] + manifold.tangent[1] * point.tangentImpulse[1];
+				ApplyImpulse(a, b, point, impulse);
+			}
+			else
+			{
+				point.normalImpulse = 0.0f;
+				point.tangentImpulse[0] = 0.0f;
+				point.tangentImpulse[1] = 0.0f;
+			}
+		}
+	}
+
+	for (int iteration = 0; iteration < settings.velocityIterations; iteration++)
+	{
+		for (int m = 0; m < island.numManifolds; m++)
+		{
+			ContactManifold& manifold = *manifolds[m];
+			SolverBody& a = m_bodies[manifold.bodyA];
+			SolverBody& b = m_bodies[manifold.bodyB];
+			for (int i = 0; i < manifold.numPoints; i++)
+			{
+				ContactPoint& point = manifold.points[i];
+
+				// friction first, limited by the normal impulse so far
+				const float maxFriction = point.friction * point.normalImpulse;
+				for (int t = 0; t < 2; t++)
+				{
+					const float vt = GetRelativeVelocity(a, b, point).dot(manifold.tangent[t]);
+					const float previous = point.tangentImpulse[t];
+					const float total = previous - point.tangentMass[t] * vt;
+					point.tangentImpulse[t] = clamp(total, -maxFriction, maxFriction);
+					ApplyImpulse(a, b, point, manifold.tangent[t] * (point.tangentImpulse[t] - previous));
+				}
+
+				// the total impulse can only ever push them apart, but one iteration can take back what another gave
+				{
+					const float vn = GetRelativeVelocity(a, b, point).dot(manifold.normal);
+					const float previous = point.normalImpulse;
+					const float total = previous - point.normalMass * (vn - point.velocityBias);
+					point.normalImpulse = max(total, 0.0f);
+					ApplyImpulse(a, b, point, manifold.normal * (point.normalImpulse - previous));
+				}
+
+				if (point.pushBias > 0.0f || point.pushImpulse > 0.0f)
+				{
+					const float vn = GetRelativePushVelocity(a, b, point).dot(manifold.normal);
+					const float previous = point.pushImpulse;
+					const float total = previous - point.normalMass * (vn - point.pushBias);
+					point.pushImpulse = max(total, 0.0f);
+					ApplyPushImpulse(a, b, point, manifold.normal * (point.pushImpulse - previous));
+				}
+			}
+		}
+	}
+}
+//******************************************************************************
+void ContactSolver::SolveIslandRange(int begin, int end, int /*threadIndex*/, void* userData)
+{
+	const ContactSolver* solver = (const ContactSolver*)userData;
+	for (int i = begin; i < end; i++)
+	{
+		solver->SolveIsland(solver->m_islands[solver->m_solveOrder[i]]);
+	}
+}
+//******************************************************************************
+void ContactSolver::Solve(SolverBody* bodies, int numBodies, ContactManifold* const* manifolds, int numManifolds, float dt, const PhysicsSolverSettings& settings)
+{
+	for (int i = 0; i < numBodies; i++)
+	{
+		bodies[i].pushLinearVelocity = vector3();
+		bodies[i].pushAngularVelocity = vector3();
+	}
+	BuildIslands(bodies, numBodies, manifolds, numManifolds);
+
+	// islands don't touch, so each can go to any thread and still come out exactly the same.  Hand out the
+	// big ones first so one doesn't get left running on its own at the end
+	m_solveOrder.clear();
+	for (int i = 0; i < (int)m_islands.size(); i++)
+	{
+		if (m_islands[i].numManifolds > 0)
+		{
+			m_solveOrder.push_back(i);
+		}
+	}
+	std::stable_sort(m_solveOrder.begin(), m_solveOrder.end(), [this](int a, int b) { return m_islands[a].numManifolds > m_islands[b].numManifolds; });
+
+	m_bodies = bodies;
+	m_dt = dt;
+	m_settings = &settings;
+	WorkerPool_ParallelFor((int)m_solveOrder.size(), 4, SolveIslandRange, this);
+	m_bodies = nullptr;
+	m_settings = nullptr;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "physics.h"
+#include <vector>
+
+//******************************************************************************
+// ContactSolver - sequential impulses over persistent contact manifolds
+//   Every contact point keeps the impulse it ended the last step with.  Applying
+//   those up front (warm starting) means a resting stack starts the step already
+//   nearly solved, so a few iterations are enough to hold it still.  Penetration
+//   is corrected either with extra velocity (Baumgarte) or with a separate push
+//   velocity that only moves the bodies this step (split impulse), which doesn't
+//   turn the correction into bounce.
+//   Bodies that touch (through anything but static bodies) form an island, islands
+//   don't share anything the solver writes to so they're solved in parallel.
+//******************************************************************************
+
+// everything the solver needs to know about a body, gathered before Solve and read back after
+struct SolverBody
+{
+	vector3 linearVelocity;
+	vector3 angularVelocity;
+	vector3 pushLinearVelocity;   // split impulse, to be added to the velocity for this step's move only
+	vector3 pushAngularVelocity;
+	vector3 position;             // the point the contact offsets are measured from (the transform's origin)
+	matrix3 invInertia = matrix3(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+	float   invMass = 0.0f;       // zero for anything the solver can't move, it's left as it is
+	int     island = -1;          // set by Solve, -1 if the solver can't move it
+};
+
+static constexpr int   CONTACT_MAX_POINTS = 4;
+static constexpr float CONTACT_BREAKING_THRESHOLD = 0.02f; // points that separate or slide further than this are dropped
+
+struct ContactPoint
+{
+	vector3 localA;         // where it was found on each body, in that body's space, so it can be followed
+	vector3 localB;
+	vector3 rA;             // from each body's position to the contact, as of the last Refresh/AddPoint
+	vector3 rB;
+	float   depth = 0.0f;   // along the manifold normal, as of the last Refresh/AddPoint
+
+	// accumulated over the step, and carried to the next one for warm starting
+	float   normalImpulse = 0.0f;
+	float   tangentImpulse[2] = { 0.0f, 0.0f };
+
+	// worked out by the solver at the start of each step (so PhysicsSnapshot leaves everything from here on out)
+	float   pushImpulse = 0.0f;
+	float   normalMass = 0.0f;
+	float   tangentMass[2] = { 0.0f, 0.0f };
+	float   velocityBias = 0.0f;
+	float   pushBias = 0.0f;
+	float   friction = 0.0f;
+};
+
+// The contact points between two bodies.  The narrowphase finds one point a step, the manifold
+// holds on to the ones found before for as long as they stay put, so a box settles onto a
+// floor with points at its corners rather than rocking around a single one.
+struct ContactManifold
+{
+	int     bodyA = -1;     // index into the SolverBody array, filled in before every Solve
+	int     bodyB = -1;
+	vector3 normal;         // from B to A, the way A has to go to get out
+	vector3 tangent[2];
+	float   staticFriction = 0.0f;
+	float   dynamicFriction = 0.0f;
+	float   restitution = 0.0f;
+	int     numPoints = 0;
+	ContactPoint points[CONTACT_MAX_POINTS];
+
+	// moves the points along with the bodies, dropping any that came apart or slid away
+	void Refresh(const matrix4& aTransform, const matrix4& bTransform);
+	// adds the narrowphase's latest point (and takes its normal).  A point found close to an
+	// old one takes over its impulses, and when full the point dropped is the one that leaves
+	// the rest covering the most area.
+	void AddPoint(const CollisionData& data, const matrix4& aTransform, const matrix4& bTransform);
+};
+
+// bodies and manifolds in one island are contiguous in ContactSolver's lists
+struct ContactIsland
+{
+	int firstBody;
+	int numBodies;
+	int firstManifold;
+	int numManifolds;
+};
+
+class ContactSolver
+{
+public:
+	// Builds the islands, then solves the contacts, leaving the new velocities (and push velocities) in bodies
+	void Solve(SolverBody* bodies, int numBodies, ContactManifold* const* manifolds, int numManifolds, float dt, const PhysicsSolverSettings& settings);
+
+	// as of the last Solve, every body the solver can move is in exactly one island (maybe on its own)
+	const std::vector<ContactIsland>& GetIslands() const { return m_islands; }
+	int GetIslandBody(int index) const { return m_islandBodies[index]; }
+
+private:
+	int  FindRoot(int body);
+	void BuildIslands(SolverBody* bodies, int numBodies, ContactManifold* const* manifolds, int numManifolds);
+	void SolveIsland(const ContactIsland& island) const;
+	static void SolveIslandRange(int begin, int end, int threadIndex, void* userData);
+
+	std::vector<int>              m_parent;          // union-find over the bodies
+	std::vector<int>              m_rootIsland;
+	std::vector<ContactIsland>    m_islands;
+	std::vector<int>              m_islandBodies;
+	std::vector<ContactManifold*> m_islandManifolds;
+	std::vector<int>              m_solveOrder;      // islands with contacts, biggest first
+
+	// for SolveIslandRange
+	SolverBody*                   m_bodies = nullptr;
+	float                         m_dt = 0.0f;
+	const PhysicsSolverSettings*  m_settings = nullptr;
+};
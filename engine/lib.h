@@ -4,6 +4,12 @@
 #include <cmath>
 #include <stdlib.h>
 #include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#if defined(_WIN32)
+#include <malloc.h> // _aligned_malloc
+#endif
 
 
 #ifndef PI
@@ -35,6 +41,105 @@ static inline bool FloatGreaterThanEquals(float a, float b, float tolerance = KI
 static inline bool different_sign(float a, float b) { return a * b < 0.0f; }
 static inline bool same_sign(float a, float b) { return a * b >= 0.0f; }
 
+//******************************************************************************
+// Math_ - the square root and trig the simulation uses
+//   The C library's sin, cos and atan2 are only good to an ulp or so, and which way they're out
+//   differs between GCC, Clang and MSVC (and between versions of each), which is enough for two
+//   builds of the same simulation to drift apart.  Defining DETERMINISTIC_MATH swaps them for the
+//   versions below, made of nothing but + - * / and floor, which IEEE 754 pins down to the bit, as it
+//   does sqrt (so that one is left to the hardware).  That only holds if the compiler does exactly
+//   what the source says, so the mode also needs float maths done in float (SSE2, not x87), no
+//   -ffast-math or /fp:fast, and no fusing a * b + c into an FMA: -ffp-contract=off on GCC and Clang
+//   (which the pragmas below also turn off, from here on), MSVC's /fp:precise doesn't fuse unless
+//   asked to with /fp:contract.
+//******************************************************************************
+#ifdef DETERMINISTIC_MATH
+#include <cfloat>
+#if defined(__FAST_MATH__) || defined(_M_FP_FAST)
+#error "DETERMINISTIC_MATH can't be built with fast (reordered) floating point"
+#endif
+#if (defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0) || (defined(_M_IX86) && (!defined(_M_IX86_FP) || _M_IX86_FP < 2))
+#error "DETERMINISTIC_MATH needs float maths done in float (SSE2), not at x87's extended precision"
+#endif
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+// in case the build didn't pass -ffp-contract=off, GCC's default fuses wherever the target has an FMA
+#pragma GCC optimize("fp-contract=off")
+#endif
+#endif
+
+// sin and cos together, they share the range reduction.  Within an ulp or two of the real thing for
+// |x| up to a few thousand, further out the reduction loses accuracy (but still comes out the same everywhere)
+static inline void Math_SoftSinCos(float x, float* outSin, float* outCos)
+{
+	// take off the nearest multiple of pi/2, in three parts so each product is exact for any sensible x
+	const float k = floorf(x * 0.636619772f + 0.5f);
+	const float r = ((x - k * 1.5703125f) - k * 4.83751297e-4f) - k * 7.54978995e-8f;
+	// then minimax polynomials (from Cephes) over [-pi/4, pi/4]
+	const float z = r * r;
+	const float s = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * r + r;
+	const float c = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+	switch ((int)k & 3)
+	{
+	case 0: *outSin = s;  *outCos = c;  break;
+	case 1: *outSin = c;  *outCos = -s; break;
+	case 2: *outSin = -s; *outCos = -c; break;
+	default: *outSin = -c; *outCos = s; break;
+	}
+}
+static inline float Math_SoftAtan(float x)
+{
+	// atan(x) = pi/2 - atan(1/x) = pi/4 + atan((x-1)/(x+1)), whichever keeps the argument smallest
+	const float ax = fabsf(x);
+	float offset = 0.0f;
+	float t = ax;
+	if (ax > 2.414213562f) // tan(3pi/8)
+	{
+		offset = PI * 0.5f;
+		t = -1.0f / ax;
+	}
+	else if (ax > 0.414213562f) // tan(pi/8)
+	{
+		offset = PI * 0.25f;
+		t = (ax - 1.0f) / (ax + 1.0f);
+	}
+	const float z = t * t;
+	const float y = offset + ((((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * t + t);
+	return x < 0.0f ? -y : y;
+}
+static inline float Math_SoftAtan2(float y, float x)
+{
+	if (x == 0.0f)
+	{
+		return y > 0.0f ? PI * 0.5f : (y < 0.0f ? -PI * 0.5f : 0.0f);
+	}
+	const float a = Math_SoftAtan(y / x);
+	return x > 0.0f ? a : (y < 0.0f ? a - PI : a + PI);
+}
+
+#ifdef DETERMINISTIC_MATH
+static inline float Math_Sin(float x) { float s, c; Math_SoftSinCos(x, &s, &c); return s; }
+static inline float Math_Cos(float x) { float s, c; Math_SoftSinCos(x, &s, &c); return c; }
+static inline float Math_Atan2(float y, float x) { return Math_SoftAtan2(y, x); }
+#else
+static inline float Math_Sin(float x) { return sinf(x); }
+static inline float Math_Cos(float x) { return cosf(x); }
+static inline float Math_Atan2(float y, float x) { return atan2f(y, x); }
+#endif
+static inline float Math_Sqrt(float x) { return sqrtf(x); } // correctly rounded everywhere, IEEE 754 says so
+
+// 64 bit FNV-1a, chain calls by passing the last result back in as hash
+static inline uint64_t Hash_FNV1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
 template<typename T> void swap(T& a, T& b) { T tmp = a; a = b; b = tmp; }
 template<typename T> void sort3(T a[3])
 {
@@ -59,4 +164,105 @@ template<typename T> void sort4(T a[4])
 		swap(a[1], a[3]);
 	if (a[2] > a[3])
 		swap(a[2], a[3]);
-}
\ No newline at end of file
+}
+
+//******************************************************************************
+// FixedArray - vector-like container with inline storage
+//   never touches the heap, so it is safe to use in hot paths (i.e. narrowphase)
+//******************************************************************************
+template<typename T, int N>
+class FixedArray
+{
+public:
+	int  size() const     { return m_size; }
+	int  capacity() const { return N; }
+	bool full() const     { return m_size == N; }
+	bool empty() const    { return m_size == 0; }
+
+	void clear() { m_size = 0; }
+	void resize(int n)
+	{
+		assert(n >= 0 && n <= N);
+		m_size = n;
+	}
+	void push_back(const T& v)
+	{
+		assert(m_size < N);
+		m_data[m_size++] = v;
+	}
+	void pop_back()
+	{
+		assert(m_size > 0);
+		--m_size;
+	}
+	// keeps the order of the remaining elements
+	void erase(int index)
+	{
+		assert(index >= 0 && index < m_size);
+		for (int i = index; i < m_size - 1; i++)
+		{
+			m_data[i] = m_data[i + 1];
+		}
+		--m_size;
+	}
+
+	T&       operator[](int i)       { assert(i >= 0 && i < m_size); return m_data[i]; }
+	const T& operator[](int i) const { assert(i >= 0 && i < m_size); return m_data[i]; }
+	T&       back()                  { assert(m_size > 0); return m_data[m_size - 1]; }
+	const T& back() const            { assert(m_size > 0); return m_data[m_size - 1]; }
+
+	T*       begin()       { return m_data; }
+	T*       end()         { return m_data + m_size; }
+	const T* begin() const { return m_data; }
+	const T* end()   const { return m_data + m_size; }
+
+private:
+	T   m_data[N];
+	int m_size = 0;
+};
+
+//******************************************************************************
+// AlignedAllocator - std allocator returning memory aligned to Alignment bytes
+//   i.e. std::vector<float, AlignedAllocator<float, 32>> for data read with aligned SIMD loads
+//******************************************************************************
+template<typename T, size_t Alignment>
+struct AlignedAllocator
+{
+	typedef T value_type;
+	template<typename U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+	AlignedAllocator() {}
+	template<typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t n)
+	{
+		if (n > SIZE_MAX / sizeof(T))
+		{
+			throw std::bad_alloc();
+		}
+#if defined(_WIN32)
+		void* p = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+		void* p = nullptr;
+		if (posix_memalign(&p, Alignment < sizeof(void*) ? sizeof(void*) : Alignment, n * sizeof(T)) != 0)
+		{
+			p = nullptr;
+		}
+#endif
+		if (!p)
+		{
+			throw std::bad_alloc();
+		}
+		return (T*)p;
+	}
+	void deallocate(T* p, size_t)
+	{
+#if defined(_WIN32)
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+	bool operator==(const AlignedAllocator&) const { return true; }
+	bool operator!=(const AlignedAllocator&) const { return false; }
+};
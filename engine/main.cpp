@@ -8,6 +8,7 @@ struct CommandLineParams
 	bool test_physics = false;
 	bool test_3d = false;
 	bool test_2d = false;
+	bool benchmark = false;
 };
 
 void ParseCommandArgs(int argc, char* argv[], CommandLineParams& outParams)
@@ -30,6 +31,10 @@ void ParseCommandArgs(int argc, char* argv[], CommandLineParams& outParams)
 		{
 			outParams.test_2d = true;
 		}
+		if (strcmp(argv[i], "benchmark") == 0)
+		{
+			outParams.benchmark = true;
+		}
 	}
 }
 
@@ -54,6 +59,10 @@ int main(int argc, char *argv[])
 	{
 		Test2D();
 	}
+	else if (params.benchmark)
+	{
+		TestBenchmark();
+	}
 
 	return 0;
 }
\ No newline at end of file
@@ -55,6 +55,16 @@ public:
 		y1 = b1; y2 = b2; y3 = b3;
 		z1 = c1; z2 = c2; z3 = c3;
 	}
+	// the rotation q (which has to be unit length) does to a vector
+	explicit matrix3(const quaternion& q)
+	{
+		const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		const float xw = q.x * q.w, yw = q.y * q.w, zw = q.z * q.w;
+		x1 = 1.0f - 2.0f * (yy + zz); x2 = 2.0f * (xy - zw);        x3 = 2.0f * (xz + yw);
+		y1 = 2.0f * (xy + zw);        y2 = 1.0f - 2.0f * (xx + zz); y3 = 2.0f * (yz - xw);
+		z1 = 2.0f * (xz - yw);        z2 = 2.0f * (yz + xw);        z3 = 1.0f - 2.0f * (xx + yy);
+	}
 
 	vector3 operator*(const vector3 B) const
 	{
@@ -64,6 +74,12 @@ public:
 		v.z = z1 * B.x + z2 * B.y + z3 * B.z;
 		return v;
 	}
+	matrix3 operator*(const matrix3& B) const
+	{
+		return matrix3(x1 * B.x1 + x2 * B.y1 + x3 * B.z1, x1 * B.x2 + x2 * B.y2 + x3 * B.z2, x1 * B.x3 + x2 * B.y3 + x3 * B.z3,
+		               y1 * B.x1 + y2 * B.y1 + y3 * B.z1, y1 * B.x2 + y2 * B.y2 + y3 * B.z2, y1 * B.x3 + y2 * B.y3 + y3 * B.z3,
+		               z1 * B.x1 + z2 * B.y1 + z3 * B.z1, z1 * B.x2 + z2 * B.y2 + z3 * B.z2, z1 * B.x3 + z2 * B.y3 + z3 * B.z3);
+	}
 
 	matrix3 transpose_get() const
 	{
@@ -280,11 +296,35 @@ public:
 			            x4, y4, z4, w4);
 	}
 
+	// upper 3x3, the rotation part of the transform without the translation
+	matrix3 rotation_get() const
+	{
+		return matrix3(x1, x2, x3,
+			           y1, y2, y3,
+			           z1, z2, z3);
+	}
+
 	void rotate(const vector3& r)
 	{
-		x1 = cos(r.y)*cos(r.z);   x2 = sin(r.x)*sin(r.y)*cos(r.z) - cos(r.x)*sin(r.z);    x3 = cos(r.x)*sin(r.y)*cos(r.z) + sin(r.x)*sin(r.z);
-		y1 = cos(r.y)*sin(r.z);   y2 = sin(r.x)*sin(r.y)*sin(r.z) + cos(r.x)*cos(r.z);    y3 = cos(r.x)*sin(r.y)*sin(r.z) - sin(r.x)*cos(r.z);
-		z1 = -sin(r.y);           z2 = sin(r.x)*cos(r.y);                                 z3 = cos(r.x)*cos(r.y);
+		const float sx = Math_Sin(r.x), cx = Math_Cos(r.x);
+		const float sy = Math_Sin(r.y), cy = Math_Cos(r.y);
+		const float sz = Math_Sin(r.z), cz = Math_Cos(r.z);
+		x1 = cy*cz;   x2 = sx*sy*cz - cx*sz;    x3 = cx*sy*cz + sx*sz;
+		y1 = cy*sz;   y2 = sx*sy*sz + cx*cz;    y3 = cx*sy*sz - sx*cz;
+		z1 = -sy;     z2 = sx*cy;               z3 = cx*cy;
+	}
+	// same as above for a rotation that's already a (unit) quaternion, without any trig
+	void rotate(const quaternion& q)
+	{
+		const matrix3 m(q);
+		x1 = m.x1; x2 = m.x2; x3 = m.x3;
+		y1 = m.y1; y2 = m.y2; y3 = m.y3;
+		z1 = m.z1; z2 = m.z2; z3 = m.z3;
+	}
+
+	vector3 translation_get() const
+	{
+		return vector3(x4, y4, z4);
 	}
 
 	void set_translation(const vector3& t)
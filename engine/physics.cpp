@@ -1,194 +1,1440 @@
 #include "physics.h"
 
 #include "physics_shape.h"
+#include "broadphase.h"
+#include "aabb_tree.h"
+#include "spatial_hash.h"
+#include "contact_solver.h"
+#include "physics_util.h"
 #include <vector>
+#include <algorithm>
 #include <list>
+#include <map>
+#include <cfloat>
+#include <atomic>
+#include <type_traits>
 
 #define DEBUG_ENERGY 0
 
-static std::vector<Physics*> s_physicsList(0);
+// Continuous collision: objects that move more than this fraction of their size in a step get swept
+static constexpr float CCD_MOTION_THRESHOLD = 0.5f;
+static constexpr int   CCD_MAX_ITERATIONS = 32; // conservative advancement steps before calling it a hit anyway
+static constexpr int   CCD_MAX_SUBSTEPS = 4;    // collisions resolved per object per step, the rest of the step is left unswept
 
-Physics::Physics(PhysicsShape* shape, const StaticPhysicsData& physicsData)
-    : m_physicsShape(shape)
-    , m_static(physicsData)
+static Broadphase* CreateBroadphase(BROADPHASE_TYPE type)
 {
-    m_position = physicsData.m_initialPosition;
-    m_rotation = physicsData.m_initialRotation;
-    s_physicsList.push_back(this);
+    switch (type)
+    {
+        case BROADPHASE_AABB_TREE:
+            return new AABBTree();
+        case BROADPHASE_SPATIAL_HASH:
+            return new SpatialHashGrid();
+        case BROADPHASE_SWEEP_AND_PRUNE:
+        default:
+            return new SweepAndPrune();
+    }
 }
 
-Physics::~Physics()
+// for every pair the broadphase has put together (keyed on the pair of proxies): GJK warm-start state so
+// the next step can start where this one ended, and the contact points the solver is holding on to
+struct PairState
+{
+    CollisionCache  cache;
+    ContactManifold manifold;
+};
+struct PhysicsWorld::Contacts
+{
+    std::map<uint64_t, PairState> pairs;
+    ContactSolver                 solver;
+    ContactSolver                 impactSolver; // ResolveImpact's, kept so its buffers are only allocated once
+    std::vector<SolverBody>       bodies; // one per body, in the same order
+    std::vector<int>              sweepCandidates; // UpdateContinuous's broadphase query results
+};
+
+// the broadphase's user data is the body's handle slot (plus one, so a removed body's null is never a slot)
+static void* GetProxyUserData(uint32_t slot)
 {
-    // TODO: remove them from the list
-}
-
-
-//-------------------------------------------------------------------------------------------------
-void Physics::ApplyImpulseResponse(CollisionData& data, vector3 n)
-{
-    vector3 r = data.penetrationDirection;
-
-    // Attempt to move the bodies out of the collision
-    vector3 v = m_linearMomentum * (1.0f / m_static.m_mass);
-    vector3 w = m_static.m_inverseInertiaTensor * m_angularMomentum;
-
-    // Apply the forces to the bodies
-    // rigid body impulse response
-    vector3 velocityAtPoint = v + w.cross(r);
-    float i = -(1.0f + m_static.m_elasticity) * velocityAtPoint.dot(n);
-    float k = (1.0f / m_static.m_mass) + ((m_static.m_inverseInertiaTensor * r.cross(n)).cross(r)).dot(n);
-    float j = i / k;
-    m_linearMomentum = m_linearMomentum + n * j;
-    m_angularMomentum = m_angularMomentum + r.cross(n) * j;
-
-    // now adjust the position so it is no longer colliding
-    const float adjust = data.depth * 1.01f;
-    m_position = m_position + n * adjust;
-
-    // apply friction
-    //if (m_static.m_staticFrictionCoeff)
-    //{
-    //    v = m_linearMomentum * (1.0f / m_static.m_mass);
-    //    velocityAtPoint = v + w.cross(r);
-    //    float relVelNormal = velocityAtPoint.dot(n);
-    //    if (!FloatEquals(relVelNormal, 0.0f))
-    //    {
-    //        vector3 vt = velocityAtPoint - n * relVelNormal; // velocity in directions other than contact normal
-    //        vt.normalize();
-    //        float it = velocityAtPoint.dot(vt);
-    //        float kt = (1.0f / m_static.m_mass) + ((m_static.m_inverseInertiaTensor * r.cross(vt)).cross(r)).dot(vt);
-    //        float frictionCoeff = m_static.m_staticFrictionCoeff * j;
-    //        float jt = clamp(-it / kt, -frictionCoeff, frictionCoeff);
-    //        m_linearMomentum = m_linearMomentum + vt * jt;
-    //        m_angularMomentum = m_angularMomentum + r.cross(vt) * jt;
-    //    }
-    //    else
-    //    {
-    //        // if the sum of all external forces on the body are non-zero, we can use that?  
-    //        // see https://en.wikipedia.org/wiki/Collision_response
-    //    }
-    //
-    //
-    //}
+    return (void*)(uintptr_t)(slot + 1);
+}
 
+//-------------------------------------------------------------------------------------------------
+static std::atomic<uint32_t> s_nextWorldSerial(1);
 
-#if DEBUG_ENERGY
-    if (!FloatEquals(m_static.m_mass, 0.0f))
+PhysicsWorld::PhysicsWorld()
+    : m_broadphase(CreateBroadphase(BROADPHASE_SWEEP_AND_PRUNE))
+    , m_contacts(new Contacts())
+    , m_serial(s_nextWorldSerial++)
+{
+}
+//-------------------------------------------------------------------------------------------------
+PhysicsWorld::~PhysicsWorld()
+{
+    delete m_contacts;
+    delete m_broadphase;
+}
+//-------------------------------------------------------------------------------------------------
+PhysicsHandle PhysicsWorld::AddBody(const PhysicsShape* shape, const StaticPhysicsData& data, Physics* owner)
+{
+    PhysicsHandle handle;
+    if (!m_freeSlots.empty())
+    {
+        handle.index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else
+    {
+        handle.index = (uint32_t)m_slots.size();
+        m_slots.push_back(Slot());
+    }
+    const int index = GetBodyCount();
+    m_slots[handle.index].index = (uint32_t)index;
+    handle.generation = m_slots[handle.index].generation;
+
+    // massless objects are as good as static, they don't move
+    const bool hasMass = !FloatEquals(data.m_mass, 0.0f);
+    m_position.push_back(data.m_initialPosition);
+    m_rotation.push_back(quaternion::from_euler(data.m_initialRotation.x, data.m_initialRotation.y, data.m_initialRotation.z));
+    m_previousPosition.push_back(m_position[index]);
+    m_previousRotation.push_back(m_rotation[index]);
+    m_linearMomentum.push_back(vector3());
+    m_angularMomentum.push_back(vector3());
+    m_mass.push_back(data.m_mass);
+    m_invMass.push_back(hasMass ? 1.0f / data.m_mass : 0.0f);
+    m_invInertia.push_back(data.m_inverseInertiaTensor);
+    m_gravity.push_back(data.m_gravity);
+    m_sleepTime.push_back(0.0f);
+    m_flags.push_back(BODY_TRANSFORM_DIRTY);
+    m_transform.push_back(matrix4());
+    m_invInertiaWorld.push_back(matrix3());
+    m_worldAABB.push_back(aabb());
+    m_broadphaseProxy.push_back(-1);
+    m_shape.push_back(shape);
+    m_boundingRadius.push_back(shape->GetBoundingRadius());
+    m_static.push_back(data);
+    m_owner.push_back(owner);
+    m_slotOf.push_back(handle.index);
+
+    UpdateTransform(index);
+    m_broadphaseProxy[index] = m_broadphase->AddProxy(m_worldAABB[index], GetProxyUserData(handle.index));
+    m_flags[index] &= ~BODY_BROADPHASE_DIRTY;
+    m_broadphaseStale = true;
+    m_layoutVersion++;
+    return handle;
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::RemoveBody(PhysicsHandle handle)
+{
+    // its pairs go when the broadphase reports them removed, on the next Update.  Anything that was sleeping
+    // on it is woken then too, it has nothing to rest on any more
+    const int index = GetIndex(handle);
+    m_broadphase->RemoveProxy(m_broadphaseProxy[index]);
+    m_broadphaseStale = true;
+
+    // the last body fills the gap
+    const int last = GetBodyCount() - 1;
+    auto removeFrom = [index, last](auto& pool)
+    {
+        pool[index] = pool[last];
+        pool.pop_back();
+    };
+    m_position.RemoveSwapBack(index);
+    m_rotation.RemoveSwapBack(index);
+    m_previousPosition.RemoveSwapBack(index);
+    m_previousRotation.RemoveSwapBack(index);
+    m_linearMomentum.RemoveSwapBack(index);
+    m_angularMomentum.RemoveSwapBack(index);
+    removeFrom(m_mass);
+    removeFrom(m_invMass);
+    m_invInertia.RemoveSwapBack(index);
+    m_gravity.RemoveSwapBack(index);
+    removeFrom(m_sleepTime);
+    removeFrom(m_flags);
+    removeFrom(m_transform);
+    m_invInertiaWorld.RemoveSwapBack(index);
+    removeFrom(m_worldAABB);
+    removeFrom(m_broadphaseProxy);
+    removeFrom(m_shape);
+    removeFrom(m_boundingRadius);
+    removeFrom(m_static);
+    removeFrom(m_owner);
+    removeFrom(m_slotOf);
+    if (index != last)
     {
-        vector3 vel = m_linearMomentum * (1.0f / m_static.m_mass);
-        vector3 rot = m_static.m_inverseInertiaTensor * m_angularMomentum;
-        float Ke_translate = 0.5f * m_static.m_mass * vel.magnitude() * vel.magnitude();
-        float Pe_gravity = m_static.m_mass * m_static.m_gravity.magnitude() * m_position.y;
-        float Ke_rotate = 0.5f * m_static.m_momentOfInertia * rot.magnitude() * rot.magnitude();
-        printf("Kinetic Energy After: %f (tran=%f (P=%f,K=%f) | rot=%f)\n", Ke_translate + Ke_rotate + Pe_gravity, Ke_translate + Pe_gravity, Pe_gravity, Ke_translate, Ke_rotate);
+        m_slots[m_slotOf[index]].index = (uint32_t)index;
     }
+
+    Slot& slot = m_slots[handle.index];
+    slot.index = UINT32_MAX;
+    slot.generation++;
+    m_freeSlots.push_back(handle.index);
+    m_layoutVersion++;
+}
+//-------------------------------------------------------------------------------------------------
+bool PhysicsWorld::IsValid(PhysicsHandle handle) const
+{
+    return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation && m_slots[handle.index].index != UINT32_MAX;
+}
+//-------------------------------------------------------------------------------------------------
+int PhysicsWorld::GetIndex(PhysicsHandle handle) const
+{
+    assert(IsValid(handle));
+    return (int)m_slots[handle.index].index;
+}
+//-------------------------------------------------------------------------------------------------
+int PhysicsWorld::GetBodyFromProxy(int proxy) const
+{
+    const uintptr_t data = (uintptr_t)m_broadphase->GetUserData(proxy);
+    return data ? (int)m_slots[data - 1].index : -1;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::GetSolverBody(int index, SolverBody* out) const
+{
+    // anything that doesn't respond to collisions is as good as infinitely heavy, it keeps whatever velocity it has
+    const bool responds = m_static[index].m_collisionResponseType == COLLISION_RESPONSE_IMPULSE && IsMoving(index);
+    out->linearVelocity = GetLinearVelocity(index);
+    out->angularVelocity = GetAngularVelocity(index);
+    out->position = m_position[index];
+    out->invMass = responds ? m_invMass[index] : 0.0f;
+    out->invInertia = responds ? m_invInertiaWorld[index] : matrix3(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::SetSolverBody(int index, const SolverBody& body)
+{
+    if (body.invMass == 0.0f)
+    {
+        return;
+    }
+    // back from velocities to momentum, through the same world space inverse inertia GetSolverBody handed out
+    // (a body can be set up with only the inverse tensor).  One that can't turn about some axis can't have had
+    // its spin changed by the solver either, so it keeps the momentum it had
+    const StaticPhysicsData& data = m_static[index];
+    m_linearMomentum.Set(index, body.linearVelocity * data.m_mass);
+    CleanTransform(index);
+    const matrix3 invInertia = m_invInertiaWorld[index];
+    if (invInertia.det() != 0.0f)
+    {
+        m_angularMomentum.Set(index, invInertia.inv() * body.angularVelocity);
+    }
+
+#if DEBUG_ENERGY
+    vector3 vel = GetLinearVelocity(index);
+    vector3 rot = GetAngularVelocity(index);
+    float Ke_translate = 0.5f * data.m_mass * vel.magnitude() * vel.magnitude();
+    float Pe_gravity = data.m_mass * data.m_gravity.magnitude() * m_position[index].y;
+    float Ke_rotate = 0.5f * data.m_momentOfInertia * rot.magnitude() * rot.magnitude();
+    printf("Kinetic Energy After: %f (tran=%f (P=%f,K=%f) | rot=%f)\n", Ke_translate + Ke_rotate + Pe_gravity, Ke_translate + Pe_gravity, Pe_gravity, Ke_translate, Ke_rotate);
 #endif
 }
 //-------------------------------------------------------------------------------------------------
-// pushOut is a temporary solution to resolve collisions where we adjust the position so its no longer
-// pertruding... ideally we could make it so we can re-run the sim until there are no collisions
-//
-// $TODO continuous-advancement
-//
-void OnCollision(Collision& data, bool pushOut)
+static void SetMaterial(ContactManifold* manifold, const StaticPhysicsData& aData, const StaticPhysicsData& bData)
 {
-    switch (data.a->GetCollisionResponse())
+    // whichever is bouncier or grippier wins, so an object that sets a coefficient gets it whatever it lands on
+    manifold->restitution = max(aData.m_elasticity, bData.m_elasticity);
+    manifold->staticFriction = max(aData.m_staticFrictionCoeff, bData.m_staticFrictionCoeff);
+    manifold->dynamicFriction = max(aData.m_dynamicFrictionCoeff, bData.m_dynamicFrictionCoeff);
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::ResolveImpact(int index, int other, const CollisionData& data)
+{
+    // solved on its own, and not kept for the next step.  There's no time step, so no penetration
+    // correction either, it has already been moved to just touching
+    WakeUp(other);
+    SolverBody bodies[2];
+    GetSolverBody(index, &bodies[0]);
+    GetSolverBody(other, &bodies[1]);
+    ContactManifold manifold;
+    manifold.bodyA = 0;
+    manifold.bodyB = 1;
+    SetMaterial(&manifold, m_static[index], m_static[other]);
+    manifold.AddPoint(data, GetTransform(index), GetTransform(other));
+
+    ContactManifold* manifolds[1] = { &manifold };
+    m_contacts->impactSolver.Solve(bodies, 2, manifolds, 1, 0.0f, m_solverSettings);
+    SetSolverBody(index, bodies[0]);
+    SetSolverBody(other, bodies[1]);
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::RemovePairs(const std::vector<BroadphasePair>& removed, std::vector<int>* woken)
+{
+    // pairs that drifted apart won't be tested again until they come back, don't hang on to their caches.
+    // If one of them was removed, whatever it was touching has nothing to rest on any more
+    std::map<uint64_t, PairState>& pairStates = m_contacts->pairs;
+    for (const BroadphasePair& pair : removed)
     {
-        case COLLISION_RESPONSE_IMPULSE:
+        auto it = pairStates.find(pair.GetKey());
+        if (it == pairStates.end())
         {
-            data.a->ApplyImpulseResponse(data.data, data.data.b_normal);
+            continue;
+        }
+        const int a = GetBodyFromProxy(pair.a);
+        const int b = GetBodyFromProxy(pair.b);
+        if (it->second.manifold.numPoints > 0 && (a < 0) != (b < 0))
+        {
+            const int survivor = (a < 0) ? b : a;
+            if (m_flags[survivor] & BODY_SLEEPING)
+            {
+                WakeUp(survivor);
+                woken->push_back(survivor);
+            }
+        }
+        pairStates.erase(it);
+    }
+}
+//-------------------------------------------------------------------------------------------------
+// Finds the contacts for this step: every pair whose boxes overlap goes through the narrowphase, and
+// the ones that really do overlap add their deepest point to the pair's manifold.  The manifolds the
+// solver needs to look at (with their SolverBody indices filled in) go in outManifolds.
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::GetContacts(std::vector<ContactManifold*>* outManifolds)
+{
+    // only pairs whose boxes overlap are worth running GJK on.  The broadphase only needs to hear about what's
+    // moved (or been moved), anything asleep or static is where it was.  If nothing has, it has nothing new to say
+    const int count = GetBodyCount();
+    for (int i = 0; i < count; i++)
+    {
+        if (m_flags[i] & (BODY_TRANSFORM_DIRTY | BODY_BROADPHASE_DIRTY))
+        {
+            UpdateBroadphase(i);
+        }
+    }
+    std::map<uint64_t, PairState>& pairStates = m_contacts->pairs;
+    std::vector<SolverBody>& solverBodies = m_contacts->bodies;
+    std::vector<int> woken;
+    if (m_broadphaseStale)
+    {
+        m_broadphase->Update();
+        m_broadphaseStale = false;
+        RemovePairs(m_broadphase->GetRemovedPairs(), &woken);
+    }
+    if (m_pruneContacts)
+    {
+        // the pairs that came back with a snapshot are from before the broadphase last moved, so it can't report the
+        // ones that have come apart since.  Left in they'd turn up again with stale caches if the pair ever came back
+        m_pruneContacts = false;
+        const std::vector<BroadphasePair>& current = m_broadphase->GetPairs();
+        size_t next = 0;
+        for (auto it = pairStates.begin(); it != pairStates.end();)
+        {
+            while (next < current.size() && current[next].GetKey() < it->first)
+            {
+                next++;
+            }
+            it = (next < current.size() && current[next].GetKey() == it->first) ? std::next(it) : pairStates.erase(it);
         }
-        default:
-            break;
     }
 
-    switch (data.b->GetCollisionResponse())
+    // gather the pairs up front so the narrowphase can run them all in parallel.  Only pairs with something
+    // moving in them need testing: nothing happens between two static objects, and two sleeping ones (or one
+    // asleep on something static) are left as they were, contact points and all, in case they get woken
+    const std::vector<BroadphasePair>& broadphasePairs = m_broadphase->GetPairs();
+    std::vector<CollisionParams> pairs;
+    std::vector<CollisionCache*> caches;
+    std::vector<PairState*> states;
+    std::vector<int> bodies;
+    std::vector<BroadphasePair> sleepingPairs;
+    pairs.reserve(broadphasePairs.size());
+    caches.reserve(broadphasePairs.size());
+    states.reserve(broadphasePairs.size());
+    bodies.reserve(broadphasePairs.size() * 2);
+    for (size_t i = 0; i < broadphasePairs.size(); i++)
     {
-        case COLLISION_RESPONSE_IMPULSE:
+        const int a = GetBodyFromProxy(broadphasePairs[i].a);
+        const int b = GetBodyFromProxy(broadphasePairs[i].b);
+        const bool aSleeping = (m_flags[a] & BODY_SLEEPING) != 0;
+        const bool bSleeping = (m_flags[b] & BODY_SLEEPING) != 0;
+        if (!IsMoving(a) && !IsMoving(b))
         {
-            data.b->ApplyImpulseResponse(data.data, data.data.a_normal);
+            if (aSleeping || bSleeping)
+            {
+                sleepingPairs.push_back(broadphasePairs[i]);
+            }
+            continue;
         }
-        default:
-            break;
+        const bool responds = solverBodies[a].invMass > 0.0f || solverBodies[b].invMass > 0.0f;
+        const bool wakes = (aSleeping && IsMoving(b)) || (bSleeping && IsMoving(a));
+        if (!responds && !wakes)
+        {
+            continue; // something moving that doesn't respond, against something static
+        }
+        PairState& state = pairStates[broadphasePairs[i].GetKey()];
+        CollisionParams params;
+        params.a = m_shape[a];
+        params.aTransform = GetTransform(a);
+        params.b = m_shape[b];
+        params.bTransform = GetTransform(b);
+        pairs.push_back(params);
+        caches.push_back(&state.cache);
+        states.push_back(&state);
+        bodies.push_back(a);
+        bodies.push_back(b);
+    }
+
+    std::vector<CollisionData> results(pairs.size());
+    DetectCollisionBatch(pairs.data(), pairs.size(), results.data(), caches.data());
+
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        ContactManifold& manifold = states[i]->manifold;
+        if (results[i].overlap && results[i].success)
+        {
+            SetMaterial(&manifold, m_static[bodies[i * 2]], m_static[bodies[i * 2 + 1]]);
+            manifold.AddPoint(results[i], pairs[i].aTransform, pairs[i].bTransform);
+        }
+        else
+        {
+            manifold.numPoints = 0; // they've come apart, there's nothing to warm start from next time they touch
+        }
+        for (int side = 0; side < 2 && manifold.numPoints > 0; side++)
+        {
+            const int index = bodies[i * 2 + side];
+            if (m_flags[index] & BODY_SLEEPING)
+            {
+                WakeUp(index);
+                woken.push_back(index);
+            }
+        }
+    }
+
+    // whatever was woken wakes the rest of its island too, that's everything it still has contact points with.
+    // Nothing in a sleeping pair has moved since it went to sleep, so those points are still good to solve with
+    std::vector<PairState*> sleepingStates;
+    if (!woken.empty())
+    {
+        // each body's sleeping pairs, as ranges of sleepingPairs
+        std::vector<int> first(count + 1, 0);
+        std::vector<int> neighbours;
+        std::vector<int> sleepingBodies(sleepingPairs.size() * 2);
+        sleepingStates.resize(sleepingPairs.size(), nullptr);
+        for (size_t i = 0; i < sleepingPairs.size(); i++)
+        {
+            auto it = pairStates.find(sleepingPairs[i].GetKey());
+            if (it != pairStates.end() && it->second.manifold.numPoints > 0)
+            {
+                sleepingStates[i] = &it->second;
+                sleepingBodies[i * 2] = GetBodyFromProxy(sleepingPairs[i].a);
+                sleepingBodies[i * 2 + 1] = GetBodyFromProxy(sleepingPairs[i].b);
+                first[sleepingBodies[i * 2] + 1]++;
+                first[sleepingBodies[i * 2 + 1] + 1]++;
+            }
+        }
+        for (size_t i = 1; i < first.size(); i++)
+        {
+            first[i] += first[i - 1];
+        }
+        std::vector<int> fill(first.begin(), first.end() - 1);
+        neighbours.resize(first.back());
+        for (size_t i = 0; i < sleepingPairs.size(); i++)
+        {
+            if (sleepingStates[i])
+            {
+                neighbours[fill[sleepingBodies[i * 2]]++] = (int)i;
+                neighbours[fill[sleepingBodies[i * 2 + 1]]++] = (int)i;
+            }
+        }
+
+        for (size_t w = 0; w < woken.size(); w++)
+        {
+            const int index = woken[w];
+            for (int n = first[index]; n < first[index + 1]; n++)
+            {
+                const int pair = neighbours[n];
+                const int other = (sleepingBodies[pair * 2] == index) ? sleepingBodies[pair * 2 + 1] : sleepingBodies[pair * 2];
+                if (m_flags[other] & BODY_SLEEPING)
+                {
+                    WakeUp(other);
+                    woken.push_back(other);
+                }
+            }
+        }
+        for (int index : woken)
+        {
+            GetSolverBody(index, &solverBodies[index]);
+        }
+
+        for (size_t i = 0; i < sleepingStates.size(); i++)
+        {
+            const int a = sleepingBodies[i * 2];
+            const int b = sleepingBodies[i * 2 + 1];
+            if (sleepingStates[i] && ((m_flags[a] & BODY_SLEEPING) == 0 || (m_flags[b] & BODY_SLEEPING) == 0))
+            {
+                ContactManifold& manifold = sleepingStates[i]->manifold;
+                manifold.bodyA = a;
+                manifold.bodyB = b;
+                outManifolds->push_back(&manifold);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < states.size(); i++)
+    {
+        ContactManifold& manifold = states[i]->manifold;
+        if (manifold.numPoints > 0)
+        {
+            manifold.bodyA = bodies[i * 2];
+            manifold.bodyB = bodies[i * 2 + 1];
+            outManifolds->push_back(&manifold);
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::SetBroadphase(BROADPHASE_TYPE type)
+{
+    // let the old one finish first, so whatever came apart (or lost a body) since the last Update is let go of
+    // the way it would have been then, rather than quietly left behind with its old ids
+    for (int i = 0; i < GetBodyCount(); i++)
+    {
+        UpdateBroadphase(i);
+    }
+    m_broadphase->Update();
+    std::vector<int> woken;
+    RemovePairs(m_broadphase->GetRemovedPairs(), &woken);
+
+    // then move everything across.  The pairs are keyed on their proxies, which all change, so the pair states are
+    // carried over to the new ids.  If a pair's ids now sort the other way round its manifold would be facing
+    // the wrong way, that one starts again (and wakes up, it's lost what it was resting on)
+    Broadphase* broadphase = CreateBroadphase(type);
+    std::vector<int> newProxy;
+    for (int i = 0; i < GetBodyCount(); i++)
+    {
+        const int oldProxy = m_broadphaseProxy[i];
+        if (oldProxy >= (int)newProxy.size())
+        {
+            newProxy.resize(oldProxy + 1, -1);
+        }
+        newProxy[oldProxy] = m_broadphaseProxy[i] = broadphase->AddProxy(GetWorldAABB(i), GetProxyUserData(m_slotOf[i]));
+        m_flags[i] &= ~BODY_BROADPHASE_DIRTY;
+    }
+    std::map<uint64_t, PairState> pairStates;
+    for (auto& it : m_contacts->pairs)
+    {
+        const int a = (int)(it.first >> 32);
+        const int b = (int)(uint32_t)it.first;
+        if (a >= (int)newProxy.size() || b >= (int)newProxy.size() || newProxy[a] < 0 || newProxy[b] < 0)
+        {
+            continue; // one of them is gone
+        }
+        const BroadphasePair pair = { newProxy[a], newProxy[b] };
+        if (pair.a < pair.b)
+        {
+            pairStates[pair.GetKey()] = it.second;
+        }
+        else if (it.second.manifold.numPoints > 0)
+        {
+            WakeUp(GetBodyFromProxy(a));
+            WakeUp(GetBodyFromProxy(b));
+        }
+    }
+    m_contacts->pairs.swap(pairStates);
+    delete m_broadphase;
+    m_broadphase = broadphase;
+    m_broadphaseStale = true;
+    m_layoutVersion++; // the pairs are keyed on different ids now
+}
+//-------------------------------------------------------------------------------------------------
+struct QueryAABBParams
+{
+    const PhysicsWorld*         world;
+    std::vector<PhysicsHandle>* out;
+};
+void PhysicsWorld::QueryAABB(const aabb& region, std::vector<PhysicsHandle>* out) const
+{
+    auto callback = [](int proxy, void* userData)
+    {
+        const QueryAABBParams* query = (const QueryAABBParams*)userData;
+        const int index = query->world->GetBodyFromProxy(proxy);
+        if (index >= 0)
+        {
+            query->out->push_back(query->world->GetHandle(index));
+        }
+        return true;
+    };
+    QueryAABBParams query = { this, out };
+    m_broadphase->Query(region, callback, &query);
+}
+//-------------------------------------------------------------------------------------------------
+struct RayCastQuery
+{
+    const PhysicsWorld* world;
+    SweepParams         ray;
+    PhysicsHandle       hit;
+    float               fraction = 1.0f;
+};
+PhysicsHandle PhysicsWorld::RayCast(const vector3& from, const vector3& to, float* outFraction) const
+{
+    auto callback = [](int proxy, float maxFraction, void* userData)
+    {
+        // the broadphase only knows the ray went through the box, sweep a point along it to find the shape
+        RayCastQuery* query = (RayCastQuery*)userData;
+        const int index = query->world->GetBodyFromProxy(proxy);
+        if (index < 0)
+        {
+            return maxFraction;
+        }
+        SweepParams still = query->world->GetSweep(index);
+        still.velocity = vector3();
+        still.angularVelocity = vector3();
+        float t;
+        DistanceData contact;
+        if (GetTimeOfImpact(query->ray, still, maxFraction, &t, &contact))
+        {
+            query->hit = query->world->GetHandle(index);
+            query->fraction = t;
+            return t;
+        }
+        return maxFraction;
+    };
+    static const SpherePhysicsShape s_point(0.0f);
+    RayCastQuery query;
+    query.world = this;
+    query.ray = { &s_point, from, quaternion(), to - from, vector3() };
+    m_broadphase->RayCast(from, to, callback, &query);
+    if (outFraction)
+    {
+        *outFraction = query.fraction;
+    }
+    return query.hit;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Continuous collision:
+// ----------------------
+// Conservative advancement (Mirtich): no point on a shape moves faster than |v| + |w| * radius, so
+// if they are d apart and closing at most that fast, nothing can touch for d / speed.  Step
+// forward by that much, measure again, and repeat until they're within tolerance or out of time.
+//-------------------------------------------------------------------------------------------------
+static matrix4 GetSweepTransform(const SweepParams& sweep, float t)
+{
+    // the exact rotation for a constant angular velocity, rather than the integrator's step
+    matrix4 transform;
+    transform.translate(sweep.position + sweep.velocity * t);
+    const float speed = sweep.angularVelocity.magnitude();
+    if (speed > 0.0f)
+    {
+        const vector3 axis = sweep.angularVelocity * (1.0f / speed);
+        transform.rotate(quaternion::from_axis_angle(axis.x, axis.y, axis.z, speed * t) * sweep.rotation);
+    }
+    else
+    {
+        transform.rotate(sweep.rotation);
+    }
+    return transform;
+}
+//-------------------------------------------------------------------------------------------------
+bool GetTimeOfImpact(const SweepParams& a, const SweepParams& b, float maxTime, float* outTime, DistanceData* outContact)
+{
+    const vector3 relativeVelocity = a.velocity - b.velocity;
+    const float spinSpeed = a.angularVelocity.magnitude() * a.shape->GetBoundingRadius() + b.angularVelocity.magnitude() * b.shape->GetBoundingRadius();
+    const float maxSpeed = relativeVelocity.magnitude() + spinSpeed;
+
+    CollisionParams params;
+    params.a = a.shape;
+    params.b = b.shape;
+    float t = 0.0f;
+    for (int i = 0; i < CCD_MAX_ITERATIONS; i++)
+    {
+        params.aTransform = GetSweepTransform(a, t);
+        params.bTransform = GetSweepTransform(b, t);
+
+        // anything further than we can cover in the time left can't be hit
+        DistanceData contact;
+        if (!GetClosestPoints(params, true, maxSpeed * (maxTime - t) + CCD_TOLERANCE, &contact) && !contact.overlap)
+        {
+            return false;
+        }
+
+        const float closingSpeed = contact.overlap ? maxSpeed : relativeVelocity.dot(contact.normal) + spinSpeed;
+        if (contact.overlap || contact.distance <= CCD_TOLERANCE)
+        {
+            if (t == 0.0f && closingSpeed <= 0.0f)
+            {
+                return false; // already touching, but they're coming apart, leave it to the regular collision pass
+            }
+            *outTime = t;
+            *outContact = contact;
+            return true;
+        }
+        if (closingSpeed <= 0.0f)
+        {
+            return false;
+        }
+
+        // aim to stop a little short of touching, landing exactly on it would often tip into an overlap
+        t += (contact.distance - 0.5f * CCD_TOLERANCE) / closingSpeed;
+        if (t > maxTime)
+        {
+            return false;
+        }
+    }
+
+    // still creeping up on it, close enough
+    *outTime = t;
+    *outContact = DistanceData();
+    return true;
+}
+//-------------------------------------------------------------------------------------------------
+SweepParams PhysicsWorld::GetSweep(int index) const
+{
+    // Update applies gravity (and solves the contacts) before anything moves, so this is the velocity it moves at
+    SweepParams sweep;
+    sweep.shape = m_shape[index];
+    sweep.position = m_position[index];
+    sweep.rotation = m_rotation[index];
+    sweep.velocity = GetLinearVelocity(index);
+    sweep.angularVelocity = (m_invMass[index] != 0.0f) ? GetAngularVelocity(index) : vector3();
+    return sweep;
+}
+//-------------------------------------------------------------------------------------------------
+bool PhysicsWorld::NeedsContinuousCollision(int index, float dt) const
+{
+    if (!IsMoving(index))
+    {
+        return false;
+    }
+    if (m_static[index].m_continuousCollision)
+    {
+        return true;
+    }
+    const float motion = (GetLinearVelocity(index).magnitude() + GetAngularVelocity(index).magnitude() * m_boundingRadius[index]) * dt;
+    return motion > CCD_MOTION_THRESHOLD * m_boundingRadius[index];
+}
+//-------------------------------------------------------------------------------------------------
+struct SweepQuery
+{
+    const PhysicsWorld* world;
+    std::vector<int>*   out;
+};
+void PhysicsWorld::UpdateContinuous(int index, float dt)
+{
+    // the solver's push out of penetration is part of how it moves this step, same as for the bodies that aren't swept
+    std::vector<int>& candidates = m_contacts->sweepCandidates;
+    const vector3 pushVelocity = m_pushVelocity[index];
+    const vector3 pushAngularVelocity = m_pushAngularVelocity[index];
+    float remaining = dt;
+    for (int substep = 0; substep < CCD_MAX_SUBSTEPS && remaining > 0.0f; substep++)
+    {
+        // everything else has either already moved or will be swept against us after, treat it as still.
+        // Only what the broadphase has anywhere near the path (its bounding sphere from start to end) can be hit
+        SweepParams sweep = GetSweep(index);
+        sweep.velocity = sweep.velocity + pushVelocity;
+        if (m_invMass[index] != 0.0f)
+        {
+            sweep.angularVelocity = sweep.angularVelocity + pushAngularVelocity;
+        }
+        const vector3 end = sweep.position + sweep.velocity * remaining;
+        const vector3 radius(m_boundingRadius[index], m_boundingRadius[index], m_boundingRadius[index]);
+        aabb path;
+        path.lower = vector3(min(sweep.position.x, end.x), min(sweep.position.y, end.y), min(sweep.position.z, end.z)) - radius;
+        path.upper = vector3(max(sweep.position.x, end.x), max(sweep.position.y, end.y), max(sweep.position.z, end.z)) + radius;
+        auto callback = [](int proxy, void* userData)
+        {
+            const SweepQuery* query = (const SweepQuery*)userData;
+            const int other = query->world->GetBodyFromProxy(proxy);
+            if (other >= 0)
+            {
+                query->out->push_back(other);
+            }
+            return true;
+        };
+        candidates.clear();
+        SweepQuery query = { this, &candidates };
+        m_broadphase->Query(path, callback, &query);
+        std::sort(candidates.begin(), candidates.end()); // so ties go the same way whichever broadphase found them
+
+        float toi = remaining;
+        int hit = -1;
+        DistanceData contact;
+        for (int other : candidates)
+        {
+            if (other == index)
+                continue;
+            SweepParams still = GetSweep(other);
+            still.velocity = vector3();
+            still.angularVelocity = vector3();
+            float t;
+            DistanceData d;
+            if (GetTimeOfImpact(sweep, still, toi, &t, &d) && (t < toi || hit < 0))
+            {
+                toi = t;
+                hit = other;
+                contact = d;
+            }
+        }
+
+        IntegratePosition(index, toi, pushVelocity, pushAngularVelocity);
+        remaining -= toi;
+        if (hit < 0)
+        {
+            UpdateBroadphase(index);
+            return;
+        }
+
+        // respond where it is, at the time of impact and just short of touching, with the closest points
+        // the sweep found.  Then the rest of the step carries on with the velocity it bounced off with
+        CollisionParams params;
+        params.a = m_shape[index];
+        params.aTransform = GetTransform(index);
+        params.b = m_shape[hit];
+        params.bTransform = GetTransform(hit);
+        CollisionData data;
+        if (contact.overlap)
+        {
+            // they started the sweep overlapping, the regular narrowphase knows the way out
+            if (!DetectCollision(params, true, &data) || !data.success)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            if (contact.normal.magnitude_sq() == 0.0f && !GetClosestPoints(params, true, FLT_MAX, &contact))
+            {
+                continue; // ran out of iterations creeping up on it and has now touched after all, leave it to the next step
+            }
+            data.penetrationDirection = -contact.normal;
+            data.depth = 0.0f; // within CCD_TOLERANCE, call it touching
+            data.a_point = contact.a_point;
+            data.b_point = contact.b_point;
+            data.overlap = false;
+            data.success = true;
+        }
+        ResolveImpact(index, hit, data);
     }
+
+    if (remaining > 0.0f)
+    {
+        IntegratePosition(index, remaining, pushVelocity, pushAngularVelocity);
+    }
+    UpdateBroadphase(index);
 }
+
 //-------------------------------------------------------------------------------------------------
-std::vector<Collision> GetCollisions(std::vector<Physics*> updateList)
+void PhysicsWorld::Update(float dt)
 {
-    std::vector<Collision> collisions;
-    for (auto it = updateList.begin(); it != updateList.end(); ++it)
+    // gravity goes on first so the solver sees what it's about to do, and can stop things resting on each other sinking
+    const int count = GetBodyCount();
+    std::vector<SolverBody>& solverBodies = m_contacts->bodies;
+    solverBodies.resize(count);
+    PhysUtil_IntegrateVelocities(GetBodyArrays(BODY_SLEEPING), dt);
+    for (int i = 0; i < count; i++)
+    {
+        GetSolverBody(i, &solverBodies[i]);
+    }
+
+    // find what's touching where everything is now, and work out velocities that keep it all apart
+    std::vector<ContactManifold*> manifolds;
+    GetContacts(&manifolds);
+    ContactSolver& solver = m_contacts->solver;
+    solver.Solve(solverBodies.data(), count, manifolds.data(), (int)manifolds.size(), dt, m_solverSettings);
+    for (const ContactIsland& island : solver.GetIslands())
+    {
+        // anything on its own wasn't touched.  Islands that have been still for long enough go to sleep together,
+        // if any of it were left awake it could wake the rest straight back up
+        float sleepTime = FLT_MAX;
+        for (int i = 0; i < island.numBodies; i++)
+        {
+            const int index = solver.GetIslandBody(island.firstBody + i);
+            if (island.numManifolds > 0)
+            {
+                SetSolverBody(index, solverBodies[index]);
+            }
+            const float bodySleepTime = UpdateSleepTime(index, solverBodies[index], dt);
+            sleepTime = min(sleepTime, bodySleepTime);
+        }
+        if (m_solverSettings.allowSleeping && sleepTime >= m_solverSettings.timeToSleep)
+        {
+            for (int i = 0; i < island.numBodies; i++)
+            {
+                Sleep(solver.GetIslandBody(island.firstBody + i));
+            }
+        }
+    }
+
+    // then move, anything moving fast enough to tunnel waits until everything else has moved and then sweeps through the step
+    std::vector<int> sweptList;
+    m_pushVelocity.resize(count);
+    m_pushAngularVelocity.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        m_pushVelocity.Set(i, solverBodies[i].pushLinearVelocity);
+        m_pushAngularVelocity.Set(i, solverBodies[i].pushAngularVelocity);
+        if (NeedsContinuousCollision(i, dt))
+        {
+            sweptList.push_back(i);
+            m_flags[i] |= BODY_SWEPT;
+        }
+    }
+    PhysUtil_IntegratePositions(GetBodyArrays(BODY_SLEEPING | BODY_SWEPT), dt);
+    for (int i = 0; i < count; i++)
+    {
+        // once here rather than every time something asks for it
+        if (IsMoving(i) && !(m_flags[i] & BODY_SWEPT))
+        {
+            UpdateTransform(i);
+        }
+    }
+    if (!sweptList.empty())
     {
-        for (auto innerIt = it; innerIt != updateList.end(); ++innerIt)
+        // the sweeps look for what's in the way in the broadphase, tell it where everything has moved to
+        for (int i = 0; i < count; i++)
         {
-            if (it == innerIt)
-                continue; // can't collide with yourself
-            Physics* a = *it;
-            Physics* b = *innerIt;
-            CollisionData collisionData;
-            CollisionParams p;
-            p.a = a->GetPhysicsShape();
-            #ifdef TEST_PROGRAM
-            vector3 r = a->GetRotation();
-            vector3 d = a->GetPosition();
-            #endif
-            p.aTransform = a->GetTransform();
-            p.b = b->GetPhysicsShape();
-            p.bTransform = b->GetTransform();
-            if (DetectCollision(p, true, &collisionData))
+            if (!(m_flags[i] & BODY_SWEPT))
             {
-                collisions.push_back({ *it, *innerIt, collisionData });
-                break;
+                UpdateBroadphase(i);
             }
         }
     }
-    return collisions;
+    for (int index : sweptList)
+    {
+        m_flags[index] &= ~BODY_SWEPT;
+        UpdateContinuous(index, dt);
+    }
+}
+//-------------------------------------------------------------------------------------------------
+int PhysicsWorld::Advance(float frameDt)
+{
+    const float step = m_stepSettings.fixedDt;
+    m_accumulator += frameDt;
+    int steps = 0;
+    while (m_accumulator >= step && steps < m_stepSettings.maxSubsteps)
+    {
+        m_previousPosition = m_position;
+        m_previousRotation = m_rotation;
+        Update(step);
+        m_accumulator -= step;
+        steps++;
+    }
+    if (m_accumulator >= step)
+    {
+        // too far behind to catch up, keep the fraction of a step so the interpolation doesn't jump
+        const float kept = fmodf(m_accumulator, step);
+        m_droppedTime += m_accumulator - kept;
+        m_accumulator = kept;
+    }
+    return steps;
+}
+//-------------------------------------------------------------------------------------------------
+matrix4 PhysicsWorld::GetInterpolatedTransform(PhysicsHandle handle) const
+{
+    const int index = GetIndex(handle);
+    const float alpha = GetInterpolationAlpha();
+    const vector3 from = m_previousPosition[index];
+    matrix4 transform;
+    transform.rotate(quaternion::nlerp(m_previousRotation[index], m_rotation[index], alpha));
+    transform.set_translation(from + (m_position[index] - from) * alpha);
+    return transform;
+}
+//-------------------------------------------------------------------------------------------------
+// A snapshot is this, then the NUM_STEPPED_ARRAYS arrays of bodyCount floats, bodyCount flags, and the pairs in key
+// order.  Nothing in it is aligned, it's only ever memcpy'd in and out
+struct SnapshotHeader
+{
+    uint32_t            worldSerial;
+    uint32_t            layoutVersion;
+    uint32_t            bodyCount;
+    uint32_t            pairCount;
+    float               accumulator;
+    float               droppedTime;
+};
+// A pair is its key then these, field by field: the GJK cache, the manifold, then only what carries over from one
+// step to the next of each point it has (the rest of a ContactPoint is worked out again at the start of every Solve).
+// The same list saves (State is const) and restores, numPoints comes before the points so it's there to loop to
+template<typename State, typename Fn>
+static void ForEachSnapshotField(State& state, Fn&& fn)
+{
+    fn(state.cache.axis);
+    fn(state.cache.a_index);
+    fn(state.cache.b_index);
+    fn(state.cache.valid);
+    auto& manifold = state.manifold;
+    fn(manifold.bodyA);
+    fn(manifold.bodyB);
+    fn(manifold.normal);
+    fn(manifold.tangent[0]);
+    fn(manifold.tangent[1]);
+    fn(manifold.staticFriction);
+    fn(manifold.dynamicFriction);
+    fn(manifold.restitution);
+    fn(manifold.numPoints);
+    for (int i = 0; i < manifold.numPoints; i++)
+    {
+        auto& point = manifold.points[i];
+        fn(point.localA);
+        fn(point.localB);
+        fn(point.rA);
+        fn(point.rB);
+        fn(point.depth);
+        fn(point.normalImpulse);
+        fn(point.tangentImpulse[0]);
+        fn(point.tangentImpulse[1]);
+    }
+}
+// the most a pair can take, with every point in use
+static size_t GetSnapshotPairBytes()
+{
+    PairState full;
+    full.manifold.numPoints = CONTACT_MAX_POINTS;
+    size_t bytes = sizeof(uint64_t);
+    ForEachSnapshotField(full, [&bytes](const auto& field)
+    {
+        static_assert(std::is_trivially_copyable<typename std::decay<decltype(field)>::type>::value, "snapshot fields are copied as bytes");
+        bytes += sizeof(field);
+    });
+    return bytes;
 }
 
+void PhysicsWorld::GetSteppedArrays(float* out[NUM_STEPPED_ARRAYS]) const
+{
+    int n = 0;
+    auto add = [out, &n](const PhysicsFloatArray* components, int count)
+    {
+        for (int c = 0; c < count; c++)
+        {
+            out[n++] = const_cast<float*>(components[c].data());
+        }
+    };
+    add(m_position.components, 3);
+    add(m_rotation.components, 4);
+    add(m_linearMomentum.components, 3);
+    add(m_angularMomentum.components, 3);
+    add(m_previousPosition.components, 3);
+    add(m_previousRotation.components, 4);
+    out[n++] = const_cast<float*>(m_sleepTime.data());
+    assert(n == NUM_STEPPED_ARRAYS);
+}
 //-------------------------------------------------------------------------------------------------
-void Physics_Update(float dt)
+void PhysicsWorld::SaveSnapshot(PhysicsSnapshot* out) const
+{
+    const std::map<uint64_t, PairState>& pairs = m_contacts->pairs;
+    SnapshotHeader header;
+    header.worldSerial = m_serial;
+    header.layoutVersion = m_layoutVersion;
+    header.bodyCount = (uint32_t)GetBodyCount();
+    header.pairCount = (uint32_t)pairs.size();
+    header.accumulator = m_accumulator;
+    header.droppedTime = m_droppedTime;
+    const size_t arrayBytes = header.bodyCount * sizeof(float);
+    static const size_t pairBytes = GetSnapshotPairBytes();
+    out->Reserve(sizeof(header) + NUM_STEPPED_ARRAYS * arrayBytes + header.bodyCount + header.pairCount * pairBytes);
+
+    uint8_t* dst = out->m_data.data();
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    float* arrays[NUM_STEPPED_ARRAYS];
+    GetSteppedArrays(arrays);
+    for (const float* a : arrays)
+    {
+        memcpy(dst, a, arrayBytes);
+        dst += arrayBytes;
+    }
+    memcpy(dst, m_flags.data(), header.bodyCount);
+    dst += header.bodyCount;
+    for (const auto& it : pairs)
+    {
+        memcpy(dst, &it.first, sizeof(uint64_t));
+        dst += sizeof(uint64_t);
+        ForEachSnapshotField(it.second, [&dst](const auto& field)
+        {
+            memcpy(dst, &field, sizeof(field));
+            dst += sizeof(field);
+        });
+    }
+    out->m_size = dst - out->m_data.data();
+}
+//-------------------------------------------------------------------------------------------------
+bool PhysicsWorld::RestoreSnapshot(const PhysicsSnapshot& snapshot)
 {
-    // update the objects dynamic physics state for the time passed
-    for (auto it = s_physicsList.begin(); it != s_physicsList.end(); ++it)
+    SnapshotHeader header;
+    if (snapshot.GetSize() < sizeof(header))
+    {
+        return false;
+    }
+    const uint8_t* src = snapshot.GetData();
+    memcpy(&header, src, sizeof(header));
+    src += sizeof(header);
+    if (header.worldSerial != m_serial || header.layoutVersion != m_layoutVersion || header.bodyCount != (uint32_t)GetBodyCount())
+    {
+        return false;
+    }
+
+    m_accumulator = header.accumulator;
+    m_droppedTime = header.droppedTime;
+    const size_t arrayBytes = header.bodyCount * sizeof(float);
+    float* arrays[NUM_STEPPED_ARRAYS];
+    GetSteppedArrays(arrays);
+    for (float* a : arrays)
+    {
+        memcpy(a, src, arrayBytes);
+        src += arrayBytes;
+    }
+    // everything built from the position and rotation is rebuilt when it's next needed
+    memcpy(m_flags.data(), src, header.bodyCount);
+    src += header.bodyCount;
+    for (uint8_t& flags : m_flags)
     {
-        Physics* phys = *it;
-        phys->Update(dt);
+        flags |= BODY_TRANSFORM_DIRTY;
     }
 
-    // Check for collisions and apply responses to collisions
-    std::vector<Collision> collisions = GetCollisions(s_physicsList);
-    for (int i = 0; i < collisions.size(); i++)
+    // most of the pairs will still be there from when it was saved, copy over those rather than rebuild the map
+    std::map<uint64_t, PairState>& pairs = m_contacts->pairs;
+    auto it = pairs.begin();
+    for (uint32_t i = 0; i < header.pairCount; i++)
     {
-        OnCollision(collisions[i], true);
+        uint64_t key;
+        memcpy(&key, src, sizeof(key));
+        src += sizeof(key);
+        while (it != pairs.end() && it->first < key)
+        {
+            it = pairs.erase(it);
+        }
+        if (it == pairs.end() || it->first != key)
+        {
+            it = pairs.emplace_hint(it, key, PairState());
+        }
+        ForEachSnapshotField(it->second, [&src](auto& field)
+        {
+            memcpy(&field, src, sizeof(field));
+            src += sizeof(field);
+        });
+        ++it;
     }
+    pairs.erase(it, pairs.end());
+    m_pruneContacts = true;
+    return true;
+}
+//-------------------------------------------------------------------------------------------------
+uint64_t PhysicsWorld::GetStateHash() const
+{
+    const int count = GetBodyCount();
+    uint64_t hash = Hash_FNV1a(&count, sizeof(count));
+    auto hashArrays = [&hash, count](const PhysicsFloatArray* components, int n)
+    {
+        for (int c = 0; c < n; c++)
+        {
+            hash = Hash_FNV1a(components[c].data(), count * sizeof(float), hash);
+        }
+    };
+    hashArrays(m_position.components, 3);
+    hashArrays(m_rotation.components, 4);
+    hashArrays(m_linearMomentum.components, 3);
+    hashArrays(m_angularMomentum.components, 3);
+    hash = Hash_FNV1a(m_sleepTime.data(), count * sizeof(float), hash);
+    for (int i = 0; i < count; i++)
+    {
+        const uint8_t sleeping = m_flags[i] & BODY_SLEEPING;
+        hash = Hash_FNV1a(&sleeping, 1, hash);
+    }
+    return hash;
+}
+//-------------------------------------------------------------------------------------------------
+PhysUtilBodyArrays PhysicsWorld::GetBodyArrays(uint8_t skipFlags)
+{
+    PhysUtilBodyArrays arrays;
+    for (int c = 0; c < 4; c++)
+    {
+        arrays.rotation[c] = m_rotation.components[c].data();
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        arrays.position[c] = m_position.components[c].data();
+        arrays.linearMomentum[c] = m_linearMomentum.components[c].data();
+        arrays.angularMomentum[c] = m_angularMomentum.components[c].data();
+        arrays.gravity[c] = m_gravity.components[c].data();
+        arrays.pushVelocity[c] = m_pushVelocity.size() == GetBodyCount() ? m_pushVelocity.components[c].data() : nullptr;
+        arrays.pushAngularVelocity[c] = m_pushAngularVelocity.size() == GetBodyCount() ? m_pushAngularVelocity.components[c].data() : nullptr;
+    }
+    for (int c = 0; c < 9; c++)
+    {
+        arrays.invInertia[c] = m_invInertiaWorld.components[c].data();
+    }
+    arrays.mass = m_mass.data();
+    arrays.invMass = m_invMass.data();
+    arrays.flags = m_flags.data();
+    arrays.skipFlags = skipFlags;
+    arrays.count = GetBodyCount();
+    return arrays;
+}
+
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::UpdateBroadphase(int index)
+{
+    // things sitting still don't need to tell it anything
+    const aabb& box = GetWorldAABB(index);
+    if (m_flags[index] & BODY_BROADPHASE_DIRTY)
+    {
+        m_broadphase->MoveProxy(m_broadphaseProxy[index], box);
+        m_flags[index] &= ~BODY_BROADPHASE_DIRTY;
+        m_broadphaseStale = true;
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::UpdateTransform(int index) const
+{
+    const matrix3 rotation(m_rotation[index]);
+    m_transform[index].rotate(m_rotation[index]);
+    m_transform[index].set_translation(m_position[index]);
+    m_worldAABB[index] = m_shape[index]->GetAABB(m_transform[index]);
+    m_invInertiaWorld.Set(index, rotation * m_invInertia[index] * rotation.transpose_get());
+    m_flags[index] = (m_flags[index] & ~BODY_TRANSFORM_DIRTY) | BODY_BROADPHASE_DIRTY;
+}
+//-------------------------------------------------------------------------------------------------
+const matrix4& PhysicsWorld::GetTransform(int index) const
+{
+    CleanTransform(index);
+    return m_transform[index];
+}
+//-------------------------------------------------------------------------------------------------
+const aabb& PhysicsWorld::GetWorldAABB(int index) const
+{
+    CleanTransform(index);
+    return m_worldAABB[index];
 }
 
 //-------------------------------------------------------------------------------------------------
-void Physics::Reset()
+void PhysicsWorld::WakeUp(int index)
+{
+    m_flags[index] &= ~BODY_SLEEPING;
+    m_sleepTime[index] = 0.0f;
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::WakeOverlapping(int index)
+{
+    auto callback = [](int proxy, void* userData)
+    {
+        PhysicsWorld* world = (PhysicsWorld*)userData;
+        const int other = world->GetBodyFromProxy(proxy);
+        if (other >= 0)
+        {
+            world->WakeUp(other);
+        }
+        return true;
+    };
+    m_broadphase->Query(GetWorldAABB(index), callback, this);
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::Sleep(int index)
+{
+    m_flags[index] |= BODY_SLEEPING;
+    m_linearMomentum.Set(index, vector3());
+    m_angularMomentum.Set(index, vector3());
+}
+//-------------------------------------------------------------------------------------------------
+float PhysicsWorld::UpdateSleepTime(int index, const SolverBody& body, float dt)
+{
+    const float linear = m_solverSettings.sleepLinearVelocity;
+    const float angular = m_solverSettings.sleepAngularVelocity;
+    if (body.linearVelocity.magnitude_sq() > linear * linear || body.angularVelocity.magnitude_sq() > angular * angular)
+    {
+        m_sleepTime[index] = 0.0f;
+    }
+    else
+    {
+        m_sleepTime[index] += dt;
+    }
+    return m_sleepTime[index];
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::ApplyImpulse(PhysicsHandle handle, const vector3& impulse, const vector3& point)
+{
+    const int index = GetIndex(handle);
+    if (m_invMass[index] == 0.0f)
+    {
+        return;
+    }
+    WakeUp(index);
+    m_linearMomentum.Set(index, m_linearMomentum[index] + impulse);
+    m_angularMomentum.Set(index, m_angularMomentum[index] + (point - m_position[index]).cross(impulse));
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::Reset(PhysicsHandle handle)
 {
-    m_position = m_static.m_initialPosition;
-    m_rotation = m_static.m_initialRotation;
-    m_angularMomentum = { 0.0f };
-    m_linearMomentum = { 0.0f };
+    const int index = GetIndex(handle);
+    WakeOverlapping(index);
+    m_position.Set(index, m_static[index].m_initialPosition);
+    m_rotation.Set(index, quaternion::from_euler(m_static[index].m_initialRotation.x, m_static[index].m_initialRotation.y, m_static[index].m_initialRotation.z));
+    m_previousPosition.Set(index, m_position[index]); // it jumped there, don't draw it getting there
+    m_previousRotation.Set(index, m_rotation[index]);
+    m_angularMomentum.Set(index, vector3());
+    m_linearMomentum.Set(index, vector3());
+    m_flags[index] |= BODY_TRANSFORM_DIRTY;
+    WakeUp(index);
+    WakeOverlapping(index);
 }
+//-------------------------------------------------------------------------------------------------
+const matrix4& PhysicsWorld::GetTransform(PhysicsHandle handle) const
+{
+    return GetTransform(GetIndex(handle));
+}
+//-------------------------------------------------------------------------------------------------
+const aabb& PhysicsWorld::GetWorldAABB(PhysicsHandle handle) const
+{
+    return GetWorldAABB(GetIndex(handle));
+}
+#ifdef TEST_PROGRAM
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::SetPosition(PhysicsHandle handle, const vector3& v)
+{
+    const int index = GetIndex(handle);
+    WakeOverlapping(index);
+    m_position.Set(index, v);
+    m_flags[index] |= BODY_TRANSFORM_DIRTY;
+    WakeUp(index);
+    WakeOverlapping(index);
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::SetRotation(PhysicsHandle handle, const quaternion& q)
+{
+    const int index = GetIndex(handle);
+    WakeOverlapping(index);
+    m_rotation.Set(index, q.normalize());
+    m_flags[index] |= BODY_TRANSFORM_DIRTY;
+    WakeUp(index);
+    WakeOverlapping(index);
+}
+#endif
 
 //-------------------------------------------------------------------------------------------------
-void Physics::Update(float deltaTime)
+void PhysicsWorld::Integrate(PhysicsHandle handle, float deltaTime)
+{
+    const int index = GetIndex(handle);
+    IntegrateVelocity(index, deltaTime);
+    IntegratePosition(index, deltaTime, vector3(), vector3());
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::IntegrateVelocity(int index, float deltaTime)
 {
     // update for gravity
-    if (!m_static.m_gravity.IsNone())
+    if (IsMoving(index))
     {
-        m_linearMomentum = m_linearMomentum + (m_static.m_gravity * m_static.m_mass) * deltaTime;
+        m_linearMomentum.Set(index, m_linearMomentum[index] + (m_gravity[index] * m_mass[index]) * deltaTime);
     }
-
-    // should probably be more explicit... but assume massless objects don't move
-    if (!FloatEquals(m_static.m_mass, 0.0f))
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsWorld::IntegratePosition(int index, float deltaTime, const vector3& pushVelocity, const vector3& pushAngularVelocity)
+{
+    // massless objects don't move
+    if (IsMoving(index))
     {
-        // compute linear and angular velocity
-        vector3 v = m_linearMomentum * (1.0f / m_static.m_mass);
-        vector3 w = m_static.m_inverseInertiaTensor * m_angularMomentum;
+        // compute linear and angular velocity, plus whatever the solver wants to push us out of penetration
+        // with (that's only for this step, it doesn't go in the momentum)
+        vector3 v = GetLinearVelocity(index) + pushVelocity;
+        vector3 w = GetAngularVelocity(index) + pushAngularVelocity;
 
         // update position based on velocities
-        m_position = m_position + v * deltaTime;
-        m_rotation = m_rotation + w * deltaTime;
+        m_position.Set(index, m_position[index] + v * deltaTime);
+        m_rotation.Set(index, m_rotation[index].integrate(w.x, w.y, w.z, deltaTime));
+
+        // once here rather than every time something asks for it
+        UpdateTransform(index);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+PhysicsSnapshotRing::PhysicsSnapshotRing(int numFrames, size_t reserveBytes)
+    : m_entries(numFrames)
+{
+    assert(numFrames > 0);
+    for (Entry& entry : m_entries)
+    {
+        entry.snapshot.Reserve(reserveBytes);
     }
-}
\ No newline at end of file
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsSnapshotRing::Save(const PhysicsWorld& world, uint32_t frame)
+{
+    Entry& entry = m_entries[frame % m_entries.size()];
+    world.SaveSnapshot(&entry.snapshot);
+    entry.frame = frame;
+    entry.valid = true;
+}
+//-------------------------------------------------------------------------------------------------
+bool PhysicsSnapshotRing::Has(uint32_t frame) const
+{
+    const Entry& entry = m_entries[frame % m_entries.size()];
+    return entry.valid && entry.frame == frame;
+}
+//-------------------------------------------------------------------------------------------------
+bool PhysicsSnapshotRing::Restore(PhysicsWorld* world, uint32_t frame) const
+{
+    return Has(frame) && world->RestoreSnapshot(m_entries[frame % m_entries.size()].snapshot);
+}
+//-------------------------------------------------------------------------------------------------
+void PhysicsSnapshotRing::Clear()
+{
+    for (Entry& entry : m_entries)
+    {
+        entry.valid = false;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+Physics::Physics(PhysicsShape* shape, const StaticPhysicsData& physicsData, PhysicsWorld* world)
+    : m_world(world ? world : Physics_GetWorld())
+{
+    m_handle = m_world->AddBody(shape, physicsData, this);
+}
+//-------------------------------------------------------------------------------------------------
+Physics::~Physics()
+{
+    m_world->RemoveBody(m_handle);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+PhysicsWorld* Physics_GetWorld()
+{
+    static PhysicsWorld* s_world = new PhysicsWorld();
+    return s_world;
+}
+//-------------------------------------------------------------------------------------------------
+void Physics_Update(float dt)
+{
+    Physics_GetWorld()->Update(dt);
+}
+//-------------------------------------------------------------------------------------------------
+int Physics_Advance(float frameDt)
+{
+    return Physics_GetWorld()->Advance(frameDt);
+}
+void Physics_SetStepSettings(const PhysicsStepSettings& settings)
+{
+    Physics_GetWorld()->SetStepSettings(settings);
+}
+//-------------------------------------------------------------------------------------------------
+void Physics_SetBroadphase(BROADPHASE_TYPE type)
+{
+    Physics_GetWorld()->SetBroadphase(type);
+}
+//-------------------------------------------------------------------------------------------------
+void Physics_SetSolverSettings(const PhysicsSolverSettings& settings)
+{
+    Physics_GetWorld()->SetSolverSettings(settings);
+}
+const PhysicsSolverSettings& Physics_GetSolverSettings()
+{
+    return Physics_GetWorld()->GetSolverSettings();
+}
+//-------------------------------------------------------------------------------------------------
+void Physics_QueryAABB(const aabb& region, std::vector<Physics*>* out)
+{
+    PhysicsWorld* world = Physics_GetWorld();
+    std::vector<PhysicsHandle> found;
+    world->QueryAABB(region, &found);
+    for (PhysicsHandle handle : found)
+    {
+        if (world->IsValid(handle) && world->GetOwner(handle))
+        {
+            out->push_back(world->GetOwner(handle));
+        }
+    }
+}
+//-------------------------------------------------------------------------------------------------
+Physics* Physics_RayCast(const vector3& from, const vector3& to, float* outFraction)
+{
+    PhysicsWorld* world = Physics_GetWorld();
+    const PhysicsHandle hit = world->RayCast(from, to, outFraction);
+    return world->IsValid(hit) ? world->GetOwner(hit) : nullptr;
+}
@@ -3,8 +3,16 @@
 
 #include "../engine/vector.h"
 #include "../engine/matrix.h"
+#include "../engine/aabb.h"
+#include <vector>
+#include <cstdint>
 
 class PhysicsShape;
+class Physics;
+class Broadphase;
+struct SolverBody;
+struct ContactManifold;
+struct BroadphasePair;
 
 
 //
@@ -15,19 +23,38 @@ enum COLLISION_RESPONSE
     COLLISION_RESPONSE_NONE,
     COLLISION_RESPONSE_IMPULSE,
 };
+enum BROADPHASE_TYPE
+{
+    BROADPHASE_SWEEP_AND_PRUNE, // the default, best when most things are moving
+    BROADPHASE_AABB_TREE,       // best with lots of objects that mostly sit still
+    BROADPHASE_SPATIAL_HASH,    // best with lots of objects about the same size
+};
 struct CollisionData
 {
-    vector3 a_normal; // the normal to the face that collided on A
-    vector3 b_normal; // the normal to the face that collided on B
-    vector3 penetrationDirection;
+    vector3 penetrationDirection; // the way to move A to separate them (B goes the other way)
     float   depth;
+    vector3 a_point; // the deepest point of A inside B, and of B inside A (world space)
+    vector3 b_point;
+    bool overlap = false; // what DetectCollision returned
     bool success = false;
 };
-struct Collision
+//
+// Contact solver tuning (see contact_solver.h)
+//
+struct PhysicsSolverSettings
 {
-    class Physics* a;
-    class Physics* b;
-    CollisionData data;
+    int   velocityIterations = 8;       // passes over every contact per step, more makes stacks stiffer
+    float baumgarte = 0.2f;             // fraction of the penetration (past the slop) fixed each step
+    float linearSlop = 0.01f;           // penetration that's left alone, so resting contacts stay touching
+    float restitutionThreshold = 1.0f;  // closing speeds below this don't bounce
+    bool  splitImpulse = true;          // push out of penetration without adding velocity, otherwise Baumgarte
+    bool  warmStarting = true;          // start each contact from the impulse it ended the last step with
+
+    // an island that's been still (slower than both of these, m/s and rad/s) for timeToSleep goes to sleep
+    bool  allowSleeping = true;
+    float sleepLinearVelocity = 0.02f;
+    float sleepAngularVelocity = 0.05f;
+    float timeToSleep = 0.5f;
 };
 
 //
@@ -37,67 +64,385 @@ struct StaticPhysicsData
 {
     vector3 m_gravity;
     vector3 m_initialPosition;
-    vector3 m_initialRotation;
+    vector3 m_initialRotation;   // euler angles, as matrix4::rotate
 
     float   m_mass = 0.0f;
     float   m_elasticity = 0.0f;
     float   m_staticFrictionCoeff = 0.0f; // for colliding objects
     float   m_dynamicFrictionCoeff = 0.0f; // for sliding objects
     COLLISION_RESPONSE m_collisionResponseType = COLLISION_RESPONSE_NONE;
+    bool    m_continuousCollision = false; // always sweep this object for collisions (fast objects are swept regardless)
 
     float   m_momentOfInertia = 0.0f;
     matrix3 m_inertiaTensor;
     matrix3 m_inverseInertiaTensor;
 };
 
+//
+// Handle to a body in a PhysicsWorld
+//   Slots are reused once their body is removed, the generation tells the old body and the new one
+//   apart, so a handle to a removed body is caught rather than quietly reaching whatever took its place
+//
+struct PhysicsHandle
+{
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool operator==(const PhysicsHandle& o) const { return index == o.index && generation == o.generation; }
+    bool operator!=(const PhysicsHandle& o) const { return !(*this == o); }
+};
+
+//
+// Fixed timestep, for PhysicsWorld::Advance
+//   Steps are always fixedDt long, however long the frames are, so a step costs the same and comes out
+//   the same every time.  A frame slow enough to need more than maxSubsteps steps to catch up on gets
+//   maxSubsteps and the rest of its time is dropped, otherwise the extra steps make the next frame slower
+//   still, and the one after that slower again.
+//
+struct PhysicsStepSettings
+{
+    float fixedDt = 1.0f / 60.0f;
+    int   maxSubsteps = 4;
+};
+
+//
+// Per body arrays for PhysicsWorld: a vector3 (or matrix3) per body, split into an array per component
+// so the integrator can load the same component of 4 or 8 bodies at once (see PhysUtil_IntegratePositions)
+//
+typedef std::vector<float, AlignedAllocator<float, 32>> PhysicsFloatArray;
+template<int N>
+struct PhysicsComponentArrays
+{
+    PhysicsFloatArray components[N];
+
+    int  size() const { return (int)components[0].size(); }
+    void resize(int n) { for (PhysicsFloatArray& c : components) c.resize(n); }
+    // the last one fills the gap
+    void RemoveSwapBack(int index) { for (PhysicsFloatArray& c : components) { c[index] = c.back(); c.pop_back(); } }
+};
+struct PhysicsVector3Array : PhysicsComponentArrays<3>
+{
+    vector3 operator[](int i) const { return vector3(components[0][i], components[1][i], components[2][i]); }
+    void Set(int i, const vector3& v) { components[0][i] = v.x; components[1][i] = v.y; components[2][i] = v.z; }
+    void push_back(const vector3& v) { resize(size() + 1); Set(size() - 1, v); }
+};
+struct PhysicsMatrix3Array : PhysicsComponentArrays<9>
+{
+    matrix3 operator[](int i) const
+    {
+        const PhysicsFloatArray* c = components;
+        return matrix3(c[0][i], c[1][i], c[2][i], c[3][i], c[4][i], c[5][i], c[6][i], c[7][i], c[8][i]);
+    }
+    void Set(int i, const matrix3& m)
+    {
+        const float v[9] = { m.x1, m.x2, m.x3, m.y1, m.y2, m.y3, m.z1, m.z2, m.z3 };
+        for (int c = 0; c < 9; c++) components[c][i] = v[c];
+    }
+    void push_back(const matrix3& m) { resize(size() + 1); Set(size() - 1, m); }
+};
+struct PhysicsQuaternionArray : PhysicsComponentArrays<4>
+{
+    quaternion operator[](int i) const { return quaternion(components[0][i], components[1][i], components[2][i], components[3][i]); }
+    void Set(int i, const quaternion& q) { components[0][i] = q.x; components[1][i] = q.y; components[2][i] = q.z; components[3][i] = q.w; }
+    void push_back(const quaternion& q) { resize(size() + 1); Set(size() - 1, q); }
+};
+
+//
+// PhysicsSnapshot
+//   Everything about a PhysicsWorld that changes as it steps (where the bodies are and how they're moving, whether
+//   they're asleep, and the contacts the solver warm starts from) packed into one block of memory.  Restoring it
+//   puts the world back exactly as it was, so stepping on from there comes out the same to the bit.  It only fits
+//   the world it came from with the same bodies in it, adding or removing one (or changing the broadphase) leaves
+//   older snapshots unusable.  The buffer is kept from one save to the next, so saving only allocates if the world
+//   has grown.
+//
+class PhysicsSnapshot
+{
+public:
+    const uint8_t* GetData() const { return m_data.data(); }
+    size_t         GetSize() const { return m_size; }
+    void           Reserve(size_t bytes) { if (m_data.size() < bytes) m_data.resize(bytes); }
+
+private:
+    friend class PhysicsWorld;
+    std::vector<uint8_t> m_data; // big enough for the most contact points the pairs could have, m_size is what's used
+    size_t               m_size = 0;
+};
+
+//
+// PhysicsWorld
+//   Owns a set of bodies and steps them together, any number of worlds can exist side by side.  Each piece
+//   of a body's state has an array of its own (structure of arrays), with the live bodies packed into the
+//   first GetBodyCount() entries: a pass over the bodies only pulls in the arrays it uses, and removing a
+//   body moves the last one into the gap.  Bodies are reached through handles, which don't care where in
+//   the arrays the body has been moved to.
+//
+class PhysicsWorld
+{
+public:
+    PhysicsWorld();
+    ~PhysicsWorld();
+    PhysicsWorld(const PhysicsWorld&) = delete;
+    PhysicsWorld& operator=(const PhysicsWorld&) = delete;
+
+    // owner is what GetOwner (and the Physics_ queries) hand back for it, it can be null
+    PhysicsHandle AddBody(const PhysicsShape* shape, const StaticPhysicsData& data, Physics* owner = nullptr);
+    void          RemoveBody(PhysicsHandle handle);
+    bool          IsValid(PhysicsHandle handle) const;
+    int           GetBodyCount() const { return m_position.size(); }
+
+    void Update(float dt);
+    // Adds frameDt to the time waiting to be simulated and runs as many fixed steps (Update) as it covers,
+    // returns how many.  What's left over, less than a step, waits for the next frame
+    int  Advance(float frameDt);
+    void SetStepSettings(const PhysicsStepSettings& settings) { m_stepSettings = settings; }
+    const PhysicsStepSettings& GetStepSettings() const { return m_stepSettings; }
+    // how far (0 to 1) the time Advance has been given is through the step after the last one it ran.  Drawing
+    // the bodies that far from where they were before that step to where they are now stays smooth whatever
+    // the frame rate, at the cost of showing them a step behind
+    float GetInterpolationAlpha() const { return m_accumulator / m_stepSettings.fixedDt; }
+    matrix4 GetInterpolatedTransform(PhysicsHandle handle) const;
+    // time Advance has thrown away because it was behind by more than maxSubsteps
+    float GetDroppedTime() const { return m_droppedTime; }
+    void SetBroadphase(BROADPHASE_TYPE type);
+    // see PhysicsSnapshot.  Restore returns false, and leaves the world alone, if the snapshot doesn't fit
+    void SaveSnapshot(PhysicsSnapshot* out) const;
+    bool RestoreSnapshot(const PhysicsSnapshot& snapshot);
+    // A hash of the bits of every body's position, rotation, momentum and sleep state.  Two worlds given the same
+    // bodies and the same inputs have the same hash after every step, built with DETERMINISTIC_MATH (see lib.h)
+    // that holds between compilers and platforms too, so comparing hashes is enough to spot a simulation drifting
+    uint64_t GetStateHash() const;
+    void SetSolverSettings(const PhysicsSolverSettings& settings) { m_solverSettings = settings; }
+    const PhysicsSolverSettings& GetSolverSettings() const { return m_solverSettings; }
+    // every body whose bounds overlap region
+    void          QueryAABB(const aabb& region, std::vector<PhysicsHandle>* out) const;
+    // the first body on the segment from -> to (or an invalid handle), outFraction is how far along it is hit (within CCD_TOLERANCE)
+    PhysicsHandle RayCast(const vector3& from, const vector3& to, float* outFraction = nullptr) const;
+
+    // the body behind a handle, the handle has to be valid
+    vector3 GetPosition(PhysicsHandle handle) const { return m_position[GetIndex(handle)]; }
+    quaternion GetRotation(PhysicsHandle handle) const { return m_rotation[GetIndex(handle)]; }
+    vector3 GetLinearVelocity(PhysicsHandle handle) const { return GetLinearVelocity(GetIndex(handle)); }
+    vector3 GetAngularVelocity(PhysicsHandle handle) const { return GetAngularVelocity(GetIndex(handle)); }
+    // cached by Update, only rebuilt here if the body was moved some other way since
+    const matrix4& GetTransform(PhysicsHandle handle) const;
+    const aabb&    GetWorldAABB(PhysicsHandle handle) const;
+    const PhysicsShape*      GetShape(PhysicsHandle handle) const { return m_shape[GetIndex(handle)]; }
+    const StaticPhysicsData& GetStaticData(PhysicsHandle handle) const { return m_static[GetIndex(handle)]; }
+    Physics*                 GetOwner(PhysicsHandle handle) const { return m_owner[GetIndex(handle)]; }
+
+    // Sleeping bodies aren't moved, sent to the broadphase or collision tested, so they cost next to nothing.
+    // Anything moving that touches one wakes it (and whatever it was touching), as does ApplyImpulse or Reset,
+    // or something being put (by Reset or SetPosition) where it was resting or where it now overlaps it.
+    bool IsSleeping(PhysicsHandle handle) const { return (m_flags[GetIndex(handle)] & BODY_SLEEPING) != 0; }
+    void WakeUp(PhysicsHandle handle) { WakeUp(GetIndex(handle)); }
+    void ApplyImpulse(PhysicsHandle handle, const vector3& impulse, const vector3& point); // point is in world space
+    void Reset(PhysicsHandle handle); // back where it started, and still
+    // moves one body through dt on its own, with nothing to collide with
+    void Integrate(PhysicsHandle handle, float dt);
+    // tell the broadphase where it's moved to now rather than on the next Update
+    void UpdateBroadphase(PhysicsHandle handle) { UpdateBroadphase(GetIndex(handle)); }
+
+#ifdef TEST_PROGRAM
+    void SetPosition(PhysicsHandle handle, const vector3& v);
+    void SetRotation(PhysicsHandle handle, const quaternion& q);
+#endif
+private:
+    struct Contacts; // pairs and solver state, see physics.cpp
+
+    enum : uint8_t
+    {
+        BODY_SLEEPING          = 1 << 0,
+        BODY_TRANSFORM_DIRTY   = 1 << 1, // position or rotation changed since m_transform was built
+        BODY_BROADPHASE_DIRTY  = 1 << 2, // the broadphase hasn't seen the latest m_worldAABB
+        BODY_SWEPT             = 1 << 3, // moved by UpdateContinuous this step rather than the integrator
+    };
+
+    int  GetIndex(PhysicsHandle handle) const;
+    PhysicsHandle GetHandle(int index) const { return { m_slotOf[index], m_slots[m_slotOf[index]].generation }; }
+    int  GetBodyFromProxy(int proxy) const; // -1 if the body has been removed
+    // rebuilds everything derived from the position and orientation (the transform, bounds and world inverse inertia)
+    void UpdateTransform(int index) const;
+    void CleanTransform(int index) const { if (m_flags[index] & BODY_TRANSFORM_DIRTY) UpdateTransform(index); }
+    const matrix4& GetTransform(int index) const;
+    const aabb&    GetWorldAABB(int index) const;
+    void UpdateBroadphase(int index);
+    vector3 GetLinearVelocity(int index) const { return m_linearMomentum[index] * m_invMass[index]; }
+    vector3 GetAngularVelocity(int index) const { CleanTransform(index); return m_invInertiaWorld[index] * m_angularMomentum[index]; }
+
+    // a step is these two, with the contacts solved in between.  Update does every body at once with
+    // PhysUtil_IntegrateVelocities/Positions, which do exactly the same sums
+    void IntegrateVelocity(int index, float dt);
+    void IntegratePosition(int index, float dt, const vector3& pushVelocity, const vector3& pushAngularVelocity);
+    // to and from the solver, only bodies with COLLISION_RESPONSE_IMPULSE (and mass) get moved by it
+    void GetSolverBody(int index, SolverBody* out) const;
+    void SetSolverBody(int index, const SolverBody& body);
+    void GetContacts(std::vector<ContactManifold*>* outManifolds);
+    // forgets the pairs the broadphase says have come apart, waking (into woken) whatever that leaves with nothing to rest on
+    void RemovePairs(const std::vector<BroadphasePair>& removed, std::vector<int>* woken);
+    struct PhysUtilBodyArrays GetBodyArrays(uint8_t skipFlags);
+
+    // Update for bodies that move too far in one step to trust the overlap test at the end of it:
+    // stops at the first thing it would hit, resolves that collision, then carries on with the time left
+    bool NeedsContinuousCollision(int index, float dt) const;
+    void UpdateContinuous(int index, float dt);
+    struct SweepParams GetSweep(int index) const;
+    // solves a single contact on the spot, for the continuous collision
+    void ResolveImpact(int index, int other, const CollisionData& data);
+
+    // every per body float that changes as the world steps, in the order snapshots keep them
+    static constexpr int NUM_STEPPED_ARRAYS = 21;
+    void GetSteppedArrays(float* out[NUM_STEPPED_ARRAYS]) const;
+
+    // has mass, and isn't asleep
+    bool  IsMoving(int index) const { return (m_flags[index] & BODY_SLEEPING) == 0 && m_invMass[index] != 0.0f; }
+    void  WakeUp(int index);
+    void  Sleep(int index);
+    // wakes everything whose box overlaps this one's, for a body about to be put somewhere (and once it's there)
+    // rather than moved: nothing it leaves or lands on would notice otherwise, least of all if it's static
+    void  WakeOverlapping(int index);
+    // how long it's been still for (as of the step just solved), so its island can decide whether to sleep
+    float UpdateSleepTime(int index, const SolverBody& body, float dt);
+
+    // per body, in step with each other.  Hot: what every step reads or writes for every body
+    PhysicsVector3Array   m_position;
+    PhysicsQuaternionArray m_rotation;          // unit length
+    PhysicsVector3Array   m_linearMomentum;
+    PhysicsVector3Array   m_angularMomentum;
+    PhysicsFloatArray     m_mass;
+    PhysicsFloatArray     m_invMass;            // zero for anything without mass, which doesn't move
+    PhysicsMatrix3Array   m_invInertia;         // in the body's own space
+    PhysicsVector3Array   m_gravity;
+    std::vector<float>    m_sleepTime;
+    mutable std::vector<uint8_t> m_flags;       // BODY_
+    // the solver's push velocities for this step, laid out for the integrator
+    PhysicsVector3Array   m_pushVelocity;
+    PhysicsVector3Array   m_pushAngularVelocity;
+    // derived from the position and rotation, anything that changes those has to set BODY_TRANSFORM_DIRTY
+    mutable std::vector<matrix4> m_transform;
+    mutable std::vector<aabb>    m_worldAABB;
+    mutable PhysicsMatrix3Array  m_invInertiaWorld; // rotation * m_invInertia * transpose(rotation)
+    // where each body was before Advance's last step, for GetInterpolatedTransform
+    PhysicsVector3Array    m_previousPosition;
+    PhysicsQuaternionArray m_previousRotation;
+    // cold: only looked at for collisions, or never changes
+    std::vector<int>                 m_broadphaseProxy;
+    std::vector<const PhysicsShape*> m_shape;
+    std::vector<float>               m_boundingRadius;
+    std::vector<StaticPhysicsData>   m_static;
+    std::vector<Physics*>            m_owner;
+    std::vector<uint32_t>            m_slotOf;  // the handle slot pointing at each body
+
+    // handle slot -> where the body is in the arrays above
+    struct Slot
+    {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+    };
+    std::vector<Slot>     m_slots;
+    std::vector<uint32_t> m_freeSlots;
+
+    Broadphase*           m_broadphase = nullptr;
+    Contacts*             m_contacts = nullptr;
+    PhysicsSolverSettings m_solverSettings;
+    PhysicsStepSettings   m_stepSettings;
+    float                 m_accumulator = 0.0f; // time given to Advance that hasn't been stepped through yet
+    float                 m_droppedTime = 0.0f;
+    uint32_t              m_layoutVersion = 0;     // changes whenever a body is added or removed, or the broadphase is
+    bool                  m_pruneContacts = false; // after a restore, drop the pairs that aren't overlapping any more
+    bool                  m_broadphaseStale = true; // proxies added, removed or moved since the broadphase's last Update
+    const uint32_t        m_serial;                // this world's own, for its snapshots (its address could be a later world's too)
+};
+
+//
+// PhysicsSnapshotRing - snapshots of the last few frames, to roll back to
+//   Frames are numbered however the caller likes.  The snapshots are made up front and reused, saving a frame
+//   writes over whichever one held the frame numFrames before it.
+//
+class PhysicsSnapshotRing
+{
+public:
+    // reserveBytes is a guess at the snapshot size (PhysicsSnapshot::GetSize) so the first saves don't allocate either
+    explicit PhysicsSnapshotRing(int numFrames, size_t reserveBytes = 0);
+
+    void Save(const PhysicsWorld& world, uint32_t frame);
+    bool Has(uint32_t frame) const;
+    // puts world back the way it was when frame was saved, false if that frame's been written over (or never saved)
+    bool Restore(PhysicsWorld* world, uint32_t frame) const;
+    void Clear();
+
+private:
+    struct Entry
+    {
+        uint32_t        frame = 0;
+        bool            valid = false;
+        PhysicsSnapshot snapshot;
+    };
+    std::vector<Entry> m_entries;
+};
+
 //
 // Physics
 //   For objects that exist in the physics sim, this describes the necessary parameters for them to
-//   interact and be interacted with other objects
+//   interact and be interacted with other objects.  A body in a PhysicsWorld that lives as long as
+//   this does, which has to be less long than the world.
 //
 class Physics
 {
 public:
-    Physics(PhysicsShape* shape, const StaticPhysicsData& physicsData);
+    // with no world it goes in the one the Physics_ functions below work on
+    Physics(PhysicsShape* shape, const StaticPhysicsData& physicsData, PhysicsWorld* world = nullptr);
     ~Physics();
+    Physics(const Physics&) = delete;
+    Physics& operator=(const Physics&) = delete;
 
 public:
-    void      Reset();
-    void      Update(float dt);
-
-    vector3 GetPosition() const { return m_position; }
-    vector3 GetRotation() const { return m_rotation; }
-    matrix4 GetTransform() const  { 
-        // todo: should already have this...
-        matrix4 transform;
-        transform.translate(m_position);
-        transform.rotate(m_rotation);
-        return transform;
-    }
-    COLLISION_RESPONSE GetCollisionResponse() const { return m_static.m_collisionResponseType; }
-    const PhysicsShape* GetPhysicsShape() const { return m_physicsShape; }
-    
-    void ApplyImpulseResponse(CollisionData& data, vector3 normal);
+    PhysicsWorld* GetWorld() const { return m_world; }
+    PhysicsHandle GetHandle() const { return m_handle; }
+
+    void      Reset() { m_world->Reset(m_handle); }
+    void      Update(float dt) { m_world->Integrate(m_handle, dt); }
+    void      UpdateBroadphase() { m_world->UpdateBroadphase(m_handle); } // tell the broadphase where we've moved to
+
+    vector3 GetPosition() const { return m_world->GetPosition(m_handle); }
+    quaternion GetRotation() const { return m_world->GetRotation(m_handle); }
+    const matrix4& GetTransform() const { return m_world->GetTransform(m_handle); }
+    matrix4        GetInterpolatedTransform() const { return m_world->GetInterpolatedTransform(m_handle); } // see PhysicsWorld::Advance
+    const aabb&    GetWorldAABB() const { return m_world->GetWorldAABB(m_handle); }
+    vector3 GetLinearVelocity() const { return m_world->GetLinearVelocity(m_handle); }
+    vector3 GetAngularVelocity() const { return m_world->GetAngularVelocity(m_handle); }
+    COLLISION_RESPONSE GetCollisionResponse() const { return GetStaticData().m_collisionResponseType; }
+    const PhysicsShape* GetPhysicsShape() const { return m_world->GetShape(m_handle); }
+    const StaticPhysicsData& GetStaticData() const { return m_world->GetStaticData(m_handle); }
+
+    bool IsSleeping() const { return m_world->IsSleeping(m_handle); }
+    void WakeUp() { m_world->WakeUp(m_handle); }
+    void ApplyImpulse(const vector3& impulse, const vector3& point) { m_world->ApplyImpulse(m_handle, impulse, point); }
 
 #ifdef TEST_PROGRAM
-    void SetPosition(const vector3& v) { m_position = v; }
-    void SetRotation(const vector3& v) { m_rotation = v; }
+    void SetPosition(const vector3& v) { m_world->SetPosition(m_handle, v); }
+    void SetRotation(const quaternion& q) { m_world->SetRotation(m_handle, q); }
 #endif
 private:
-    // constant, for reference
-    const PhysicsShape* m_physicsShape;
-    const StaticPhysicsData  m_static;
-
-    vector3   m_position;
-    vector3   m_rotation;
-    vector3   m_linearMomentum;
-    vector3   m_angularMomentum;
+    PhysicsWorld* m_world;
+    PhysicsHandle m_handle;
 };
 
 
 
-// C-Style interface
+// C-Style interface, for the world Physics objects go in by default
+PhysicsWorld* Physics_GetWorld();
 void Physics_Update(float dt);
+int  Physics_Advance(float frameDt); // fixed steps, see PhysicsWorld::Advance
+void Physics_SetStepSettings(const PhysicsStepSettings& settings);
+
+void Physics_SetBroadphase(BROADPHASE_TYPE type);
+void Physics_SetSolverSettings(const PhysicsSolverSettings& settings);
+const PhysicsSolverSettings& Physics_GetSolverSettings();
+// every object whose bounds overlap region
+void Physics_QueryAABB(const aabb& region, std::vector<Physics*>* out);
+// the first object on the segment from -> to (or null), outFraction is how far along it is hit (within CCD_TOLERANCE)
+Physics* Physics_RayCast(const vector3& from, const vector3& to, float* outFraction = nullptr);
 
 
 struct CollisionParams
@@ -107,7 +452,49 @@ struct CollisionParams
     matrix4  aTransform;
     matrix4  bTransform;
 };
-bool DetectCollision(const CollisionParams& params, bool is3D, CollisionData* outCollision);
+// Carried from one query of a pair to the next (see GetContacts).  Most pairs barely move between
+// ticks, so the axis that separated them last time usually still does and GJK can be skipped entirely.
+struct CollisionCache
+{
+    vector3 axis;       // last separating axis (or penetration direction if they were overlapping)
+    int     a_index = -1; // support hints for the first GJK point
+    int     b_index = -1;
+    bool    valid = false;
+};
+// If the cached axis still separates the pair this returns false straight away, and outCollision
+// (if any) has success = false rather than a separation distance.
+bool DetectCollision(const CollisionParams& params, bool is3D, CollisionData* outCollision, CollisionCache* cache = nullptr);
+// DetectCollision (3D) for n pairs at once, spread over the worker pool.  out must have room for n results,
+// caches (optional) is n pointers, each can be null.  Results are the same as calling DetectCollision in order.
+void DetectCollisionBatch(const CollisionParams* pairs, size_t n, CollisionData* out, CollisionCache* const* caches = nullptr);
+
+struct DistanceData
+{
+    vector3 a_point;  // closest point on A
+    vector3 b_point;  // closest point on B
+    vector3 normal;   // unit direction from a_point to b_point
+    float   distance = 0.0f;
+    bool    overlap = false;
+};
+// Distance between two shapes that don't overlap, and the points where they come closest.
+// Returns false if they overlap (out->overlap is set) or are further than maxDistance apart, in which case
+// distance is only a lower bound and the points are not filled in.
+bool GetClosestPoints(const CollisionParams& params, bool is3D, float maxDistance, DistanceData* out);
+
+// A shape moving at a constant velocity over a step (angular velocity in world space)
+struct SweepParams
+{
+    const PhysicsShape* shape;
+    vector3 position;
+    quaternion rotation;
+    vector3 velocity;
+    vector3 angularVelocity;
+};
+// First time in [0, maxTime] that the two shapes come within CCD_TOLERANCE of each other, found by
+// conservative advancement.  outContact is the closest points at that time (overlap if they started that way).
+// Returns false if they never get that close, or are already touching and moving apart.
+static constexpr float CCD_TOLERANCE = 0.01f;
+bool GetTimeOfImpact(const SweepParams& a, const SweepParams& b, float maxTime, float* outTime, DistanceData* outContact);
 
 
 
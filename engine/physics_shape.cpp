@@ -3,6 +3,8 @@
 
 #include "matrix.h"
 #include <vector>
+#include <algorithm>
+#include <cstring>
 #include "windows.h"
 #include "physics_util.h"
 #include "util.h"
@@ -15,25 +17,257 @@
 //-------------------------------------------------------------------------------------------------
 void Mesh::AddTriangle(const vector3& a, const vector3& b, const vector3& c, const vector3& n)
 {
-    AddVertex(a,n);
-    AddVertex(b,n);
-    AddVertex(c,n);
+    SyncWeldGrid();
+    m_indices.push_back(FindOrAddVertex(a, n));
+    m_indices.push_back(FindOrAddVertex(b, n));
+    m_indices.push_back(FindOrAddVertex(c, n));
 }
 //-------------------------------------------------------------------------------------------------
 void Mesh::AddVertex(const vector3& pos, const vector3& normal)
 {
-    for (int i = 0; i < m_vertexPos.size(); i++)
+    SyncWeldGrid();
+    m_indices.push_back(FindOrAddVertex(pos, normal));
+}
+//-------------------------------------------------------------------------------------------------
+void Mesh::Reserve(int numVertices, int numIndices)
+{
+    m_vertexPos.reserve(numVertices);
+    m_vertexNormals.reserve(numVertices);
+    m_indices.reserve(numIndices);
+    m_weldNext.reserve(numVertices);
+    m_weldPos.reserve(numVertices);
+    m_weldCells.reserve(numVertices);
+}
+//-------------------------------------------------------------------------------------------------
+void Mesh::AppendTriangles(const vector3* positions, const vector3* normals, int numVertices, const unsigned int* indices, int numIndices)
+{
+    assert(numIndices % 3 == 0);
+    std::vector<unsigned int> remap(numVertices);
+    SyncWeldGrid();
+    for (int i = 0; i < numVertices; i++)
+    {
+        remap[i] = FindOrAddVertex(positions[i], normals[i]);
+    }
+    for (int i = 0; i < numIndices; i++)
+    {
+        assert((int)indices[i] < numVertices);
+        m_indices.push_back(remap[indices[i]]);
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void Mesh::SetWeldEpsilon(float epsilon)
+{
+    assert(epsilon >= 0.0f);
+    m_weldEpsilon = epsilon;
+    m_weldInvCellSize = 1.0f / max(4.0f * epsilon, WELD_MIN_CELL_SIZE);
+    m_weldCells.clear(); // different cells now
+    m_weldNext.clear();
+    m_weldPos.clear();
+}
+//-------------------------------------------------------------------------------------------------
+static int64_t GetWeldCell(float value, float invCellSize)
+{
+    const double cell = floor((double)value * invCellSize);
+    return cell < -4e18 ? (int64_t)-4e18 : cell > 4e18 ? (int64_t)4e18 : (int64_t)cell;
+}
+static uint64_t GetWeldKey(int64_t x, int64_t y, int64_t z)
+{
+    // different cells can share a key, it only costs a few extra comparisons
+    return (uint64_t)x * 73856093ull ^ (uint64_t)y * 19349663ull ^ (uint64_t)z * 83492791ull;
+}
+//-------------------------------------------------------------------------------------------------
+void Mesh::AddToWeldGrid(int vertex)
+{
+    const vector3& p = m_vertexPos[vertex];
+    const uint64_t key = GetWeldKey(GetWeldCell(p.x, m_weldInvCellSize), GetWeldCell(p.y, m_weldInvCellSize), GetWeldCell(p.z, m_weldInvCellSize));
+    auto it = m_weldCells.find(key);
+    m_weldNext.push_back(it == m_weldCells.end() ? -1 : it->second);
+    m_weldPos.push_back(p);
+    m_weldCells[key] = vertex;
+}
+//-------------------------------------------------------------------------------------------------
+void Mesh::SyncWeldGrid()
+{
+    // catch the grid up with anything put straight into m_vertexPos.  A vertex that's been moved (or removed)
+    // would be left in the wrong cell, start again
+    const size_t known = m_weldPos.size();
+    if (known > m_vertexPos.size() || (known > 0 && memcmp(m_weldPos.data(), m_vertexPos.data(), known * sizeof(vector3)) != 0))
+    {
+        m_weldCells.clear();
+        m_weldNext.clear();
+        m_weldPos.clear();
+    }
+    while (m_weldPos.size() < m_vertexPos.size())
+    {
+        AddToWeldGrid((int)m_weldPos.size());
+    }
+}
+//-------------------------------------------------------------------------------------------------
+int Mesh::FindOrAddVertex(const vector3& pos, const vector3& normal)
+{
+    // the cells are wider than the epsilon, so only the ones pos +- epsilon reaches into can hold a match.
+    // Take the oldest match, same as the linear search this replaced.
+    int found = -1;
+    const int64_t lowX = GetWeldCell(pos.x - m_weldEpsilon, m_weldInvCellSize), highX = GetWeldCell(pos.x + m_weldEpsilon, m_weldInvCellSize);
+    const int64_t lowY = GetWeldCell(pos.y - m_weldEpsilon, m_weldInvCellSize), highY = GetWeldCell(pos.y + m_weldEpsilon, m_weldInvCellSize);
+    const int64_t lowZ = GetWeldCell(pos.z - m_weldEpsilon, m_weldInvCellSize), highZ = GetWeldCell(pos.z + m_weldEpsilon, m_weldInvCellSize);
+    for (int64_t x = lowX; x <= highX; x++)
     {
-        if (m_vertexPos[i] == pos)
+        for (int64_t y = lowY; y <= highY; y++)
         {
-            m_indices.push_back(i);
-            return;
+            for (int64_t z = lowZ; z <= highZ; z++)
+            {
+                auto it = m_weldCells.find(GetWeldKey(x, y, z));
+                for (int v = (it == m_weldCells.end()) ? -1 : it->second; v >= 0; v = m_weldNext[v])
+                {
+                    const vector3& p = m_vertexPos[v];
+                    if (fabsf(p.x - pos.x) <= m_weldEpsilon && fabsf(p.y - pos.y) <= m_weldEpsilon && fabsf(p.z - pos.z) <= m_weldEpsilon
+                        && (found < 0 || v < found))
+                    {
+                        found = v;
+                    }
+                }
+            }
         }
     }
-    int index = (int)m_vertexPos.size();
+    if (found >= 0)
+    {
+        return found;
+    }
+
+    const int index = (int)m_vertexPos.size();
     m_vertexPos.push_back(pos);
     m_vertexNormals.push_back(normal.normalize());
-    m_indices.push_back(index);
+    AddToWeldGrid(index);
+    return index;
+}
+
+//-------------------------------------------------------------------------------------------------
+void Mesh::BuildAdjacency()
+{
+    m_adjacencyStart.clear();
+    m_adjacency.clear();
+
+    const int numVerts = (int)m_vertexPos.size();
+    const int numIndices = (int)m_indices.size();
+    if (numVerts < 4 || numIndices < 3 || (numIndices % 3) != 0)
+    {
+        return; // not a triangle list (i.e. the 2D test shapes)
+    }
+
+    // hill-climbing only finds the global maximum if the mesh is convex and every vertex is a corner
+    // of it.  A vertex in the middle of a flat face can sit on a plateau that isn't the maximum.
+    float extent = 0.0f;
+    for (int i = 0; i < numVerts; i++)
+    {
+        extent = max(extent, max(fabsf(m_vertexPos[i].x), max(fabsf(m_vertexPos[i].y), fabsf(m_vertexPos[i].z))));
+    }
+    const float tolerance = extent * 0.0001f;
+
+    std::vector<vector3> firstNormal(numVerts);
+    std::vector<int> normalCount(numVerts, 0); // 0 = no triangles, 1 = all on one plane, 2 = a corner
+    for (int i = 0; i < numIndices; i += 3)
+    {
+        const vector3& a = m_vertexPos[m_indices[i]];
+        const vector3& b = m_vertexPos[m_indices[i + 1]];
+        const vector3& c = m_vertexPos[m_indices[i + 2]];
+        const vector3 cross = (b - a).cross(c - a);
+        if (FloatEquals(cross.magnitude_sq(), 0.0f))
+        {
+            continue; // degenerate triangle, doesn't tell us anything
+        }
+        const vector3 n = cross.normalize();
+
+        bool anyAbove = false;
+        bool anyBelow = false;
+        for (int j = 0; j < numVerts; j++)
+        {
+            const float d = (m_vertexPos[j] - a).dot(n);
+            anyAbove |= d > tolerance;
+            anyBelow |= d < -tolerance;
+        }
+        if (anyAbove && anyBelow)
+        {
+            return; // concave
+        }
+
+        for (int j = 0; j < 3; j++)
+        {
+            const unsigned int v = m_indices[i + j];
+            if (normalCount[v] == 0)
+            {
+                firstNormal[v] = n;
+                normalCount[v] = 1;
+            }
+            else if (normalCount[v] == 1 && !vector3::Equals(firstNormal[v], n, 0.001f))
+            {
+                normalCount[v] = 2;
+            }
+        }
+    }
+    for (int i = 0; i < numVerts; i++)
+    {
+        if (normalCount[i] != 2)
+        {
+            return; // not a corner, or not used by any triangle
+        }
+    }
+
+    // gather both directions of every triangle edge, sorted so each vertex's neighbours are contiguous
+    std::vector<std::pair<unsigned int, unsigned int>> edges;
+    edges.reserve(numIndices * 2);
+    for (int i = 0; i < numIndices; i += 3)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            const unsigned int va = m_indices[i + j];
+            const unsigned int vb = m_indices[i + (j + 1) % 3];
+            if (va != vb)
+            {
+                edges.push_back({ va, vb });
+                edges.push_back({ vb, va });
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    m_adjacencyStart.resize(numVerts + 1, 0);
+    m_adjacency.resize(edges.size());
+    for (int i = 0; i < (int)edges.size(); i++)
+    {
+        m_adjacencyStart[edges[i].first + 1]++;
+        m_adjacency[i] = edges[i].second;
+    }
+    for (int i = 0; i < numVerts; i++)
+    {
+        m_adjacencyStart[i + 1] += m_adjacencyStart[i];
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+void Mesh::BuildSoA()
+{
+    const int numVerts = (int)m_vertexPos.size();
+    if (numVerts == 0)
+    {
+        m_vertexSoA.clear();
+        m_soaStride = 0;
+        return;
+    }
+
+    m_soaStride = ((numVerts + MESH_SOA_LANES - 1) / MESH_SOA_LANES) * MESH_SOA_LANES;
+    m_vertexSoA.resize(3 * m_soaStride);
+    float* x = &m_vertexSoA[0];
+    float* y = x + m_soaStride;
+    float* z = y + m_soaStride;
+    for (int i = 0; i < m_soaStride; i++)
+    {
+        const vector3& v = m_vertexPos[i < numVerts ? i : 0];
+        x[i] = v.x;
+        y[i] = v.y;
+        z[i] = v.z;
+    }
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -50,17 +284,17 @@ void CreateIcosahadron(float r, int numSubdivisions, Mesh* outMesh)
     float phi = 0;
     for (int i = 1; i < 6; i++)
     {
-		vertexList[i].x = r * cos(theta) * cos(phi);
-		vertexList[i].y = r * cos(theta) * sin(phi);
-		vertexList[i].z = r * -sin(theta);
+		vertexList[i].x = r * Math_Cos(theta) * Math_Cos(phi);
+		vertexList[i].y = r * Math_Cos(theta) * Math_Sin(phi);
+		vertexList[i].z = r * -Math_Sin(theta);
         phi += 2 * PI / 5.0;
     }
-    phi = 0;
+    phi = -PI / 5.0f; // the upper ring sits halfway between the lower ring vertices
     for (int i = 6; i < 11; i++)
     {
-        vertexList[i].x = r * cos(theta) * cos(phi);
-        vertexList[i].y = r * cos(theta) * sin(phi);
-        vertexList[i].z = r * sin(theta);
+        vertexList[i].x = r * Math_Cos(theta) * Math_Cos(phi);
+        vertexList[i].y = r * Math_Cos(theta) * Math_Sin(phi);
+        vertexList[i].z = r * Math_Sin(theta);
         phi += 2 * PI / 5.0;
     }
 
@@ -154,16 +388,23 @@ void CreateIcosahadron(float r, int numSubdivisions, Mesh* outMesh)
         indexList = std::move(subdividedIndexList);
     }
 
-    for (int i = 0; i < vertexList.size(); i++)
+    // every subdivision copies the shared corners, weld them back together.  The normal for a sphere
+    // centered at zero is the same as its position.
+    std::vector<unsigned int> indices;
+    indices.reserve(indexList.size() * 3);
+    for (const Triangle& t : indexList)
     {
-        // normal for a sphere centered at zero is the same as its position
-        outMesh->AddVertex(vertexList[i], vertexList[i]);
+        indices.push_back(t.x);
+        indices.push_back(t.y);
+        indices.push_back(t.z);
     }
+    outMesh->Reserve((int)vertexList.size(), (int)indices.size());
+    outMesh->AppendTriangles(vertexList.data(), vertexList.data(), (int)vertexList.size(), indices.data(), (int)indices.size());
 }
 static void CreateBoxMesh(float width, float depth, float height, Mesh& outMesh)
 {
 	const float half_width = width / 2.0f;
-	const float half_depth = width / 2.0f;
+	const float half_depth = depth / 2.0f;
 	const float half_height = height / 2.0f;
 
 	std::vector<vector3> corners(8);
@@ -226,8 +467,14 @@ static int GetGLDrawFromDrawType(DrawType t)
     return GL_LINE_STRIP;
 }
 //-------------------------------------------------------------------------------------------------
-void MeshPhysicsShape::Draw(const matrix4& t, const DrawParams* params) const
+static void DrawMesh(const Mesh& mesh, const matrix4& t, const DrawParams* params)
 {
+    const DrawParams defaultParams;
+    if (!params)
+    {
+        params = &defaultParams;
+    }
+
 	GLfloat modelMatrix[16];
 	glGetFloatv(GL_MODELVIEW_MATRIX, modelMatrix);
 
@@ -245,17 +492,34 @@ void MeshPhysicsShape::Draw(const matrix4& t, const DrawParams* params) const
     GLenum drawType = GetGLDrawFromDrawType(params->drawType);
 	glEnableClientState(GL_VERTEX_ARRAY);
     glEnableClientState(GL_NORMAL_ARRAY);
-	glVertexPointer(3, GL_FLOAT, 0, &m_mesh.m_vertexPos[0]);
-    glNormalPointer(GL_FLOAT, 0, &m_mesh.m_vertexNormals[0]);
+	glVertexPointer(3, GL_FLOAT, 0, &mesh.m_vertexPos[0]);
+    glNormalPointer(GL_FLOAT, 0, &mesh.m_vertexNormals[0]);
     glColor4fv(color);
-	glDrawElements(drawType, (GLsizei)m_mesh.m_indices.size(), GL_UNSIGNED_INT, &m_mesh.m_indices[0]);
+	glDrawElements(drawType, (GLsizei)mesh.m_indices.size(), GL_UNSIGNED_INT, &mesh.m_indices[0]);
     glDisableClientState(GL_NORMAL_ARRAY);
 	glDisableClientState(GL_VERTEX_ARRAY);
 
 	glPopMatrix();
 }
 //-------------------------------------------------------------------------------------------------
-vector3 MeshPhysicsShape::GetPointFurthestInDirection(const vector3& dir, const matrix4& world, bool is3D) const
+aabb PhysicsShape::GetAABB(const matrix4& world) const
+{
+    aabb box;
+    box.lower.x = GetPointFurthestInDirection(vector3(-1.0f, 0.0f, 0.0f), world, true).x;
+    box.lower.y = GetPointFurthestInDirection(vector3(0.0f, -1.0f, 0.0f), world, true).y;
+    box.lower.z = GetPointFurthestInDirection(vector3(0.0f, 0.0f, -1.0f), world, true).z;
+    box.upper.x = GetPointFurthestInDirection(vector3(1.0f, 0.0f, 0.0f), world, true).x;
+    box.upper.y = GetPointFurthestInDirection(vector3(0.0f, 1.0f, 0.0f), world, true).y;
+    box.upper.z = GetPointFurthestInDirection(vector3(0.0f, 0.0f, 1.0f), world, true).z;
+    return box;
+}
+//-------------------------------------------------------------------------------------------------
+void MeshPhysicsShape::Draw(const matrix4& t, const DrawParams* params) const
+{
+    DrawMesh(m_mesh, t, params);
+}
+//-------------------------------------------------------------------------------------------------
+vector3 MeshPhysicsShape::GetPointFurthestInDirection(const vector3& dir, const matrix4& world, bool is3D, int* inOutHint) const
 {
     // not sure this is right...
     // try and get the farthest points (2 for 2d, 3 for 3d) then get
@@ -308,49 +572,208 @@ vector3 MeshPhysicsShape::GetPointFurthestInDirection(const vector3& dir, const
     // the above doesn't work and i'm not totally sure why... it does find the correct point, but using
     // that in the minkowski difference doesn't get the furthest point in the minkowski difference.
     // reverting to what it was before...
-    return PhysUtil_GetPointFurthestInDirection(m_mesh.m_vertexPos, dir, world, nullptr);
+    //
+    // small meshes are cheaper to scan with SIMD than to walk, big ones walk the surface from the last answer
+    const Mesh& mesh = GetSupportMesh();
+    constexpr int HILL_CLIMB_MIN_VERTS = 4 * MESH_SOA_LANES;
+    if (mesh.HasAdjacency() && mesh.m_vertexPos.size() >= HILL_CLIMB_MIN_VERTS)
+    {
+        int index = inOutHint ? *inOutHint : -1;
+        vector3 result = PhysUtil_GetPointFurthestInDirectionHillClimb(mesh.m_vertexPos, mesh.m_adjacencyStart, mesh.m_adjacency, dir, world, &index);
+        if (inOutHint)
+        {
+            *inOutHint = index;
+        }
+        return result;
+    }
+    return PhysUtil_GetPointFurthestInDirection(mesh, dir, world, inOutHint);
+}
+//-------------------------------------------------------------------------------------------------
+float MeshPhysicsShape::GetBoundingRadius() const
+{
+    float radiusSq = 0.0f;
+    for (const vector3& v : GetSupportMesh().m_vertexPos)
+    {
+        radiusSq = max(radiusSq, v.magnitude_sq());
+    }
+    return Math_Sqrt(radiusSq);
 }
 void MeshPhysicsShape::CreateSphere(float radius)
 {
     CreateIcosahadron(radius, 3, &m_mesh);
+    CookHull();
 }
 void MeshPhysicsShape::CreateBox(float width, float depth, float height)
 {
     CreateBoxMesh(width, depth, height, m_mesh);
+    CookHull();
+}
+//-------------------------------------------------------------------------------------------------
+void MeshPhysicsShape::CookHull()
+{
+    // rendering meshes carry interior and coplanar vertices GJK has no use for, only keep the corners
+    m_hull = Mesh();
+    ConvexHull hull;
+    if (!PhysUtil_BuildConvexHull(m_mesh.m_vertexPos, &hull))
+    {
+        return;
+    }
+    m_hull.m_vertexPos = hull.vertices;
+    m_hull.m_vertexNormals.assign(hull.vertices.size(), vector3());
+    for (const ConvexHullFace& face : hull.faces)
+    {
+        for (unsigned int i = 0; i < face.numIndices; i++)
+        {
+            const unsigned int v = hull.faceIndices[face.firstIndex + i];
+            m_hull.m_vertexNormals[v] = m_hull.m_vertexNormals[v] + face.normal;
+        }
+    }
+    for (vector3& n : m_hull.m_vertexNormals)
+    {
+        n = n.normalize();
+    }
+    m_hull.m_indices = hull.triangles;
+    m_hull.m_adjacencyStart = hull.adjacencyStart;
+    m_hull.m_adjacency = hull.adjacency;
+    m_hull.BuildSoA();
 }
 
 
-
-
-
-
-
-
 //-------------------------------------------------------------------------------------------------
-//SpherePhysicsShape::SpherePhysicsShape(float radius)
-//    : m_radius(radius)
-//{
-//	CreateIcosahadron(radius, 3, &m_mesh);
-//}
+// analytic convex shapes
+//-------------------------------------------------------------------------------------------------
+static vector3 SafeNormalize(const vector3& dir)
+{
+    // any direction is as good as another for a zero vector, just be consistent about it
+    const float lengthSq = dir.magnitude_sq();
+    return lengthSq > 0.0f ? dir / Math_Sqrt(lengthSq) : Coordinates::GetUp();
+}
 //-------------------------------------------------------------------------------------------------
-//vector3 SpherePhysicsShape::GetPointFurthestInDirection(const vector3& dir, const matrix4& world, bool is3D) const
-//{
-//    // This should work...
-//    // one of the strengths of GJK is that you should be able to describe shapes very precisely
-//    // as long as you can answer the question "get the point furthest in this direction" for a shape.
-//    // We should be able to perfectly represent the sphere, rather than the approximation we'd 
-//    // have with the mesh.
-//    // 
-//    // TODO: uncomment and test
-//    // 
-//    //vector3 dir_normalized = dir.normalize();
-//    //
-//    //return world * dir_normalized * m_radius;
-//
-//    return PhysicsShape::GetPointFurthestInDirection(dir, world, is3D);
-//}
+void ConvexPhysicsShape::Draw(const matrix4& t, const DrawParams* params) const
+{
+    DrawMesh(m_renderMesh, t, params);
+}
 //-------------------------------------------------------------------------------------------------
-//BoxPhysicsShape::BoxPhysicsShape(float width, float depth, float height)
-//{
-//    CreateBox(height, width, depth, m_mesh);
-//}
\ No newline at end of file
+vector3 ConvexPhysicsShape::GetPointFurthestInDirection(const vector3& dir, const matrix4& world, bool is3D, int* inOutHint) const
+{
+    // same trick as the meshes: rotate the direction into local space, transform the answer back out
+    const vector3 localDir = world.rotation_get().transpose_get() * dir;
+    if (inOutHint)
+    {
+        *inOutHint = -1; // no features to warm-start from
+    }
+    return world * GetLocalPointFurthestInDirection(localDir);
+}
+//-------------------------------------------------------------------------------------------------
+void ConvexPhysicsShape::BuildRenderMesh()
+{
+    CreateIcosahadron(1.0f, 3, &m_renderMesh);
+    for (int i = 0; i < m_renderMesh.m_vertexPos.size(); i++)
+    {
+        const vector3 dir = m_renderMesh.m_vertexPos[i];
+        m_renderMesh.m_vertexPos[i] = GetLocalPointFurthestInDirection(dir);
+        m_renderMesh.m_vertexNormals[i] = dir;
+    }
+}
+//-------------------------------------------------------------------------------------------------
+SpherePhysicsShape::SpherePhysicsShape(float radius)
+    : m_radius(radius)
+{
+    BuildRenderMesh();
+}
+//-------------------------------------------------------------------------------------------------
+vector3 SpherePhysicsShape::GetLocalPointFurthestInDirection(const vector3& dir) const
+{
+    // one of the strengths of GJK is that you should be able to describe shapes very precisely
+    // as long as you can answer the question "get the point furthest in this direction" for a shape.
+    return SafeNormalize(dir) * m_radius;
+}
+//-------------------------------------------------------------------------------------------------
+float SpherePhysicsShape::GetBoundingRadius() const
+{
+    return m_radius;
+}
+//-------------------------------------------------------------------------------------------------
+BoxPhysicsShape::BoxPhysicsShape(float width, float depth, float height)
+    : m_halfExtents(width / 2.0f, height / 2.0f, depth / 2.0f)
+{
+    // sampling the support function would only give us the corners, build the faces directly
+    CreateBoxMesh(width, depth, height, m_renderMesh);
+}
+//-------------------------------------------------------------------------------------------------
+vector3 BoxPhysicsShape::GetLocalPointFurthestInDirection(const vector3& dir) const
+{
+    return vector3(dir.x >= 0.0f ? m_halfExtents.x : -m_halfExtents.x,
+                   dir.y >= 0.0f ? m_halfExtents.y : -m_halfExtents.y,
+                   dir.z >= 0.0f ? m_halfExtents.z : -m_halfExtents.z);
+}
+//-------------------------------------------------------------------------------------------------
+float BoxPhysicsShape::GetBoundingRadius() const
+{
+    return m_halfExtents.magnitude();
+}
+//-------------------------------------------------------------------------------------------------
+CapsulePhysicsShape::CapsulePhysicsShape(float radius, float height)
+    : m_radius(radius)
+    , m_halfHeight(height / 2.0f)
+{
+    BuildRenderMesh();
+}
+//-------------------------------------------------------------------------------------------------
+vector3 CapsulePhysicsShape::GetLocalPointFurthestInDirection(const vector3& dir) const
+{
+    // furthest end of the segment, pushed out by the radius
+    const vector3 end = Coordinates::GetUp() * (dir.y >= 0.0f ? m_halfHeight : -m_halfHeight);
+    return end + SafeNormalize(dir) * m_radius;
+}
+//-------------------------------------------------------------------------------------------------
+float CapsulePhysicsShape::GetBoundingRadius() const
+{
+    return m_halfHeight + m_radius;
+}
+//-------------------------------------------------------------------------------------------------
+CylinderPhysicsShape::CylinderPhysicsShape(float radius, float height)
+    : m_radius(radius)
+    , m_halfHeight(height / 2.0f)
+{
+    BuildRenderMesh();
+}
+//-------------------------------------------------------------------------------------------------
+vector3 CylinderPhysicsShape::GetLocalPointFurthestInDirection(const vector3& dir) const
+{
+    // furthest point on the rim of the furthest cap
+    vector3 result;
+    const float radialLengthSq = dir.x * dir.x + dir.z * dir.z;
+    if (radialLengthSq > 0.0f)
+    {
+        const float scale = m_radius / Math_Sqrt(radialLengthSq);
+        result.x = dir.x * scale;
+        result.z = dir.z * scale;
+    }
+    result.y = dir.y >= 0.0f ? m_halfHeight : -m_halfHeight;
+    return result;
+}
+//-------------------------------------------------------------------------------------------------
+float CylinderPhysicsShape::GetBoundingRadius() const
+{
+    // rim of a cap
+    return Math_Sqrt(m_radius * m_radius + m_halfHeight * m_halfHeight);
+}
+//-------------------------------------------------------------------------------------------------
+RoundedPhysicsShape::RoundedPhysicsShape(const PhysicsShape* core, float radius)
+    : m_core(core)
+    , m_radius(radius)
+{
+    BuildRenderMesh();
+}
+//-------------------------------------------------------------------------------------------------
+vector3 RoundedPhysicsShape::GetLocalPointFurthestInDirection(const vector3& dir) const
+{
+    // support of a Minkowski sum is the sum of the supports
+    return m_core->GetPointFurthestInDirection(dir, matrix4(), true) + SafeNormalize(dir) * m_radius;
+}
+//-------------------------------------------------------------------------------------------------
+float RoundedPhysicsShape::GetBoundingRadius() const
+{
+    return m_core->GetBoundingRadius() + m_radius;
+}
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "vector.h"
+#include "aabb.h"
 
 #include <vector>
+#include <unordered_map>
+#include <cstdint>
 
 //******************************************************************************
 // Vertex - A single point
@@ -19,15 +22,62 @@ struct vertex
 //******************************************************************************
 // Mesh - arbitrary vertex list
 //******************************************************************************
+static constexpr int   MESH_SOA_LANES = 8; // widest SIMD kernel (AVX2) processes 8 vertices at a time
+static constexpr float MESH_WELD_EPSILON = KINDA_CLOSE_ENOUGH; // a reasonable SetWeldEpsilon for meshes around unit size
+
 class Mesh
 {
 public:
+    // Reuses an existing vertex if one is exactly at pos (or within the weld epsilon of it on every axis,
+    // once one has been set), keeping its normal, otherwise adds a new one.  Either way its index goes on
+    // the end of m_indices.
     void AddVertex(const vector3& pos, const vector3& normal);
     void AddTriangle(const vector3& a, const vector3& b, const vector3& c, const vector3& n);
+
+    // Bulk building: reserve room up front, then append whole indexed triangle lists.  Each of the
+    // numVertices source vertices is welded once, then indices (into positions/normals) are remapped.
+    void Reserve(int numVertices, int numIndices);
+    void AppendTriangles(const vector3* positions, const vector3* normals, int numVertices, const unsigned int* indices, int numIndices);
+    // 0 (the default) only welds exact duplicates.  Set before adding anything
+    void SetWeldEpsilon(float epsilon);
+
+    // Builds the vertex adjacency from the triangles in m_indices so support queries can hill-climb.
+    // Leaves the adjacency empty if the mesh isn't a closed convex triangle list (hill-climbing
+    // would get stuck in a local maximum), in which case callers should brute force every vertex.
+    void BuildAdjacency();
+    bool HasAdjacency() const { return !m_adjacency.empty(); }
+
+    // Builds the structure-of-arrays copy of m_vertexPos used by the SIMD support scan
+    void BuildSoA();
+    bool HasSoA() const { return !m_vertexSoA.empty(); }
 public: 
 	std::vector<vector3> m_vertexPos;      //
     std::vector<vector3> m_vertexNormals;  // should be same size as vertexPos
     std::vector<unsigned int>     m_indices;        // index into above arrays for each point
+
+    // neighbours of vertex i are m_adjacency[m_adjacencyStart[i]] to m_adjacency[m_adjacencyStart[i+1]-1]
+    std::vector<unsigned int>     m_adjacencyStart;
+    std::vector<unsigned int>     m_adjacency;
+
+    // all the x's, then all the y's, then all the z's.  Each run is m_soaStride long: the vertex count
+    // padded up to MESH_SOA_LANES with copies of the first vertex (so padding never wins a support query)
+    std::vector<float, AlignedAllocator<float, 32>> m_vertexSoA;
+    int m_soaStride = 0;
+
+private:
+    int  FindOrAddVertex(const vector3& pos, const vector3& normal); // SyncWeldGrid first
+    void SyncWeldGrid();
+    void AddToWeldGrid(int vertex);
+    static constexpr float WELD_MIN_CELL_SIZE = 0.000001f; // for exact matching, any size would do
+
+    // vertices hashed by which cell of a grid (4 weld epsilons wide) they're in, each cell's vertices
+    // chained through m_weldNext.  m_weldPos is what the grid was built from: anything added straight
+    // to m_vertexPos is caught up with, and if any of it has been changed or removed the grid starts again
+    float                        m_weldEpsilon = 0.0f;
+    float                        m_weldInvCellSize = 1.0f / WELD_MIN_CELL_SIZE;
+    std::unordered_map<uint64_t, int> m_weldCells;
+    std::vector<int>             m_weldNext;
+    std::vector<vector3>         m_weldPos;
 };
 
 //******************************************************************************
@@ -56,7 +106,13 @@ class PhysicsShape
 public:
     virtual void Draw(const class matrix4& transform, const DrawParams* params = nullptr) const {};
     // Support: Get further point in this shape in the direction specified (using the transform to world space specified)
-    virtual vector3 GetPointFurthestInDirection(const vector3& dir, const matrix4& world, bool is3D) const = 0;
+    //  - inOutHint: optional, on input a feature index to start searching from (-1 if unknown), on output the
+    //               index of the feature returned.  Lets callers warm-start the search from their last answer.
+    virtual vector3 GetPointFurthestInDirection(const vector3& dir, const matrix4& world, bool is3D, int* inOutHint = nullptr) const = 0;
+    // Distance from the shape's origin to its furthest point, bounds how fast any point on it moves when it spins
+    virtual float GetBoundingRadius() const = 0;
+    // World space bounds, from the support in each axis direction (so exact for any convex shape)
+    aabb GetAABB(const matrix4& world) const;
 };
 //******************************************************************************
 class MeshPhysicsShape : public PhysicsShape
@@ -64,30 +120,94 @@ class MeshPhysicsShape : public PhysicsShape
 public:
 	virtual void Draw(const class matrix4& transform, const DrawParams* params = nullptr) const;
 	// Support: Get further point in this shape in the direction specified (using the transform to world space specified)
-	virtual vector3 GetPointFurthestInDirection(const vector3& dir, const matrix4& world, bool is3D) const;
+	virtual vector3 GetPointFurthestInDirection(const vector3& dir, const matrix4& world, bool is3D, int* inOutHint = nullptr) const;
+    virtual float GetBoundingRadius() const;
 
     // Temporary... eventually will use actual physics shapes describing these rather than meshes
     void CreateSphere(float radius);
     void CreateBox(float width, float depth, float height);
+
+    // Builds the convex hull of m_mesh that the support function uses, call again after changing m_mesh.
+    // Without one (or if the mesh is flat) the support function scans every vertex of m_mesh.
+    void CookHull();
+    const Mesh& GetSupportMesh() const { return m_hull.m_vertexPos.empty() ? m_mesh : m_hull; }
 public:
-	Mesh m_mesh;
+	Mesh m_mesh; // what gets drawn
+private:
+    Mesh m_hull; // only the hull's corners, with their adjacency and SoA copy
 };
 //******************************************************************************
-//class SpherePhysicsShape : public PhysicsShape
-//{
-//public:
-//    SpherePhysicsShape(float radius);
-//    vector3 GetPointFurthestInDirection(const vector3& dir, const matrix4& world, bool is3D) const override;
-//public:
-//    const float m_radius;
-//};
-////******************************************************************************
-//class BoxPhysicsShape : public PhysicsShape
-//{
-//public:
-//    BoxPhysicsShape(float width, float depth, float height);
-//public:
-//    float m_sides[3];
-//};
-
+// ConvexPhysicsShape - base for the analytic shapes
+//   The support function is exact and O(1), so GJK/EPA get real curved surfaces
+//   rather than a tessellation.  Drawn with a mesh built from the support function.
+//******************************************************************************
+class ConvexPhysicsShape : public PhysicsShape
+{
+public:
+    virtual void Draw(const class matrix4& transform, const DrawParams* params = nullptr) const;
+    virtual vector3 GetPointFurthestInDirection(const vector3& dir, const matrix4& world, bool is3D, int* inOutHint = nullptr) const;
 
+    // Support in the shape's own space (dir does not need to be normalized)
+    virtual vector3 GetLocalPointFurthestInDirection(const vector3& dir) const = 0;
+protected:
+    // samples the support function in every direction of an icosphere, call from the derived constructor
+    void BuildRenderMesh();
+    Mesh m_renderMesh;
+};
+//******************************************************************************
+class SpherePhysicsShape : public ConvexPhysicsShape
+{
+public:
+    SpherePhysicsShape(float radius);
+    virtual vector3 GetLocalPointFurthestInDirection(const vector3& dir) const;
+    virtual float GetBoundingRadius() const;
+public:
+    const float m_radius;
+};
+//******************************************************************************
+class BoxPhysicsShape : public ConvexPhysicsShape
+{
+public:
+    BoxPhysicsShape(float width, float depth, float height);
+    virtual vector3 GetLocalPointFurthestInDirection(const vector3& dir) const;
+    virtual float GetBoundingRadius() const;
+public:
+    const vector3 m_halfExtents; // x = width, y = height, z = depth (same as MeshPhysicsShape::CreateBox)
+};
+//******************************************************************************
+// Capsule - a line segment along the local up axis, swept by a sphere
+class CapsulePhysicsShape : public ConvexPhysicsShape
+{
+public:
+    CapsulePhysicsShape(float radius, float height); // height of the straight section, not counting the caps
+    virtual vector3 GetLocalPointFurthestInDirection(const vector3& dir) const;
+    virtual float GetBoundingRadius() const;
+public:
+    const float m_radius;
+    const float m_halfHeight;
+};
+//******************************************************************************
+// Cylinder - flat caps, axis along local up
+class CylinderPhysicsShape : public ConvexPhysicsShape
+{
+public:
+    CylinderPhysicsShape(float radius, float height);
+    virtual vector3 GetLocalPointFurthestInDirection(const vector3& dir) const;
+    virtual float GetBoundingRadius() const;
+public:
+    const float m_radius;
+    const float m_halfHeight;
+};
+//******************************************************************************
+// Rounded - any core shape (in its own space) grown by a radius in every direction,
+//   i.e. a rounded box is a BoxPhysicsShape core with a small radius
+class RoundedPhysicsShape : public ConvexPhysicsShape
+{
+public:
+    RoundedPhysicsShape(const PhysicsShape* core, float radius);
+    virtual vector3 GetLocalPointFurthestInDirection(const vector3& dir) const;
+    virtual float GetBoundingRadius() const;
+public:
+    const PhysicsShape* m_core;
+    const float m_radius;
+};
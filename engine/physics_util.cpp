@@ -1,6 +1,21 @@
 #include "physics_util.h"
 #include "matrix.h"
 #include <algorithm>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PHYSUTIL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#include <cpuid.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define PHYSUTIL_X86 0
+#endif
 
 vector3 PhysUtil_GetPointFurthestInDirection(
 	const std::vector<vector3>& points,
@@ -9,58 +24,945 @@ vector3 PhysUtil_GetPointFurthestInDirection(
 	int* optional_out_index)
 {
 	// get the position furthest in the direction of geo (modified by world)
-	vector3 result;
+	//  dir . (R*p + t) == (transpose(R)*dir) . p + dir . t
+	// so rotate the direction into local space once rather than transforming every point into world
+	// space, the translation is the same for every point so it doesn't change which one is furthest
+	const vector3 local_direction = world.rotation_get().transpose_get() * direction;
+	int best_index = -1;
 	float best_dot_product = -std::numeric_limits<float>::infinity();
 
 	for (int i = 0; i < points.size(); i++)
 	{
-		vector3 world_pos = world * points[i];
-		float dot_product = direction.dot(world_pos);
+		float dot_product = local_direction.dot(points[i]);
 		// what to do if two vertices are equally in the specified direction?
 		// i.e. dot_product == best_dot_product?
 		if (dot_product > best_dot_product)
 		{
 			best_dot_product = dot_product;
-			result = world_pos;
-			if (optional_out_index)
-			{
-				*optional_out_index = i;
-			}
+			best_index = i;
 		}
 	}
 
 	assert(best_dot_product != -std::numeric_limits<float>::infinity());
 
+	if (optional_out_index)
+	{
+		*optional_out_index = best_index;
+	}
+	return world * points[best_index];
+}
+
+//-------------------------------------------------------------------------------------------------
+// SIMD support scan
+//
+// All the kernels compute (x*dx + y*dy) + z*dz in the same order as vector3::dot with separate
+// multiplies and adds (no FMA), and keep the first index of any tie, so they all agree exactly.
+//-------------------------------------------------------------------------------------------------
+static std::atomic<int> s_simdLevel(-1); // -1 until detected, read from the worker threads
+
+static SIMD_LEVEL DetectSimdLevel()
+{
+#if PHYSUTIL_X86
+	int info[4] = {};
+#if defined(_MSC_VER)
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+	__cpuid(info, 1);
+#else
+	const int maxLeaf = (int)__get_cpuid_max(0, nullptr);
+	__cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+	const bool sse2 = (info[3] & (1 << 26)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!sse2)
+	{
+		return SIMD_LEVEL_SCALAR;
+	}
+	if (!osxsave || !avx || maxLeaf < 7)
+	{
+		return SIMD_LEVEL_SSE;
+	}
+
+	// the OS has to save the ymm registers too or we can't use them
+#if defined(_MSC_VER)
+	const unsigned long long xcr0 = _xgetbv(0);
+#else
+	unsigned int xcr0_lo, xcr0_hi;
+	__asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+	const unsigned long long xcr0 = ((unsigned long long)xcr0_hi << 32) | xcr0_lo;
+#endif
+	if ((xcr0 & 0x6) != 0x6)
+	{
+		return SIMD_LEVEL_SSE;
+	}
+
+#if defined(_MSC_VER)
+	__cpuidex(info, 7, 0);
+#else
+	__cpuid_count(7, 0, info[0], info[1], info[2], info[3]);
+#endif
+	const bool avx2 = (info[1] & (1 << 5)) != 0;
+	return avx2 ? SIMD_LEVEL_AVX2 : SIMD_LEVEL_SSE;
+#else
+	return SIMD_LEVEL_SCALAR;
+#endif
+}
+
+SIMD_LEVEL PhysUtil_GetSupportedSimdLevel()
+{
+	static const SIMD_LEVEL s_supported = DetectSimdLevel();
+	return s_supported;
+}
+
+SIMD_LEVEL PhysUtil_GetSimdLevel()
+{
+	int level = s_simdLevel.load(std::memory_order_relaxed);
+	if (level == -1)
+	{
+		// only replaces the -1, so it can't undo a PhysUtil_SetSimdLevel racing with it
+		int expected = -1;
+		s_simdLevel.compare_exchange_strong(expected, PhysUtil_GetSupportedSimdLevel(), std::memory_order_relaxed);
+		level = s_simdLevel.load(std::memory_order_relaxed);
+	}
+	return (SIMD_LEVEL)level;
+}
+
+void PhysUtil_SetSimdLevel(SIMD_LEVEL level)
+{
+	s_simdLevel.store(min(level, PhysUtil_GetSupportedSimdLevel()), std::memory_order_relaxed);
+}
+
+static int GetIndexFurthestInDirectionScalar(const float* x, const float* y, const float* z, int count, const vector3& d)
+{
+	int best_index = 0;
+	float best_dot_product = -std::numeric_limits<float>::infinity();
+	for (int i = 0; i < count; i++)
+	{
+		const float dot_product = x[i] * d.x + y[i] * d.y + z[i] * d.z;
+		if (dot_product > best_dot_product)
+		{
+			best_dot_product = dot_product;
+			best_index = i;
+		}
+	}
+	return best_index;
+}
+
+// each lane kept the first of its own ties, so across lanes the lowest index wins a tie
+static int ReduceLanes(const float* best, const int* best_index, int lanes)
+{
+	float best_dot_product = best[0];
+	int result = best_index[0];
+	for (int i = 1; i < lanes; i++)
+	{
+		if (best[i] > best_dot_product || (best[i] == best_dot_product && best_index[i] < result))
+		{
+			best_dot_product = best[i];
+			result = best_index[i];
+		}
+	}
 	return result;
 }
 
-static int GetPointFurthestInNormal(
+#if PHYSUTIL_X86
+static int GetIndexFurthestInDirectionSSE(const float* x, const float* y, const float* z, int count, const vector3& d)
+{
+	const __m128 dx = _mm_set1_ps(d.x);
+	const __m128 dy = _mm_set1_ps(d.y);
+	const __m128 dz = _mm_set1_ps(d.z);
+	const __m128i step = _mm_set1_epi32(4);
+	__m128 best = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+	__m128i best_index = _mm_setzero_si128();
+	__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+	for (int i = 0; i < count; i += 4)
+	{
+		const __m128 dot_product = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(x + i), dx), _mm_mul_ps(_mm_load_ps(y + i), dy)), _mm_mul_ps(_mm_load_ps(z + i), dz));
+		const __m128 greater = _mm_cmpgt_ps(dot_product, best);
+		best = _mm_or_ps(_mm_and_ps(greater, dot_product), _mm_andnot_ps(greater, best));
+		const __m128i greater_i = _mm_castps_si128(greater);
+		best_index = _mm_or_si128(_mm_and_si128(greater_i, index), _mm_andnot_si128(greater_i, best_index));
+		index = _mm_add_epi32(index, step);
+	}
+
+	alignas(16) float lane_best[4];
+	alignas(16) int lane_index[4];
+	_mm_store_ps(lane_best, best);
+	_mm_store_si128((__m128i*)lane_index, best_index);
+	return ReduceLanes(lane_best, lane_index, 4);
+}
+
+TARGET_AVX2 static int GetIndexFurthestInDirectionAVX2(const float* x, const float* y, const float* z, int count, const vector3& d)
+{
+	const __m256 dx = _mm256_set1_ps(d.x);
+	const __m256 dy = _mm256_set1_ps(d.y);
+	const __m256 dz = _mm256_set1_ps(d.z);
+	const __m256i step = _mm256_set1_epi32(8);
+	__m256 best = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+	__m256i best_index = _mm256_setzero_si256();
+	__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	for (int i = 0; i < count; i += 8)
+	{
+		const __m256 dot_product = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(x + i), dx), _mm256_mul_ps(_mm256_load_ps(y + i), dy)), _mm256_mul_ps(_mm256_load_ps(z + i), dz));
+		const __m256 greater = _mm256_cmp_ps(dot_product, best, _CMP_GT_OQ);
+		best = _mm256_blendv_ps(best, dot_product, greater);
+		best_index = _mm256_blendv_epi8(best_index, index, _mm256_castps_si256(greater));
+		index = _mm256_add_epi32(index, step);
+	}
+
+	alignas(32) float lane_best[8];
+	alignas(32) int lane_index[8];
+	_mm256_store_ps(lane_best, best);
+	_mm256_store_si256((__m256i*)lane_index, best_index);
+	return ReduceLanes(lane_best, lane_index, 8);
+}
+#endif
+
+int PhysUtil_GetIndexFurthestInDirectionSoA(
+	const float* x, const float* y, const float* z, int count,
+	const vector3& direction)
+{
+	assert(count > 0 && (count % MESH_SOA_LANES) == 0);
+	switch (PhysUtil_GetSimdLevel())
+	{
+#if PHYSUTIL_X86
+		case SIMD_LEVEL_AVX2: return GetIndexFurthestInDirectionAVX2(x, y, z, count, direction);
+		case SIMD_LEVEL_SSE:  return GetIndexFurthestInDirectionSSE(x, y, z, count, direction);
+#endif
+		default: break;
+	}
+	return GetIndexFurthestInDirectionScalar(x, y, z, count, direction);
+}
+
+vector3 PhysUtil_GetPointFurthestInDirection(
+	const Mesh& mesh,
+	const vector3& direction,
+	const matrix4& world,
+	int* optional_out_index)
+{
+	if (!mesh.HasSoA())
+	{
+		return PhysUtil_GetPointFurthestInDirection(mesh.m_vertexPos, direction, world, optional_out_index);
+	}
+
+	const vector3 local_direction = world.rotation_get().transpose_get() * direction;
+	const float* x = &mesh.m_vertexSoA[0];
+	const float* y = x + mesh.m_soaStride;
+	const float* z = y + mesh.m_soaStride;
+	const int best_index = PhysUtil_GetIndexFurthestInDirectionSoA(x, y, z, mesh.m_soaStride, local_direction);
+	assert(best_index < (int)mesh.m_vertexPos.size()); // padding copies vertex 0, it can never win a tie against it
+
+	if (optional_out_index)
+	{
+		*optional_out_index = best_index;
+	}
+	return world * mesh.m_vertexPos[best_index];
+}
+
+vector3 PhysUtil_GetPointFurthestInDirectionHillClimb(
 	const std::vector<vector3>& points,
-	const vector3& center,
-	const vector3& a, const vector3& b, const vector3& c)
+	const std::vector<unsigned int>& adjacencyStart,
+	const std::vector<unsigned int>& adjacency,
+	const vector3& direction,
+	const matrix4& world,
+	int* inOutIndex)
 {
-	const vector3 ab = (b-a);
-	const vector3 ac = (c-a);
-	vector3 n = ab.cross(ac);
-	const vector3 a_center = (center - a);
-	if (a_center.dot(n) > 0.0f)
+	assert(inOutIndex);
+	assert(adjacencyStart.size() == points.size() + 1);
+
+	// start from the hint if we have a valid one, otherwise any vertex will do
+	int current = *inOutIndex;
+	if (current < 0 || current >= (int)points.size())
 	{
-		n = -n;
+		current = 0;
 	}
 
-	int bestIndex = -1;
-	float bestDot = 0.0f;
-	for (int i = 0; i < points.size(); i++)
+	// same as above, work in local space and only transform the answer
+	const vector3 local_direction = world.rotation_get().transpose_get() * direction;
+	float best_dot_product = local_direction.dot(points[current]);
+
+	// steepest ascent: move to the best neighbour until none of them improve.  On a convex
+	// mesh every vertex that isn't the furthest has a neighbour that is strictly further, so
+	// the local maximum we stop at is the global one.
+	bool improved = true;
+	while (improved)
+	{
+		improved = false;
+		const unsigned int start = adjacencyStart[current];
+		const unsigned int end = adjacencyStart[current + 1];
+		int best_neighbour = -1;
+		for (unsigned int i = start; i < end; i++)
+		{
+			const int neighbour = adjacency[i];
+			float dot_product = local_direction.dot(points[neighbour]);
+			if (dot_product > best_dot_product)
+			{
+				best_dot_product = dot_product;
+				best_neighbour = neighbour;
+			}
+		}
+		if (best_neighbour != -1)
+		{
+			current = best_neighbour;
+			improved = true;
+		}
+	}
+
+	*inOutIndex = current;
+	return world * points[current];
+}
+
+//-------------------------------------------------------------------------------------------------
+// Batch integrator
+//
+// Each kernel works the sums out in the same order as the vector3/matrix3 operators (and
+// quaternion::integrate) PhysicsWorld uses for a single body, with separate multiplies and adds (no FMA), so every SIMD level (and the
+// scalar path) ends up with exactly the same bits.  Bodies that are skipped are left exactly as they
+// were, the SIMD kernels work them out anyway and then keep the old value.
+//-------------------------------------------------------------------------------------------------
+static bool IsIntegrated(const PhysUtilBodyArrays& b, int i)
+{
+	return (b.flags[i] & b.skipFlags) == 0 && b.invMass[i] != 0.0f;
+}
+
+static void IntegrateVelocitiesScalar(const PhysUtilBodyArrays& b, float dt, int begin)
+{
+	for (int i = begin; i < b.count; i++)
+	{
+		if (!IsIntegrated(b, i))
+			continue;
+		for (int c = 0; c < 3; c++)
+		{
+			b.linearMomentum[c][i] = b.linearMomentum[c][i] + (b.gravity[c][i] * b.mass[i]) * dt;
+		}
+	}
+}
+
+static void IntegratePositionsScalar(const PhysUtilBodyArrays& b, float dt, int begin)
+{
+	for (int i = begin; i < b.count; i++)
+	{
+		if (!IsIntegrated(b, i))
+			continue;
+		const float ax = b.angularMomentum[0][i];
+		const float ay = b.angularMomentum[1][i];
+		const float az = b.angularMomentum[2][i];
+		float w[3];
+		for (int c = 0; c < 3; c++)
+		{
+			const float v = b.linearMomentum[c][i] * b.invMass[i] + b.pushVelocity[c][i];
+			w[c] = (b.invInertia[c * 3][i] * ax + b.invInertia[c * 3 + 1][i] * ay + b.invInertia[c * 3 + 2][i] * az) + b.pushAngularVelocity[c][i];
+			b.position[c][i] = b.position[c][i] + v * dt;
+		}
+		const quaternion q = quaternion(b.rotation[0][i], b.rotation[1][i], b.rotation[2][i], b.rotation[3][i]).integrate(w[0], w[1], w[2], dt);
+		b.rotation[0][i] = q.x;
+		b.rotation[1][i] = q.y;
+		b.rotation[2][i] = q.z;
+		b.rotation[3][i] = q.w;
+	}
+}
+
+#if PHYSUTIL_X86
+// all ones in the lanes of bodies that get integrated
+static __m128 GetIntegratedMaskSSE(const PhysUtilBodyArrays& b, int i)
+{
+	int flags;
+	memcpy(&flags, b.flags + i, sizeof(flags));
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lanes = _mm_unpacklo_epi8(_mm_cvtsi32_si128(flags), zero);
+	lanes = _mm_unpacklo_epi16(lanes, zero);
+	const __m128i skipped = _mm_and_si128(lanes, _mm_set1_epi32(b.skipFlags));
+	const __m128 notSkipped = _mm_castsi128_ps(_mm_cmpeq_epi32(skipped, zero));
+	return _mm_and_ps(notSkipped, _mm_cmpneq_ps(_mm_load_ps(b.invMass + i), _mm_setzero_ps()));
+}
+static __m128 SelectSSE(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static int IntegrateVelocitiesSSE(const PhysUtilBodyArrays& b, float dt)
+{
+	const __m128 vdt = _mm_set1_ps(dt);
+	const int end = b.count & ~3;
+	for (int i = 0; i < end; i += 4)
+	{
+		const __m128 mask = GetIntegratedMaskSSE(b, i);
+		const __m128 mass = _mm_load_ps(b.mass + i);
+		for (int c = 0; c < 3; c++)
+		{
+			const __m128 p = _mm_load_ps(b.linearMomentum[c] + i);
+			const __m128 integrated = _mm_add_ps(p, _mm_mul_ps(_mm_mul_ps(_mm_load_ps(b.gravity[c] + i), mass), vdt));
+			_mm_store_ps(b.linearMomentum[c] + i, SelectSSE(mask, integrated, p));
+		}
+	}
+	return end;
+}
+
+static int IntegratePositionsSSE(const PhysUtilBodyArrays& b, float dt)
+{
+	const __m128 vdt = _mm_set1_ps(dt);
+	const __m128 h = _mm_set1_ps(0.5f * dt);
+	const int end = b.count & ~3;
+	for (int i = 0; i < end; i += 4)
+	{
+		const __m128 mask = GetIntegratedMaskSSE(b, i);
+		const __m128 invMass = _mm_load_ps(b.invMass + i);
+		const __m128 ax = _mm_load_ps(b.angularMomentum[0] + i);
+		const __m128 ay = _mm_load_ps(b.angularMomentum[1] + i);
+		const __m128 az = _mm_load_ps(b.angularMomentum[2] + i);
+		__m128 w[3];
+		for (int c = 0; c < 3; c++)
+		{
+			const __m128 v = _mm_add_ps(_mm_mul_ps(_mm_load_ps(b.linearMomentum[c] + i), invMass), _mm_load_ps(b.pushVelocity[c] + i));
+			const __m128 iw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(b.invInertia[c * 3] + i), ax), _mm_mul_ps(_mm_load_ps(b.invInertia[c * 3 + 1] + i), ay)), _mm_mul_ps(_mm_load_ps(b.invInertia[c * 3 + 2] + i), az));
+			w[c] = _mm_add_ps(iw, _mm_load_ps(b.pushAngularVelocity[c] + i));
+			const __m128 p = _mm_load_ps(b.position[c] + i);
+			_mm_store_ps(b.position[c] + i, SelectSSE(mask, _mm_add_ps(p, _mm_mul_ps(v, vdt)), p));
+		}
+
+		// quaternion::integrate
+		const __m128 qx = _mm_load_ps(b.rotation[0] + i);
+		const __m128 qy = _mm_load_ps(b.rotation[1] + i);
+		const __m128 qz = _mm_load_ps(b.rotation[2] + i);
+		const __m128 qw = _mm_load_ps(b.rotation[3] + i);
+		const __m128 nx = _mm_add_ps(qx, _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(w[0], qw), _mm_mul_ps(w[1], qz)), _mm_mul_ps(w[2], qy)), h));
+		const __m128 ny = _mm_add_ps(qy, _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(w[1], qw), _mm_mul_ps(w[2], qx)), _mm_mul_ps(w[0], qz)), h));
+		const __m128 nz = _mm_add_ps(qz, _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(w[2], qw), _mm_mul_ps(w[0], qy)), _mm_mul_ps(w[1], qx)), h));
+		const __m128 nw = _mm_sub_ps(qw, _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w[0], qx), _mm_mul_ps(w[1], qy)), _mm_mul_ps(w[2], qz)), h));
+		const __m128 m = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)), _mm_mul_ps(nw, nw)));
+		_mm_store_ps(b.rotation[0] + i, SelectSSE(mask, _mm_div_ps(nx, m), qx));
+		_mm_store_ps(b.rotation[1] + i, SelectSSE(mask, _mm_div_ps(ny, m), qy));
+		_mm_store_ps(b.rotation[2] + i, SelectSSE(mask, _mm_div_ps(nz, m), qz));
+		_mm_store_ps(b.rotation[3] + i, SelectSSE(mask, _mm_div_ps(nw, m), qw));
+	}
+	return end;
+}
+
+TARGET_AVX2 static __m256 GetIntegratedMaskAVX2(const PhysUtilBodyArrays& b, int i)
+{
+	const __m256i lanes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(b.flags + i)));
+	const __m256i skipped = _mm256_and_si256(lanes, _mm256_set1_epi32(b.skipFlags));
+	const __m256 notSkipped = _mm256_castsi256_ps(_mm256_cmpeq_epi32(skipped, _mm256_setzero_si256()));
+	return _mm256_and_ps(notSkipped, _mm256_cmp_ps(_mm256_load_ps(b.invMass + i), _mm256_setzero_ps(), _CMP_NEQ_UQ));
+}
+
+TARGET_AVX2 static int IntegrateVelocitiesAVX2(const PhysUtilBodyArrays& b, float dt)
+{
+	const __m256 vdt = _mm256_set1_ps(dt);
+	const int end = b.count & ~7;
+	for (int i = 0; i < end; i += 8)
+	{
+		const __m256 mask = GetIntegratedMaskAVX2(b, i);
+		const __m256 mass = _mm256_load_ps(b.mass + i);
+		for (int c = 0; c < 3; c++)
+		{
+			const __m256 p = _mm256_load_ps(b.linearMomentum[c] + i);
+			const __m256 integrated = _mm256_add_ps(p, _mm256_mul_ps(_mm256_mul_ps(_mm256_load_ps(b.gravity[c] + i), mass), vdt));
+			_mm256_store_ps(b.linearMomentum[c] + i, _mm256_blendv_ps(p, integrated, mask));
+		}
+	}
+	return end;
+}
+
+TARGET_AVX2 static int IntegratePositionsAVX2(const PhysUtilBodyArrays& b, float dt)
+{
+	const __m256 vdt = _mm256_set1_ps(dt);
+	const __m256 h = _mm256_set1_ps(0.5f * dt);
+	const int end = b.count & ~7;
+	for (int i = 0; i < end; i += 8)
+	{
+		const __m256 mask = GetIntegratedMaskAVX2(b, i);
+		const __m256 invMass = _mm256_load_ps(b.invMass + i);
+		const __m256 ax = _mm256_load_ps(b.angularMomentum[0] + i);
+		const __m256 ay = _mm256_load_ps(b.angularMomentum[1] + i);
+		const __m256 az = _mm256_load_ps(b.angularMomentum[2] + i);
+		__m256 w[3];
+		for (int c = 0; c < 3; c++)
+		{
+			const __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(b.linearMomentum[c] + i), invMass), _mm256_load_ps(b.pushVelocity[c] + i));
+			const __m256 iw = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(b.invInertia[c * 3] + i), ax), _mm256_mul_ps(_mm256_load_ps(b.invInertia[c * 3 + 1] + i), ay)), _mm256_mul_ps(_mm256_load_ps(b.invInertia[c * 3 + 2] + i), az));
+			w[c] = _mm256_add_ps(iw, _mm256_load_ps(b.pushAngularVelocity[c] + i));
+			const __m256 p = _mm256_load_ps(b.position[c] + i);
+			_mm256_store_ps(b.position[c] + i, _mm256_blendv_ps(p, _mm256_add_ps(p, _mm256_mul_ps(v, vdt)), mask));
+		}
+
+		// quaternion::integrate
+		const __m256 qx = _mm256_load_ps(b.rotation[0] + i);
+		const __m256 qy = _mm256_load_ps(b.rotation[1] + i);
+		const __m256 qz = _mm256_load_ps(b.rotation[2] + i);
+		const __m256 qw = _mm256_load_ps(b.rotation[3] + i);
+		const __m256 nx = _mm256_add_ps(qx, _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(w[0], qw), _mm256_mul_ps(w[1], qz)), _mm256_mul_ps(w[2], qy)), h));
+		const __m256 ny = _mm256_add_ps(qy, _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(w[1], qw), _mm256_mul_ps(w[2], qx)), _mm256_mul_ps(w[0], qz)), h));
+		const __m256 nz = _mm256_add_ps(qz, _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(w[2], qw), _mm256_mul_ps(w[0], qy)), _mm256_mul_ps(w[1], qx)), h));
+		const __m256 nw = _mm256_sub_ps(qw, _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w[0], qx), _mm256_mul_ps(w[1], qy)), _mm256_mul_ps(w[2], qz)), h));
+		const __m256 m = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)), _mm256_mul_ps(nw, nw)));
+		_mm256_store_ps(b.rotation[0] + i, _mm256_blendv_ps(qx, _mm256_div_ps(nx, m), mask));
+		_mm256_store_ps(b.rotation[1] + i, _mm256_blendv_ps(qy, _mm256_div_ps(ny, m), mask));
+		_mm256_store_ps(b.rotation[2] + i, _mm256_blendv_ps(qz, _mm256_div_ps(nz, m), mask));
+		_mm256_store_ps(b.rotation[3] + i, _mm256_blendv_ps(qw, _mm256_div_ps(nw, m), mask));
+	}
+	return end;
+}
+#endif
+
+void PhysUtil_IntegrateVelocities(const PhysUtilBodyArrays& bodies, float dt)
+{
+	// the widest kernel does whole groups of bodies, the scalar one does what's left over
+	int done = 0;
+	switch (PhysUtil_GetSimdLevel())
+	{
+#if PHYSUTIL_X86
+		case SIMD_LEVEL_AVX2: done = IntegrateVelocitiesAVX2(bodies, dt); break;
+		case SIMD_LEVEL_SSE:  done = IntegrateVelocitiesSSE(bodies, dt); break;
+#endif
+		default: break;
+	}
+	IntegrateVelocitiesScalar(bodies, dt, done);
+}
+
+void PhysUtil_IntegratePositions(const PhysUtilBodyArrays& bodies, float dt)
+{
+	int done = 0;
+	switch (PhysUtil_GetSimdLevel())
+	{
+#if PHYSUTIL_X86
+		case SIMD_LEVEL_AVX2: done = IntegratePositionsAVX2(bodies, dt); break;
+		case SIMD_LEVEL_SSE:  done = IntegratePositionsSSE(bodies, dt); break;
+#endif
+		default: break;
+	}
+	IntegratePositionsScalar(bodies, dt, done);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Quickhull (Barber, Dobkin and Huhdanpaa)
+//
+// Start from a tetrahedron of extreme points, give every other point to a face it is in front of,
+// then repeatedly take the furthest point in front of some face, delete every face it can see and
+// fan new faces from it to the edge of that hole (the horizon).  Points left in front of nothing
+// are inside.  Afterwards, neighbouring triangles on the same plane are merged into polygons.
+//-------------------------------------------------------------------------------------------------
+struct QuickhullFace
+{
+	int              v[3];
+	int              adj[3];    // face across the edge v[i] -> v[(i + 1) % 3]
+	vector3          normal;
+	float            distance;
+	std::vector<int> outside;   // points in front of this face and nothing before it
+	bool             deleted = false;
+	int              visited = -1;
+};
+
+static void SetQuickhullPlane(const std::vector<vector3>& points, QuickhullFace* face)
+{
+	const vector3& a = points[face->v[0]];
+	const vector3 n = (points[face->v[1]] - a).cross(points[face->v[2]] - a);
+	const float length = n.magnitude();
+	face->normal = length > 0.0f ? n / length : vector3();
+	face->distance = face->normal.dot(a);
+}
+
+// Hands each point to the first face it is in front of, drops it if there isn't one
+static void AssignQuickhullPoints(const std::vector<vector3>& points, const std::vector<int>& candidates,
+	std::vector<QuickhullFace>& faces, int firstFace, float epsilon)
+{
+	for (int p : candidates)
+	{
+		for (int f = firstFace; f < (int)faces.size(); f++)
+		{
+			if (faces[f].normal.dot(points[p]) - faces[f].distance > epsilon)
+			{
+				faces[f].outside.push_back(p);
+				break;
+			}
+		}
+	}
+}
+
+bool PhysUtil_BuildConvexHull(const std::vector<vector3>& points, ConvexHull* outHull)
+{
+	*outHull = ConvexHull();
+	const int numPoints = (int)points.size();
+	if (numPoints < 4)
+	{
+		return false;
+	}
+
+	// how far off a plane still counts as on it, from the rounding error of the input's size (as qhull does)
+	vector3 extent;
+	int extremes[6] = { 0, 0, 0, 0, 0, 0 }; // min x, max x, min y, ...
+	for (int i = 0; i < numPoints; i++)
+	{
+		const vector3& p = points[i];
+		extent = vector3(max(extent.x, fabsf(p.x)), max(extent.y, fabsf(p.y)), max(extent.z, fabsf(p.z)));
+		if (p.x < points[extremes[0]].x) extremes[0] = i;
+		if (p.x > points[extremes[1]].x) extremes[1] = i;
+		if (p.y < points[extremes[2]].y) extremes[2] = i;
+		if (p.y > points[extremes[3]].y) extremes[3] = i;
+		if (p.z < points[extremes[4]].z) extremes[4] = i;
+		if (p.z > points[extremes[5]].z) extremes[5] = i;
+	}
+	const float epsilon = 3.0f * FLT_EPSILON * (extent.x + extent.y + extent.z);
+
+	// the starting tetrahedron: the two extremes furthest apart, the point furthest from the line
+	// through them, then the point furthest from the plane through all three
+	int v0 = extremes[0];
+	int v1 = extremes[1];
+	for (int i = 0; i < 6; i += 2)
+	{
+		if ((points[extremes[i + 1]] - points[extremes[i]]).magnitude_sq() > (points[v1] - points[v0]).magnitude_sq())
+		{
+			v0 = extremes[i];
+			v1 = extremes[i + 1];
+		}
+	}
+	const vector3 line = points[v1] - points[v0];
+	int v2 = -1;
+	float best = 0.0f;
+	for (int i = 0; i < numPoints; i++)
+	{
+		const float d = line.cross(points[i] - points[v0]).magnitude_sq();
+		if (d > best)
+		{
+			best = d;
+			v2 = i;
+		}
+	}
+	if (v2 < 0 || Math_Sqrt(best) <= epsilon * line.magnitude())
+	{
+		return false; // all on a line
+	}
+	const vector3 planeNormal = line.cross(points[v2] - points[v0]).normalize();
+	int v3 = -1;
+	best = 0.0f;
+	for (int i = 0; i < numPoints; i++)
+	{
+		const float d = fabsf(planeNormal.dot(points[i] - points[v0]));
+		if (d > best)
+		{
+			best = d;
+			v3 = i;
+		}
+	}
+	if (v3 < 0 || best <= epsilon)
+	{
+		return false; // all on a plane
+	}
+	if (planeNormal.dot(points[v3] - points[v0]) > 0.0f)
+	{
+		const int t = v1;
+		v1 = v2;
+		v2 = t;
+	}
+
+	// v0 v1 v2 faces away from v3, the sides share its edges the other way round
+	std::vector<QuickhullFace> faces(4);
+	const int initial[4][3] = { { v0, v1, v2 }, { v1, v0, v3 }, { v2, v1, v3 }, { v0, v2, v3 } };
+	for (int f = 0; f < 4; f++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			faces[f].v[i] = initial[f][i];
+		}
+		SetQuickhullPlane(points, &faces[f]);
+	}
+	for (int f = 0; f < 4; f++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			const int a = faces[f].v[i];
+			const int b = faces[f].v[(i + 1) % 3];
+			for (int g = 0; g < 4; g++)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					if (faces[g].v[j] == b && faces[g].v[(j + 1) % 3] == a)
+					{
+						faces[f].adj[i] = g;
+					}
+				}
+			}
+		}
+	}
+	std::vector<int> candidates;
+	candidates.reserve(numPoints);
+	for (int i = 0; i < numPoints; i++)
+	{
+		if (i != v0 && i != v1 && i != v2 && i != v3)
+		{
+			candidates.push_back(i);
+		}
+	}
+	AssignQuickhullPoints(points, candidates, faces, 0, epsilon);
+
+	struct HorizonEdge
+	{
+		int a;
+		int b;
+		int face; // the face on the far side, staying on the hull
+	};
+	std::vector<int> visible;
+	std::vector<int> stack;
+	std::vector<HorizonEdge> horizon;
+	std::vector<std::pair<int, int>> newByStart; // first vertex of each new face -> face
+	int iteration = 0;
+	for (int current = 0; current < (int)faces.size(); current++)
+	{
+		// new faces only ever go on the end, so one pass picks up all the work
+		while (!faces[current].deleted && !faces[current].outside.empty())
+		{
+			const QuickhullFace& face = faces[current];
+			int eye = face.outside[0];
+			float eyeDistance = -FLT_MAX;
+			for (int p : face.outside)
+			{
+				const float d = face.normal.dot(points[p]) - face.distance;
+				if (d > eyeDistance)
+				{
+					eyeDistance = d;
+					eye = p;
+				}
+			}
+
+			// flood out from this face to everything the eye can see, the edges where that stops are the horizon
+			visible.clear();
+			horizon.clear();
+			stack.assign(1, current);
+			faces[current].visited = iteration;
+			while (!stack.empty())
+			{
+				const int f = stack.back();
+				stack.pop_back();
+				visible.push_back(f);
+				for (int i = 0; i < 3; i++)
+				{
+					const int n = faces[f].adj[i];
+					if (faces[n].visited == iteration)
+					{
+						continue;
+					}
+					if (faces[n].normal.dot(points[eye]) - faces[n].distance > epsilon)
+					{
+						faces[n].visited = iteration;
+						stack.push_back(n);
+					}
+					else
+					{
+						horizon.push_back({ faces[f].v[i], faces[f].v[(i + 1) % 3], n });
+					}
+				}
+			}
+			// fan new faces from the eye to the horizon
+			const int firstNew = (int)faces.size();
+			newByStart.clear();
+			for (const HorizonEdge& edge : horizon)
+			{
+				const int f = (int)faces.size();
+				faces.emplace_back();
+				QuickhullFace& added = faces.back();
+				added.v[0] = edge.a;
+				added.v[1] = edge.b;
+				added.v[2] = eye;
+				added.adj[0] = edge.face;
+				SetQuickhullPlane(points, &added);
+				QuickhullFace& other = faces[edge.face];
+				for (int i = 0; i < 3; i++)
+				{
+					if (other.v[i] == edge.b && other.v[(i + 1) % 3] == edge.a)
+					{
+						other.adj[i] = f;
+					}
+				}
+				newByStart.push_back({ edge.a, f });
+			}
+			// the horizon is a loop, so each new face's b -> eye edge meets the new face starting at b
+			std::sort(newByStart.begin(), newByStart.end());
+			for (int f = firstNew; f < (int)faces.size(); f++)
+			{
+				const auto next = std::lower_bound(newByStart.begin(), newByStart.end(), std::make_pair(faces[f].v[1], -1));
+				assert(next != newByStart.end() && next->first == faces[f].v[1]);
+				faces[f].adj[1] = next->second;
+				faces[next->second].adj[2] = f;
+			}
+
+			// whatever the deleted faces could see goes to the new ones, or was swallowed by them
+			candidates.clear();
+			for (int f : visible)
+			{
+				for (int p : faces[f].outside)
+				{
+					if (p != eye)
+					{
+						candidates.push_back(p);
+					}
+				}
+				faces[f].outside.clear();
+				faces[f].outside.shrink_to_fit();
+				faces[f].deleted = true;
+			}
+			AssignQuickhullPoints(points, candidates, faces, firstNew, epsilon);
+			iteration++;
+		}
+	}
+
+	// Merge: grow a group from each face over neighbours whose corners all sit on its plane.  Only within
+	// rounding error, merging anything that's merely close pushes corners out through the merged face.
+	const float mergeTolerance = 2.0f * epsilon;
+	std::vector<int> group(faces.size(), -1);
+	std::vector<int> groupSeeds;
+	for (int seed = 0; seed < (int)faces.size(); seed++)
+	{
+		if (faces[seed].deleted || group[seed] >= 0)
+		{
+			continue;
+		}
+		const int g = (int)groupSeeds.size();
+		groupSeeds.push_back(seed);
+		group[seed] = g;
+		stack.assign(1, seed);
+		while (!stack.empty())
+		{
+			const int f = stack.back();
+			stack.pop_back();
+			for (int i = 0; i < 3; i++)
+			{
+				const int n = faces[f].adj[i];
+				if (group[n] >= 0 || faces[n].normal.dot(faces[seed].normal) <= 0.0f)
+				{
+					continue;
+				}
+				bool onPlane = true;
+				for (int j = 0; j < 3; j++)
+				{
+					onPlane &= fabsf(faces[seed].normal.dot(points[faces[n].v[j]]) - faces[seed].distance) <= mergeTolerance;
+				}
+				if (onPlane)
+				{
+					group[n] = g;
+					stack.push_back(n);
+				}
+			}
+		}
+	}
+
+	// Each group's outline is its edges that border another group, chained into a loop
+	std::vector<int> remap(numPoints, -1);
+	std::vector<int> polygon;
+	std::vector<std::pair<int, int>> outline; // start -> end
+	auto addFace = [&](const std::vector<int>& corners)
+	{
+		ConvexHullFace out;
+		out.firstIndex = (unsigned int)outHull->faceIndices.size();
+		out.numIndices = (unsigned int)corners.size();
+		// Newell's method, a best fit normal for the whole polygon
+		vector3 normal;
+		vector3 centroid;
+		for (size_t i = 0; i < corners.size(); i++)
+		{
+			const vector3& a = points[corners[i]];
+			const vector3& b = points[corners[(i + 1) % corners.size()]];
+			normal = normal + vector3((a.y - b.y) * (a.z + b.z), (a.z - b.z) * (a.x + b.x), (a.x - b.x) * (a.y + b.y));
+			centroid = centroid + a;
+		}
+		out.normal = normal.normalize();
+		out.distance = out.normal.dot(centroid / (float)corners.size());
+		for (int c : corners)
+		{
+			if (remap[c] < 0)
+			{
+				remap[c] = (int)outHull->vertices.size();
+				outHull->vertices.push_back(points[c]);
+			}
+			outHull->faceIndices.push_back(remap[c]);
+		}
+		for (unsigned int i = 1; i + 1 < out.numIndices; i++)
+		{
+			outHull->triangles.push_back(outHull->faceIndices[out.firstIndex]);
+			outHull->triangles.push_back(outHull->faceIndices[out.firstIndex + i]);
+			outHull->triangles.push_back(outHull->faceIndices[out.firstIndex + i + 1]);
+		}
+		outHull->faces.push_back(out);
+	};
+	std::vector<std::vector<int>> groupFaces(groupSeeds.size());
+	for (int f = 0; f < (int)faces.size(); f++)
+	{
+		if (!faces[f].deleted)
+		{
+			groupFaces[group[f]].push_back(f);
+		}
+	}
+	for (int g = 0; g < (int)groupSeeds.size(); g++)
 	{
-		const vector3 ap = points[i] - a;
-		float dot_product = ap.dot(n);
-		if (dot_product > bestDot)
+		outline.clear();
+		for (int f : groupFaces[g])
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				if (group[faces[f].adj[i]] != g)
+				{
+					outline.push_back({ faces[f].v[i], faces[f].v[(i + 1) % 3] });
+				}
+			}
+		}
+		std::sort(outline.begin(), outline.end());
+
+		// a vertex starting two outline edges means the group only touches itself at a corner, leave it as triangles
+		bool simple = true;
+		for (size_t i = 1; i < outline.size(); i++)
+		{
+			simple &= outline[i].first != outline[i - 1].first;
+		}
+		polygon.clear();
+		if (simple)
 		{
-			bestIndex = i;
+			int v = outline[0].first;
+			do
+			{
+				polygon.push_back(v);
+				const auto next = std::lower_bound(outline.begin(), outline.end(), std::make_pair(v, -1));
+				v = next->second;
+			} while (v != outline[0].first && polygon.size() <= outline.size());
+			simple = polygon.size() == outline.size();
+		}
+		if (simple)
+		{
+			addFace(polygon);
+			continue;
+		}
+		for (int f : groupFaces[g])
+		{
+			addFace({ faces[f].v[0], faces[f].v[1], faces[f].v[2] });
 		}
 	}
 
-	return bestIndex;
+	// vertex adjacency from the polygon edges, every edge is in two faces once each way round
+	const unsigned int numVerts = (unsigned int)outHull->vertices.size();
+	std::vector<std::pair<unsigned int, unsigned int>> links;
+	for (const ConvexHullFace& face : outHull->faces)
+	{
+		for (unsigned int i = 0; i < face.numIndices; i++)
+		{
+			const unsigned int a = outHull->faceIndices[face.firstIndex + i];
+			const unsigned int b = outHull->faceIndices[face.firstIndex + (i + 1) % face.numIndices];
+			links.push_back({ a, b });
+		}
+	}
+	std::sort(links.begin(), links.end());
+	outHull->adjacencyStart.assign(numVerts + 1, 0);
+	for (const auto& link : links)
+	{
+		outHull->adjacencyStart[link.first + 1]++;
+	}
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		outHull->adjacencyStart[i + 1] += outHull->adjacencyStart[i];
+	}
+	outHull->adjacency.reserve(links.size());
+	for (const auto& link : links)
+	{
+		outHull->adjacency.push_back(link.second);
+	}
+	return true;
 }
 
 void PhysUtil_GenerateMinkowskiDifference(
@@ -68,118 +970,28 @@ void PhysUtil_GenerateMinkowskiDifference(
 	const MeshPhysicsShape& b_shape, const matrix4& b_transform,
 	MinkowskiDifference* outDiff)
 {
-	const int numPointsInDiff = (int)a_shape.m_mesh.m_vertexPos.size() * (int)b_shape.m_mesh.m_vertexPos.size();
+	const int numA = (int)a_shape.m_mesh.m_vertexPos.size();
+	const int numB = (int)b_shape.m_mesh.m_vertexPos.size();
+	const int numPointsInDiff = numA * numB;
 	outDiff->allPoints.resize(numPointsInDiff);
 
-	for (int i = 0; i < a_shape.m_mesh.m_vertexPos.size(); i++)
+	for (int i = 0; i < numA; i++)
 	{
-		for (int j = 0; j < b_shape.m_mesh.m_vertexPos.size(); j++)
+		for (int j = 0; j < numB; j++)
 		{
 			vector3 t = a_transform * a_shape.m_mesh.m_vertexPos[i];
 			vector3 b = b_transform * b_shape.m_mesh.m_vertexPos[j];
 			vector3 v = t - b;
-			outDiff->allPoints[i * 4 + j] = v;
+			outDiff->allPoints[i * numB + j] = v;
 			outDiff->center = outDiff->center + v;
 		}
 	}
 	outDiff->center = outDiff->center / numPointsInDiff;
 
-	
-	// TODO: some sort of exterior hull algorithm
-	// 
-	//std::vector<vector3> hullPoints = outDiff->allPoints;
-	//
-	//std::sort(hullPoints.begin(), hullPoints.end(), [](const vector3& a, const vector3& b) { return a.x < b.x; });
-	//
-	//std::vector<int> exteriorPoints;
-	//exteriorPoints.resize(6);
-	//// order here matters, trying to make sure they are ccw
-	//PhysUtil_GetPointFurthestInDirection(outDiff->allPoints, Coordinates::GetLeft(), matrix4(), &exteriorPoints[0]);
-	//PhysUtil_GetPointFurthestInDirection(outDiff->allPoints, Coordinates::GetUp(), matrix4(), &exteriorPoints[1]);
-	//PhysUtil_GetPointFurthestInDirection(outDiff->allPoints, Coordinates::GetIn(), matrix4(), &exteriorPoints[2]);
-	//PhysUtil_GetPointFurthestInDirection(outDiff->allPoints, Coordinates::GetRight(), matrix4(), &exteriorPoints[3]);
-	//PhysUtil_GetPointFurthestInDirection(outDiff->allPoints, Coordinates::GetDown(), matrix4(), &exteriorPoints[4]);
-	//PhysUtil_GetPointFurthestInDirection(outDiff->allPoints, Coordinates::GetOut(), matrix4(), &exteriorPoints[5]);
-	//
-	//for (int i = 0; i < exteriorPoints.size() - 2; i++)
-	//{
-	//	const vector3& a = outDiff->allPoints[exteriorPoints[i]];
-	//	const vector3& b = outDiff->allPoints[exteriorPoints[i+1]];
-	//	const vector3& c = outDiff->allPoints[exteriorPoints[i+2]];
-	//	int new_index = GetPointFurthestInNormal(outDiff->allPoints, outDiff->center, a, b, c);
-	//	if (new_index != -1)
-	//	{
-	//		vector3 a_center = outDiff->center - a;
-	//		vector3 a_new = outDiff->allPoints[new_index] - a;
-	//		vector3 ab = b - a;
-	//		if (a_new.cross(ab).dot(a_center) > 0.0f)
-	//		{
-	//			exteriorPoints.insert(i + 1, new_index);
-	//		}
-	//	}
-	//}
-	
+	// only the corners, if the difference has any volume (flat 2D shapes draw their own outline)
+	ConvexHull hull;
+	if (PhysUtil_BuildConvexHull(outDiff->allPoints, &hull))
+	{
+		outDiff->exteriorHull = hull.vertices;
+	}
 }
-
-//
-//
-//   found this algorithm on the internet... TODO read it 
-//
-
-//void hull(Point * list, int n, Point * *A, Point * *B) 
-//{
-//	Point * u, * v, * mid;
-//	double t[6], oldt, newt;
-//	int i, j, k, l, minl;
-//
-//	if (n == 1) { A[0] = list->prev = list->next = NIL; return; }
-//
-//	for (u = list, i = 0; i < n / 2 - 1; u = u->next, i++);
-//
-//	mid = v = u->next;
-//	hull(list, n / 2, B, A); // recurse on left and right sides
-//	hull(mid, n - n / 2, B + n / 2 * 2, A + n / 2 * 2);
-//	
-//	for (; ; ) // find initial bridge
-//	{
-//		if (turn(u, v, v->next) < 0) v = v->next;
-//		else if (turn(u->prev, u, v) < 0) u = u->prev;
-//		else break;
-//	}
-//		
-//	// merge by tracking bridge uv over time
-//	for (i = k = 0, j = n / 2 * 2, oldt = -INF; ; oldt = newt) 
-//	{
-//		t[0] = time(B[i]->prev, B[i], B[i]->next);
-//		t[1] = time(B[j]->prev, B[j], B[j]->next);
-//		t[2] = time(u, u->next, v);
-//		t[3] = time(u->prev, u, v);
-//		t[4] = time(u, v->prev, v);
-//		t[5] = time(u, v, v->next);
-//		for (newt = INF, l = 0; l < 6; l++)
-//			if (t[l] > oldt && t[l] < newt) { minl = l; newt = t[l]; }
-//		if (newt == INF) break;
-//		switch (minl)
-//		{
-//			case 0: if (B[i]->x < u->x) A[k++] = B[i]; B[i++]->act(); break;
-//			case 1: if (B[j]->x > v->x) A[k++] = B[j]; B[j++]->act(); break;
-//			case 2: A[k++] = u = u->next; break;
-//			case 3: A[k++] = u; u = u->prev; break;
-//			case 4: A[k++] = v = v->prev; break;
-//			case 5: A[k++] = v; v = v->next; break;
-//		}
-//	}
-//	A[k] = NIL;
-//
-//	u->next = v; v->prev = u; // now go back in time to update pointers
-//
-//	for (k--; k >= 0; k--)
-//		if (A[k]->x <= u->x || A[k]->x >= v->x) {
-//		A[k]->act();
-//		if (A[k] == u) u = u->prev; else if (A[k] == v) v = v->next;
-//	}
-//	else {
-//		u->next = A[k]; A[k]->prev = u; v->prev = A[k]; A[k]->next = v;
-//		if (A[k]->x < mid->x) u = A[k]; else v = A[k];
-//	}
-//}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "physics_shape.h"
+#include <cstdint>
 
 vector3 PhysUtil_GetPointFurthestInDirection(
 	const std::vector<vector3>& points, 
@@ -8,6 +9,89 @@ vector3 PhysUtil_GetPointFurthestInDirection(
 	const matrix4& world, 
 	int* optional_out_index);
 
+// Same as above for a mesh, using the SIMD scan over its structure-of-arrays positions if it has them
+vector3 PhysUtil_GetPointFurthestInDirection(
+	const Mesh& mesh,
+	const vector3& direction,
+	const matrix4& world,
+	int* optional_out_index);
+
+// Index of the point with the largest dot product with direction (the first one, if several tie).
+// x/y/z are count long and count must be a multiple of MESH_SOA_LANES, see Mesh::BuildSoA.
+// Runs the widest kernel the CPU supports, every kernel returns exactly the same index.
+int PhysUtil_GetIndexFurthestInDirectionSoA(
+	const float* x, const float* y, const float* z, int count,
+	const vector3& direction);
+
+enum SIMD_LEVEL
+{
+	SIMD_LEVEL_SCALAR,
+	SIMD_LEVEL_SSE,
+	SIMD_LEVEL_AVX2,
+};
+SIMD_LEVEL PhysUtil_GetSimdLevel();
+SIMD_LEVEL PhysUtil_GetSupportedSimdLevel();
+void PhysUtil_SetSimdLevel(SIMD_LEVEL level); // clamped to what the CPU supports, i.e. force scalar for testing
+
+// The per body arrays of a PhysicsWorld, as the batch integrator sees them.  One array per component
+// (see PhysicsWorld), each count long and 32 byte aligned.
+struct PhysUtilBodyArrays
+{
+	float*         position[3];
+	float*         rotation[4];              // unit quaternion, x y z w
+	float*         linearMomentum[3];
+	float*         angularMomentum[3];
+	const float*   gravity[3];
+	const float*   mass;
+	const float*   invMass;                  // zero for bodies without mass, they don't move
+	const float*   invInertia[9];            // world space, x1 x2 x3 y1 y2 y3 z1 z2 z3 as in matrix3
+	const float*   pushVelocity[3];          // the solver's split impulse, only read by IntegratePositions
+	const float*   pushAngularVelocity[3];
+	const uint8_t* flags;
+	uint8_t        skipFlags;                // bodies with any of these flags set are left alone
+	int            count;
+};
+
+// Gravity for every body: linearMomentum += (gravity * mass) * dt
+void PhysUtil_IntegrateVelocities(const PhysUtilBodyArrays& bodies, float dt);
+// Moves every body through dt: position += (linearMomentum * invMass + pushVelocity) * dt,
+// rotation = rotation.integrate(invInertia * angularMomentum + pushAngularVelocity, dt)
+// Both run the widest kernel the CPU supports, every kernel gives exactly the same result.
+void PhysUtil_IntegratePositions(const PhysUtilBodyArrays& bodies, float dt);
+
+// Same result as above for a convex mesh, but walks the vertex adjacency from *inOutIndex towards
+// the direction instead of visiting every vertex.  *inOutIndex receives the vertex found.
+vector3 PhysUtil_GetPointFurthestInDirectionHillClimb(
+	const std::vector<vector3>& points,
+	const std::vector<unsigned int>& adjacencyStart,
+	const std::vector<unsigned int>& adjacency,
+	const vector3& direction,
+	const matrix4& world,
+	int* inOutIndex);
+
+// A convex hull with coplanar triangles merged into polygons
+struct ConvexHullFace
+{
+	vector3      normal;     // unit, pointing out
+	float        distance;   // normal . v for any vertex v on the face
+	unsigned int firstIndex; // the face's vertices are faceIndices[firstIndex] to faceIndices[firstIndex + numIndices - 1],
+	unsigned int numIndices; // counterclockwise seen from outside
+};
+struct ConvexHull
+{
+	std::vector<vector3>        vertices;    // only the corners, in the order they were first used by a face
+	std::vector<ConvexHullFace> faces;
+	std::vector<unsigned int>   faceIndices;
+	std::vector<unsigned int>   triangles;   // the faces as fans, three indices each
+	// vertices joined by a hull edge, same layout as Mesh::m_adjacencyStart/m_adjacency
+	std::vector<unsigned int>   adjacencyStart;
+	std::vector<unsigned int>   adjacency;
+};
+
+// Quickhull: the smallest convex hull around points.  Points inside, or within rounding error of a face,
+// are dropped.  Returns false (and leaves outHull empty) if the points are all on a plane or a line.
+bool PhysUtil_BuildConvexHull(const std::vector<vector3>& points, ConvexHull* outHull);
+
 #ifdef TEST_PROGRAM
 struct MinkowskiDifference
 {
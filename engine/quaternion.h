@@ -46,6 +46,48 @@ public:
         return q;
     }
 
+    // the same rotation as matrix4::rotate with these euler angles (x, then y, then z)
+    static quaternion from_euler(float rx, float ry, float rz)
+    {
+        const quaternion qx(Math_Sin(rx * 0.5f), 0.0f, 0.0f, Math_Cos(rx * 0.5f));
+        const quaternion qy(0.0f, Math_Sin(ry * 0.5f), 0.0f, Math_Cos(ry * 0.5f));
+        const quaternion qz(0.0f, 0.0f, Math_Sin(rz * 0.5f), Math_Cos(rz * 0.5f));
+        return qz * qy * qx;
+    }
+    // a rotation of angle radians around the unit axis (ax, ay, az)
+    static quaternion from_axis_angle(float ax, float ay, float az, float angle)
+    {
+        const float s = Math_Sin(angle * 0.5f);
+        return quaternion(ax * s, ay * s, az * s, Math_Cos(angle * 0.5f));
+    }
+
+    // part of the way (t from 0 to 1) from a to b, the shorter way round.  Not quite a constant speed like slerp,
+    // but there's no telling the difference over the small turns between one step and the next
+    static quaternion nlerp(const quaternion& a, const quaternion& b, float t)
+    {
+        const float sign = (a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w) < 0.0f ? -1.0f : 1.0f;
+        quaternion q;
+        q.x = a.x + (b.x * sign - a.x) * t;
+        q.y = a.y + (b.y * sign - a.y) * t;
+        q.z = a.z + (b.z * sign - a.z) * t;
+        q.w = a.w + (b.w * sign - a.w) * t;
+        return q.normalize();
+    }
+
+    // Where this orientation gets to after spinning at (wx, wy, wz) (rad/s, world space) for dt: one step
+    // along dq/dt = 0.5 * w * q, then back to unit length.  The batch integrator (PhysUtil_IntegratePositions)
+    // does exactly these sums in exactly this order, keep them in step.
+    quaternion integrate(float wx, float wy, float wz, float dt) const
+    {
+        const float h = 0.5f * dt;
+        quaternion q;
+        q.x = x + ((wx * w + wy * z) - wz * y) * h;
+        q.y = y + ((wy * w + wz * x) - wx * z) * h;
+        q.z = z + ((wz * w + wx * y) - wy * x) * h;
+        q.w = w - ((wx * x + wy * y) + wz * z) * h;
+        return q.normalize();
+    }
+
     quaternion normalize() const
     {
         quaternion q;
@@ -58,7 +100,7 @@ public:
     }
     float      magnitude() const
     {
-        return sqrt(x * x + y * y + z * z + w * w);
+        return Math_Sqrt(x * x + y * y + z * z + w * w);
     }
     quaternion inverse()   const
     {
@@ -1,64 +1,137 @@
 #pragma once
 
-#include <vector>
+#include "lib.h"
+#include <cfloat>
 
 struct SimplexPoint
 {
 	vector3 p;
 	vector3 A;
-	//int a_index;
+	int a_index = -1; // support feature on A, used to warm-start the next support query
 	vector3 B;
-	//int b_index;
-	//float edgeWeight;
+	int b_index = -1; // support feature on B
+	float weight = 0.0f; // barycentric weight in the closest point to the origin, set by the GJK solvers
 };
 
 // Used for EPA
 struct SimplexFace
 {
 	int point_index[3];
-	vector3 normal;
+	vector3 normal;   // pointing away from the origin
+	float distance;   // from the origin to the plane of the face (FLT_MAX if the face is degenerate)
+	int heap_index;   // where this face is in Simplex::faceHeap
 };
 
+// GJK never needs more than a tetrahedron, but EPA keeps adding one point per iteration
+// to the same storage.  Both are bounded so a whole narrowphase query stays on the stack.
+static constexpr int SIMPLEX_MAX_VERTS = 64;
+static constexpr int SIMPLEX_MAX_FACES = 2 * SIMPLEX_MAX_VERTS - 4; // closed triangle mesh: F = 2V - 4
+static constexpr int SIMPLEX_MAX_EDGES = 3 * SIMPLEX_MAX_VERTS - 6; // closed triangle mesh: E = 3V - 6
+
 struct Simplex
 {
 	bool m_containsOrigin = false;
-	std::vector<SimplexPoint> verts;
+	FixedArray<SimplexPoint, SIMPLEX_MAX_VERTS> verts;
 
 	// BEGIN: EPA stuff
 	// might be cleaner to make a separate "polytope" structure rather than shoving this in here but this is faster for now
 	void SetupForEPA()
 	{
 		assert(verts.size() == 4);
+		// wind the faces so every normal points out of the tetrahedron, AddFace keeps that
+		// winding for everything after this so the normals never depend on where the origin is
+		const vector3 n = (verts[1].p - verts[0].p).cross(verts[2].p - verts[0].p);
+		if (n.dot(verts[3].p - verts[0].p) > 0.0f)
+		{
+			SimplexPoint temp = verts[0];
+			verts[0] = verts[1];
+			verts[1] = temp;
+		}
+		ClearFaces();
 		AddFace(0,1,2);
 		AddFace(0,2,3);
 		AddFace(3,1,0);
 		AddFace(1,3,2);
 	}
+	void ClearFaces()
+	{
+		faces.clear();
+		faceHeap.clear();
+	}
 	void AddFace(int va, int vb, int vc)
 	{
-		int face_index = (int)faces.size();
+		int face_index = faces.size();
 		faces.resize(face_index + 1);
+		SimplexFace& face = faces[face_index];
 
-		faces[face_index].point_index[0] = va;
-		faces[face_index].point_index[1] = vb;
-		faces[face_index].point_index[2] = vc;
+		face.point_index[0] = va;
+		face.point_index[1] = vb;
+		face.point_index[2] = vc;
 
 		const vector3& a = verts[va].p;
 		const vector3& b = verts[vb].p;
 		const vector3& c = verts[vc].p;
-		const vector3 ab = (b - a);
-		const vector3 ac = (c - a);
-		const vector3 n = (ab.cross(ac)).normalize();
-		faces[face_index].normal = n.dot(a) ? n : -n;
+		const vector3 n = (b - a).cross(c - a);
+		const float length = n.magnitude();
+		if (FloatEquals(length, 0.0f))
+		{
+			// sliver, keep it so the polytope stays closed but never pick it as the closest face
+			face.normal = vector3();
+			face.distance = FLT_MAX;
+		}
+		else
+		{
+			// counter-clockwise seen from outside, the distance goes slightly negative if the origin is just outside this face
+			face.normal = n * (1.0f / length);
+			face.distance = face.normal.dot(a);
+		}
+
+		face.heap_index = faceHeap.size();
+		faceHeap.push_back(face_index);
+		HeapSiftUp(face.heap_index);
 	}
-	std::vector< SimplexFace> faces; 
+	// swaps the last face into its place, so face indices past this one are not stable
+	void RemoveFace(int face_index)
+	{
+		// take it out of the heap first
+		const int heap_index = faces[face_index].heap_index;
+		const int last_heap_index = faceHeap.size() - 1;
+		if (heap_index != last_heap_index)
+		{
+			HeapSwap(heap_index, last_heap_index);
+			faceHeap.pop_back();
+			HeapSiftDown(heap_index);
+			HeapSiftUp(heap_index);
+		}
+		else
+		{
+			faceHeap.pop_back();
+		}
+
+		// then swap-and-pop the face itself
+		const int last_face_index = faces.size() - 1;
+		if (face_index != last_face_index)
+		{
+			faces[face_index] = faces[last_face_index];
+			faceHeap[faces[face_index].heap_index] = face_index;
+		}
+		faces.pop_back();
+	}
+	// the face whose plane is nearest the origin
+	int GetClosestFace() const
+	{
+		assert(!faceHeap.empty());
+		return faceHeap[0];
+	}
+	FixedArray<SimplexFace, SIMPLEX_MAX_FACES> faces;
+	FixedArray<int, SIMPLEX_MAX_FACES> faceHeap; // indices into faces, a binary min-heap on SimplexFace::distance
 	// END: EPA stuff
 
-	int size() const { return (int)verts.size(); }
+	int size() const { return verts.size(); }
 
 	int insert(const SimplexPoint& point, int index = -1)
 	{
-		int numVerts = (int)verts.size();
+		int numVerts = verts.size();
 		verts.resize(numVerts + 1);
 		if (index == -1)
 		{
@@ -73,4 +146,39 @@ struct Simplex
 		verts[index] = point;
 		return index;
 	}
+
+private:
+	bool HeapLess(int i, int j) const { return faces[faceHeap[i]].distance < faces[faceHeap[j]].distance; }
+	void HeapSwap(int i, int j)
+	{
+		swap(faceHeap[i], faceHeap[j]);
+		faces[faceHeap[i]].heap_index = i;
+		faces[faceHeap[j]].heap_index = j;
+	}
+	void HeapSiftUp(int i)
+	{
+		while (i > 0 && HeapLess(i, (i - 1) / 2))
+		{
+			HeapSwap(i, (i - 1) / 2);
+			i = (i - 1) / 2;
+		}
+	}
+	void HeapSiftDown(int i)
+	{
+		for (;;)
+		{
+			int smallest = i;
+			const int left = 2 * i + 1;
+			const int right = 2 * i + 2;
+			if (left < faceHeap.size() && HeapLess(left, smallest))   { smallest = left; }
+			if (right < faceHeap.size() && HeapLess(right, smallest)) { smallest = right; }
+			if (smallest == i)
+			{
+				return;
+			}
+			HeapSwap(i, smallest);
+			i = smallest;
+		}
+	}
 };
+
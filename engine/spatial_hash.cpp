@@ -0,0 +1,453 @@
+#include "spatial_hash.h"
+#include "worker_pool.h"
+#include "lib.h"
+#include <cmath>
+#include <cfloat>
+
+static constexpr uint64_t SPATIAL_HASH_EMPTY = ~0ull;
+static constexpr int      SPATIAL_HASH_COORD_BITS = 21;
+static constexpr int      SPATIAL_HASH_COORD_LIMIT = (1 << (SPATIAL_HASH_COORD_BITS - 1)) - 1;
+
+// 21 bits per axis, cells further out than a million from the origin get squashed onto the edge
+static uint64_t GetCellKey(int x, int y, int z)
+{
+	const uint64_t mask = (1ull << SPATIAL_HASH_COORD_BITS) - 1;
+	return ((uint64_t)(x + SPATIAL_HASH_COORD_LIMIT) & mask) << (2 * SPATIAL_HASH_COORD_BITS)
+		| ((uint64_t)(y + SPATIAL_HASH_COORD_LIMIT) & mask) << SPATIAL_HASH_COORD_BITS
+		| ((uint64_t)(z + SPATIAL_HASH_COORD_LIMIT) & mask);
+}
+static int GetCellCoord(float value, float invCellSize)
+{
+	const float cell = floorf(value * invCellSize);
+	if (!(cell > (float)-SPATIAL_HASH_COORD_LIMIT))
+	{
+		return -SPATIAL_HASH_COORD_LIMIT; // NaN ends up here too
+	}
+	return cell < (float)SPATIAL_HASH_COORD_LIMIT ? (int)cell : SPATIAL_HASH_COORD_LIMIT;
+}
+
+//******************************************************************************
+SpatialHashGrid::SpatialHashGrid(float cellSize)
+	: m_fixedCellSize(cellSize)
+{
+	if (cellSize > 0.0f)
+	{
+		m_cellSize = cellSize;
+		m_invCellSize = 1.0f / cellSize;
+	}
+}
+//******************************************************************************
+int SpatialHashGrid::AddProxy(const aabb& box, void* userData)
+{
+	int proxy;
+	if (!m_freeProxies.empty())
+	{
+		proxy = m_freeProxies.back();
+		m_freeProxies.pop_back();
+	}
+	else
+	{
+		proxy = (int)m_userData.size();
+		m_lowerX.push_back(0.0f); m_lowerY.push_back(0.0f); m_lowerZ.push_back(0.0f);
+		m_upperX.push_back(0.0f); m_upperY.push_back(0.0f); m_upperZ.push_back(0.0f);
+		m_userData.push_back(nullptr);
+		m_alive.push_back(0);
+		m_large.push_back(0);
+	}
+	m_userData[proxy] = userData;
+	m_alive[proxy] = 1;
+	m_large[proxy] = 0;
+	MoveProxy(proxy, box);
+	return proxy;
+}
+//******************************************************************************
+void SpatialHashGrid::RemoveProxy(int proxy)
+{
+	assert(m_alive[proxy]);
+	m_alive[proxy] = 0;
+	m_userData[proxy] = nullptr;
+	m_removedProxies.push_back(proxy);
+	m_dirty = true;
+}
+//******************************************************************************
+void SpatialHashGrid::MoveProxy(int proxy, const aabb& box)
+{
+	assert(m_alive[proxy]);
+	m_lowerX[proxy] = box.lower.x; m_lowerY[proxy] = box.lower.y; m_lowerZ[proxy] = box.lower.z;
+	m_upperX[proxy] = box.upper.x; m_upperY[proxy] = box.upper.y; m_upperZ[proxy] = box.upper.z;
+	m_dirty = true;
+}
+//******************************************************************************
+aabb SpatialHashGrid::GetBox(int proxy) const
+{
+	return { { m_lowerX[proxy], m_lowerY[proxy], m_lowerZ[proxy] }, { m_upperX[proxy], m_upperY[proxy], m_upperZ[proxy] } };
+}
+//******************************************************************************
+SpatialHashGrid::CellRange SpatialHashGrid::GetCellRange(const aabb& box) const
+{
+	CellRange range;
+	range.lower[0] = GetCellCoord(box.lower.x, m_invCellSize);
+	range.lower[1] = GetCellCoord(box.lower.y, m_invCellSize);
+	range.lower[2] = GetCellCoord(box.lower.z, m_invCellSize);
+	range.upper[0] = GetCellCoord(box.upper.x, m_invCellSize);
+	range.upper[1] = GetCellCoord(box.upper.y, m_invCellSize);
+	range.upper[2] = GetCellCoord(box.upper.z, m_invCellSize);
+	return range;
+}
+//******************************************************************************
+int SpatialHashGrid::FindCell(uint64_t key) const
+{
+	if (m_cells.empty())
+	{
+		return -1;
+	}
+	const uint64_t mask = m_cells.size() - 1;
+	for (uint64_t slot = (key * 0x9E3779B97F4A7C15ull) >> 32 & mask; ; slot = (slot + 1) & mask)
+	{
+		if (m_cells[slot].key == key)
+		{
+			return (int)slot;
+		}
+		if (m_cells[slot].key == SPATIAL_HASH_EMPTY)
+		{
+			return -1;
+		}
+	}
+}
+//******************************************************************************
+int SpatialHashGrid::InsertCell(uint64_t key)
+{
+	// the table is sized to at least twice the entries, so there is always an empty slot to stop on
+	const uint64_t mask = m_cells.size() - 1;
+	for (uint64_t slot = (key * 0x9E3779B97F4A7C15ull) >> 32 & mask; ; slot = (slot + 1) & mask)
+	{
+		if (m_cells[slot].key == key)
+		{
+			return (int)slot;
+		}
+		if (m_cells[slot].key == SPATIAL_HASH_EMPTY)
+		{
+			m_cells[slot].key = key;
+			return (int)slot;
+		}
+	}
+}
+//******************************************************************************
+void SpatialHashGrid::Rebuild()
+{
+	const int numProxies = (int)m_userData.size();
+
+	// about one box per cell on its longest side.  The big boxes end up on their own list rather than in the
+	// cells, so they're left out of the average too (one floor would otherwise make the cells too big for
+	// everything else): average everything, then again without the ones too big for cells that size
+	if (m_fixedCellSize <= 0.0f)
+	{
+		for (int pass = 0; pass < 2; pass++)
+		{
+			float total = 0.0f;
+			int count = 0;
+			for (int i = 0; i < numProxies; i++)
+			{
+				if (m_alive[i] && (pass == 0 || GetCellRange(GetBox(i)).GetCount() <= SPATIAL_HASH_MAX_CELLS_PER_PROXY))
+				{
+					const float x = m_upperX[i] - m_lowerX[i];
+					const float y = m_upperY[i] - m_lowerY[i];
+					const float z = m_upperZ[i] - m_lowerZ[i];
+					total += max(x, max(y, z));
+					count++;
+				}
+			}
+			const float average = count > 0 ? total / count : 0.0f;
+			m_cellSize = average > 0.0f ? average : (pass == 0 ? 1.0f : m_cellSize);
+			m_invCellSize = 1.0f / m_cellSize;
+		}
+	}
+
+	// count the entries to size the table, the big boxes get left out
+	int numEntries = 0;
+	m_largeProxies.clear();
+	for (int i = 0; i < numProxies; i++)
+	{
+		if (!m_alive[i])
+		{
+			continue;
+		}
+		const int64_t count = GetCellRange(GetBox(i)).GetCount();
+		m_large[i] = count > SPATIAL_HASH_MAX_CELLS_PER_PROXY;
+		if (m_large[i])
+		{
+			m_largeProxies.push_back(i);
+		}
+		else
+		{
+			numEntries += (int)count;
+		}
+	}
+
+	size_t capacity = 16;
+	while (capacity < 2 * (size_t)numEntries)
+	{
+		capacity *= 2;
+	}
+	m_cells.assign(capacity, { SPATIAL_HASH_EMPTY, 0, 0 });
+
+	// count what goes in each cell, hand out the ranges, then fill them in (in proxy order, so it's the same every time)
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int i = 0; i < numProxies; i++)
+		{
+			if (!m_alive[i] || m_large[i])
+			{
+				continue;
+			}
+			const CellRange range = GetCellRange(GetBox(i));
+			for (int x = range.lower[0]; x <= range.upper[0]; x++)
+			for (int y = range.lower[1]; y <= range.upper[1]; y++)
+			for (int z = range.lower[2]; z <= range.upper[2]; z++)
+			{
+				Cell& cell = m_cells[InsertCell(GetCellKey(x, y, z))];
+				if (pass == 1)
+				{
+					m_cellProxies[cell.start + cell.count] = i;
+				}
+				cell.count++;
+			}
+		}
+		if (pass == 0)
+		{
+			int start = 0;
+			for (Cell& cell : m_cells)
+			{
+				cell.start = start;
+				start += cell.count;
+				cell.count = 0;
+			}
+			m_cellProxies.resize(numEntries);
+		}
+	}
+	m_dirty = false;
+}
+//******************************************************************************
+// Everything in a cell with proxy and a higher id.  A pair of boxes that share several cells is
+// only added from the lowest of them, so there is no need to remove duplicates afterwards.
+void SpatialHashGrid::FindPairs(int begin, int end, std::vector<BroadphasePair>* out) const
+{
+	for (int proxy = begin; proxy < end; proxy++)
+	{
+		if (!m_alive[proxy])
+		{
+			continue;
+		}
+		const aabb box = GetBox(proxy);
+
+		for (int other : m_largeProxies)
+		{
+			if (other != proxy && (!m_large[proxy] || proxy < other) && box.Overlaps(GetBox(other)))
+			{
+				out->push_back({ min(proxy, other), max(proxy, other) });
+			}
+		}
+		if (m_large[proxy])
+		{
+			continue;
+		}
+
+		const CellRange range = GetCellRange(box);
+		for (int x = range.lower[0]; x <= range.upper[0]; x++)
+		for (int y = range.lower[1]; y <= range.upper[1]; y++)
+		for (int z = range.lower[2]; z <= range.upper[2]; z++)
+		{
+			const Cell& cell = m_cells[FindCell(GetCellKey(x, y, z))];
+			for (int i = cell.start; i < cell.start + cell.count; i++)
+			{
+				const int other = m_cellProxies[i];
+				if (other <= proxy || !box.Overlaps(GetBox(other)))
+				{
+					continue;
+				}
+				const CellRange otherRange = GetCellRange(GetBox(other));
+				if (max(range.lower[0], otherRange.lower[0]) == x &&
+					max(range.lower[1], otherRange.lower[1]) == y &&
+					max(range.lower[2], otherRange.lower[2]) == z)
+				{
+					out->push_back({ proxy, other });
+				}
+			}
+		}
+	}
+}
+//******************************************************************************
+void SpatialHashGrid::FindPairsRange(int begin, int end, int threadIndex, void* userData)
+{
+	SpatialHashGrid* grid = (SpatialHashGrid*)userData;
+	grid->FindPairs(begin, end, &grid->m_threadPairs[threadIndex]);
+}
+//******************************************************************************
+void SpatialHashGrid::Update()
+{
+	Rebuild();
+
+	// each thread collects its own pairs, CommitNewPairs sorts them so it doesn't matter who found what
+	constexpr int PROXIES_PER_CHUNK = 256;
+	m_threadPairs.resize(WorkerPool_GetNumThreads());
+	for (std::vector<BroadphasePair>& pairs : m_threadPairs)
+	{
+		pairs.clear();
+	}
+	WorkerPool_ParallelFor((int)m_userData.size(), PROXIES_PER_CHUNK, FindPairsRange, this);
+
+	m_newPairs.clear();
+	for (const std::vector<BroadphasePair>& pairs : m_threadPairs)
+	{
+		m_newPairs.insert(m_newPairs.end(), pairs.begin(), pairs.end());
+	}
+	CommitNewPairs();
+
+	// only reuse ids once their pairs have been reported as removed
+	m_freeProxies.insert(m_freeProxies.end(), m_removedProxies.begin(), m_removedProxies.end());
+	m_removedProxies.clear();
+}
+//******************************************************************************
+void SpatialHashGrid::Query(const aabb& region, BroadphaseQueryFn fn, void* userData) const
+{
+	const CellRange range = GetCellRange(region);
+	const int numProxies = (int)m_userData.size();
+	if (m_dirty || range.GetCount() > numProxies)
+	{
+		for (int i = 0; i < numProxies; i++)
+		{
+			if (m_alive[i] && GetBox(i).Overlaps(region) && !fn(i, userData))
+			{
+				return;
+			}
+		}
+		return;
+	}
+
+	for (int other : m_largeProxies)
+	{
+		if (GetBox(other).Overlaps(region) && !fn(other, userData))
+		{
+			return;
+		}
+	}
+	for (int x = range.lower[0]; x <= range.upper[0]; x++)
+	for (int y = range.lower[1]; y <= range.upper[1]; y++)
+	for (int z = range.lower[2]; z <= range.upper[2]; z++)
+	{
+		const int slot = FindCell(GetCellKey(x, y, z));
+		if (slot < 0)
+		{
+			continue;
+		}
+		const Cell& cell = m_cells[slot];
+		for (int i = cell.start; i < cell.start + cell.count; i++)
+		{
+			// same trick as FindPairs, only report a box from the first cell it shares with the region
+			const int proxy = m_cellProxies[i];
+			const aabb box = GetBox(proxy);
+			if (!box.Overlaps(region))
+			{
+				continue;
+			}
+			const CellRange boxRange = GetCellRange(box);
+			if (max(range.lower[0], boxRange.lower[0]) == x &&
+				max(range.lower[1], boxRange.lower[1]) == y &&
+				max(range.lower[2], boxRange.lower[2]) == z &&
+				!fn(proxy, userData))
+			{
+				return;
+			}
+		}
+	}
+}
+//******************************************************************************
+void SpatialHashGrid::RayCast(const vector3& from, const vector3& to, BroadphaseRayFn fn, void* userData) const
+{
+	float maxFraction = 1.0f;
+	const int numProxies = (int)m_userData.size();
+	const float d[3] = { to.x - from.x, to.y - from.y, to.z - from.z };
+	const float numCells = (fabsf(d[0]) + fabsf(d[1]) + fabsf(d[2])) * m_invCellSize + 1.0f;
+	if (m_dirty || numCells > (float)m_cellProxies.size())
+	{
+		// walking the cells would cost more than checking everything
+		for (int i = 0; i < numProxies && maxFraction > 0.0f; i++)
+		{
+			if (m_alive[i] && GetBox(i).IntersectsSegment(from, to, maxFraction))
+			{
+				const float clipped = fn(i, maxFraction, userData); // min() is a macro, don't call fn twice
+				maxFraction = min(maxFraction, clipped);
+			}
+		}
+		return;
+	}
+
+	for (int other : m_largeProxies)
+	{
+		if (maxFraction > 0.0f && GetBox(other).IntersectsSegment(from, to, maxFraction))
+		{
+			const float clipped = fn(other, maxFraction, userData);
+			maxFraction = min(maxFraction, clipped);
+		}
+	}
+
+	// a box can sit in several of the cells the ray goes through, mark them off as they're seen
+	m_rayMarks.resize(numProxies, 0);
+	if (++m_rayCount == 0)
+	{
+		m_rayMarks.assign(numProxies, 0);
+		m_rayCount = 1;
+	}
+
+	// step from cell to cell along the ray in order (Amanatides and Woo), stopping once the next
+	// cell starts past the closest hit so far
+	const float start[3] = { from.x, from.y, from.z };
+	int cell[3];
+	int step[3];
+	float tNext[3];
+	float tDelta[3];
+	for (int i = 0; i < 3; i++)
+	{
+		cell[i] = GetCellCoord(start[i], m_invCellSize);
+		if (d[i] == 0.0f)
+		{
+			step[i] = 0;
+			tNext[i] = FLT_MAX;
+			tDelta[i] = FLT_MAX;
+			continue;
+		}
+		step[i] = d[i] > 0.0f ? 1 : -1;
+		const float boundary = (float)(cell[i] + (step[i] > 0 ? 1 : 0)) * m_cellSize;
+		tNext[i] = (boundary - start[i]) / d[i];
+		tDelta[i] = m_cellSize / fabsf(d[i]);
+	}
+
+	float tEnter = 0.0f;
+	while (tEnter <= maxFraction && maxFraction > 0.0f)
+	{
+		const int slot = FindCell(GetCellKey(cell[0], cell[1], cell[2]));
+		if (slot >= 0)
+		{
+			const Cell& c = m_cells[slot];
+			for (int i = c.start; i < c.start + c.count && maxFraction > 0.0f; i++)
+			{
+				const int proxy = m_cellProxies[i];
+				if (m_rayMarks[proxy] == m_rayCount)
+				{
+					continue;
+				}
+				// the ray only gets shorter, if it misses now it always will
+				m_rayMarks[proxy] = m_rayCount;
+				if (GetBox(proxy).IntersectsSegment(from, to, maxFraction))
+				{
+					const float clipped = fn(proxy, maxFraction, userData);
+					maxFraction = min(maxFraction, clipped);
+				}
+			}
+		}
+		const int axis = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+		tEnter = tNext[axis];
+		cell[axis] += step[axis];
+		tNext[axis] += tDelta[axis];
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "broadphase.h"
+
+//******************************************************************************
+// SpatialHashGrid - uniform grid of cells hashed into an open addressed table
+//   Best when the objects are about the same size: the cell size is picked from
+//   the average box (or fixed up front) so each box only lands in a few cells.
+//   The table is rebuilt from scratch every Update, streaming through the boxes
+//   kept as separate arrays of floats, then the pairs are found in parallel.
+//   Boxes that would cover too many cells (a floor, say) are kept out of the
+//   table and tested against everything directly.
+//******************************************************************************
+static constexpr int SPATIAL_HASH_MAX_CELLS_PER_PROXY = 64;
+
+class SpatialHashGrid : public Broadphase
+{
+public:
+	// cellSize 0 picks one every Update from the boxes
+	explicit SpatialHashGrid(float cellSize = 0.0f);
+
+	virtual int   AddProxy(const aabb& box, void* userData);
+	virtual void  RemoveProxy(int proxy);
+	virtual void  MoveProxy(int proxy, const aabb& box);
+	virtual void* GetUserData(int proxy) const { return m_userData[proxy]; }
+	virtual void  Update();
+	// these use the cells if nothing has moved since the last Update and check every proxy otherwise.
+	// RayCast marks what it has visited in the grid, so it can't be called from two threads at once.
+	virtual void  Query(const aabb& region, BroadphaseQueryFn fn, void* userData) const;
+	virtual void  RayCast(const vector3& from, const vector3& to, BroadphaseRayFn fn, void* userData) const;
+
+	float GetCellSize() const { return m_cellSize; }
+
+private:
+	// cells are only created for the keys something was put in, start/count index m_cellProxies
+	struct Cell
+	{
+		uint64_t key;
+		int      start;
+		int      count;
+	};
+	struct CellRange
+	{
+		int lower[3];
+		int upper[3];
+		int64_t GetCount() const { return (int64_t)(upper[0] - lower[0] + 1) * (upper[1] - lower[1] + 1) * (upper[2] - lower[2] + 1); }
+	};
+
+	aabb      GetBox(int proxy) const;
+	CellRange GetCellRange(const aabb& box) const;
+	int       FindCell(uint64_t key) const;  // slot in m_cells, or -1
+	int       InsertCell(uint64_t key);      // slot in m_cells, new or not
+	void      Rebuild();
+	void      FindPairs(int begin, int end, std::vector<BroadphasePair>* out) const;
+	static void FindPairsRange(int begin, int end, int threadIndex, void* userData);
+
+	// proxies, a structure of arrays so the rebuild only touches what it needs
+	std::vector<float>    m_lowerX, m_lowerY, m_lowerZ;
+	std::vector<float>    m_upperX, m_upperY, m_upperZ;
+	std::vector<void*>    m_userData;
+	std::vector<uint8_t>  m_alive;
+	std::vector<uint8_t>  m_large;           // too big for the table, as of the last Update
+	std::vector<int>      m_freeProxies;
+	std::vector<int>      m_removedProxies;  // free after the next Update
+
+	// the grid, as of the last Update
+	const float           m_fixedCellSize;
+	float                 m_cellSize = 1.0f;
+	float                 m_invCellSize = 1.0f;
+	std::vector<Cell>     m_cells;           // power of two sized, linear probing
+	std::vector<int>      m_cellProxies;
+	std::vector<int>      m_largeProxies;
+	bool                  m_dirty = true;    // something moved since the grid was built
+
+	std::vector<std::vector<BroadphasePair>> m_threadPairs;
+	mutable std::vector<uint32_t> m_rayMarks; // last ray to see each proxy
+	mutable uint32_t      m_rayCount = 0;
+};
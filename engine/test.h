@@ -3,4 +3,5 @@
 void TestPhysics();
 void Test3D();
 void Test2D();
-void TestUtil();
\ No newline at end of file
+void TestUtil();
+void TestBenchmark();
@@ -41,7 +41,7 @@ static void ResetSimplex()
 	s_simplex.verts[0].A = s_collisionParams.aTransform * a_local;
 	s_simplex.verts[0].B = s_collisionParams.bTransform * b_local;
 	s_simplex.verts[0].p = s_simplex.verts[0].A - s_simplex.verts[0].B;
-	s_simplex.faces.clear();
+	s_simplex.ClearFaces();
 	s_simplex.m_containsOrigin = false;
 	s_searchDirection = GetSearchDirection(s_simplex);
 	s_result = COLLISION_RESULT_NONE;
@@ -0,0 +1,305 @@
+#include "test.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "physics.h"
+#include "physics_shape.h"
+#include "aabb_tree.h"
+#include "physics_util.h"
+#include "lib.h"
+
+//******************************************************************************
+// Benchmarks - time Physics_Update over worlds of increasing size
+//   Run with "benchmark" on the command line, results go to stdout.
+//******************************************************************************
+
+static unsigned int s_seed = 12345;
+static float RandomFloat()
+{
+	s_seed = s_seed * 1664525u + 1013904223u;
+	return float(s_seed >> 8) / float(1 << 24);
+}
+
+// n balls dropped from a cube sized to keep the density (and so the pairs per ball) the same at every n
+static float GetBallCubeSize(int n, float radius)
+{
+	return cbrtf((float)n) * radius * 5.0f;
+}
+static void CreateBalls(int n, const PhysicsShape* shape, float radius, std::vector<Physics*>* outBalls)
+{
+	StaticPhysicsData physData;
+	physData.m_gravity = { 0.0f, -9.8f, 0.0f };
+	physData.m_mass = 1.0f;
+	physData.m_elasticity = 0.5f;
+	physData.m_momentOfInertia = 0.4f * physData.m_mass * radius * radius;
+	physData.m_inertiaTensor = matrix3(physData.m_momentOfInertia, 0.0f, 0.0f,
+	                                   0.0f, physData.m_momentOfInertia, 0.0f,
+	                                   0.0f, 0.0f, physData.m_momentOfInertia);
+	physData.m_inverseInertiaTensor = physData.m_inertiaTensor.inv();
+	physData.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+
+	const float side = GetBallCubeSize(n, radius);
+	for (int i = 0; i < n; i++)
+	{
+		physData.m_initialPosition = vector3(RandomFloat(), RandomFloat(), RandomFloat()) * side;
+		outBalls->push_back(new Physics((PhysicsShape*)shape, physData));
+	}
+}
+
+static void BenchmarkStep(BROADPHASE_TYPE broadphase, const char* name)
+{
+	constexpr float RADIUS = 0.5f;
+	constexpr float DT = 1.0f / 60.0f;
+	constexpr int NUM_STEPS = 20;
+	const int counts[] = { 100, 1000, 5000, 10000, 25000, 50000 };
+
+	Physics_SetBroadphase(broadphase);
+	SpherePhysicsShape sphere(RADIUS);
+	printf("Physics_Update (%s), %d steps of %.4fs\n", name, NUM_STEPS, DT);
+	for (int count : counts)
+	{
+		const float side = GetBallCubeSize(count, RADIUS);
+		BoxPhysicsShape floorShape(side, side, 1.0f);
+		StaticPhysicsData floorData;
+		floorData.m_initialPosition = { side * 0.5f, -0.5f, side * 0.5f };
+		Physics* floor = new Physics(&floorShape, floorData);
+
+		std::vector<Physics*> balls;
+		CreateBalls(count, &sphere, RADIUS, &balls);
+		Physics_Update(DT); // the first step sorts everything from scratch, don't count it
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (int step = 0; step < NUM_STEPS; step++)
+		{
+			Physics_Update(DT);
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+		const double ms = std::chrono::duration<double, std::milli>(end - start).count() / NUM_STEPS;
+		printf("  %6d bodies: %9.3f ms/step  %7.3f us/body\n", count, ms, ms * 1000.0 / count);
+
+		for (auto it = balls.rbegin(); it != balls.rend(); ++it)
+		{
+			delete *it;
+		}
+		delete floor;
+	}
+}
+
+// a big mostly static scene: every proxy jitters a little (inside its margin), a few fly off somewhere new
+static void BenchmarkTreeTick()
+{
+	constexpr int NUM_PROXIES = 100000;
+	constexpr int NUM_TICKS = 20;
+	const float side = cbrtf((float)NUM_PROXIES) * 2.0f;
+	std::vector<aabb> boxes(NUM_PROXIES);
+	std::vector<int> proxies(NUM_PROXIES);
+	AABBTree tree;
+	for (int i = 0; i < NUM_PROXIES; i++)
+	{
+		const vector3 p = vector3(RandomFloat(), RandomFloat(), RandomFloat()) * side;
+		boxes[i] = { p, p + vector3(1.0f) };
+		proxies[i] = tree.AddProxy(boxes[i], nullptr);
+	}
+	tree.Update();
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (int tick = 0; tick < NUM_TICKS; tick++)
+	{
+		for (int i = 0; i < NUM_PROXIES; i++)
+		{
+			const vector3 move = (i % 100 == tick) ? (vector3(RandomFloat(), RandomFloat(), RandomFloat()) - vector3(0.5f)) * side * 0.5f
+			                                       : (vector3(RandomFloat(), RandomFloat(), RandomFloat()) - vector3(0.5f)) * 0.01f;
+			boxes[i] = { boxes[i].lower + move, boxes[i].upper + move };
+			tree.MoveProxy(proxies[i], boxes[i]);
+		}
+		tree.Update();
+	}
+	const auto end = std::chrono::high_resolution_clock::now();
+	const double ms = std::chrono::duration<double, std::milli>(end - start).count() / NUM_TICKS;
+	printf("AABBTree, %d proxies, 1%% reinserted per tick: %.3f ms/tick, height %d, %d pairs\n", NUM_PROXIES, ms, tree.GetHeight(), (int)tree.GetPairs().size());
+}
+
+// the batch integrator on its own, over a lot of bodies, at every SIMD level the CPU has
+static void BenchmarkIntegrator()
+{
+	constexpr int NUM_BODIES = 100000;
+	constexpr int NUM_STEPS = 100;
+	PhysicsFloatArray arrays[33];
+	for (PhysicsFloatArray& a : arrays)
+	{
+		a.resize(NUM_BODIES);
+		for (float& f : a)
+		{
+			f = RandomFloat();
+		}
+	}
+	std::vector<uint8_t> flags(NUM_BODIES, 0);
+	PhysUtilBodyArrays bodies;
+	for (int c = 0; c < 3; c++)
+	{
+		bodies.position[c] = arrays[c].data();
+		bodies.linearMomentum[c] = arrays[7 + c].data();
+		bodies.angularMomentum[c] = arrays[10 + c].data();
+		bodies.gravity[c] = arrays[13 + c].data();
+		bodies.pushVelocity[c] = arrays[16 + c].data();
+		bodies.pushAngularVelocity[c] = arrays[19 + c].data();
+	}
+	for (int c = 0; c < 4; c++)
+	{
+		bodies.rotation[c] = arrays[3 + c].data();
+	}
+	for (int c = 0; c < 9; c++)
+	{
+		bodies.invInertia[c] = arrays[22 + c].data();
+	}
+	bodies.mass = arrays[31].data();
+	bodies.invMass = arrays[32].data();
+	bodies.flags = flags.data();
+	bodies.skipFlags = 1;
+	bodies.count = NUM_BODIES;
+
+	const char* names[] = { "scalar", "sse", "avx2" };
+	const SIMD_LEVEL supported = PhysUtil_GetSupportedSimdLevel();
+	for (int level = SIMD_LEVEL_SCALAR; level <= supported; level++)
+	{
+		PhysUtil_SetSimdLevel((SIMD_LEVEL)level);
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (int step = 0; step < NUM_STEPS; step++)
+		{
+			PhysUtil_IntegrateVelocities(bodies, 1.0f / 60.0f);
+			PhysUtil_IntegratePositions(bodies, 1.0f / 60.0f);
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+		const double ms = std::chrono::duration<double, std::milli>(end - start).count() / NUM_STEPS;
+		printf("Integrator (%s), %d bodies: %.3f ms/step\n", names[level], NUM_BODIES, ms);
+	}
+	PhysUtil_SetSimdLevel(supported);
+}
+
+// a field of boxes resting on the floor, stepped with sleeping off and then once they've all gone to sleep
+static void BenchmarkSleeping()
+{
+	constexpr int SIDE = 100;
+	constexpr float DT = 1.0f / 60.0f;
+	constexpr int NUM_STEPS = 20;
+
+	BoxPhysicsShape box(1.0f, 1.0f, 1.0f);
+	BoxPhysicsShape floorShape(SIDE * 2.0f, SIDE * 2.0f, 1.0f);
+	StaticPhysicsData floorData;
+	floorData.m_initialPosition = { SIDE, -0.5f, SIDE };
+	Physics* floor = new Physics(&floorShape, floorData);
+
+	StaticPhysicsData physData;
+	physData.m_gravity = { 0.0f, -9.8f, 0.0f };
+	physData.m_mass = 1.0f;
+	physData.m_inertiaTensor = matrix3(1.0f / 6.0f, 0.0f, 0.0f, 0.0f, 1.0f / 6.0f, 0.0f, 0.0f, 0.0f, 1.0f / 6.0f);
+	physData.m_inverseInertiaTensor = physData.m_inertiaTensor.inv();
+	physData.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+	std::vector<Physics*> boxes;
+	for (int i = 0; i < SIDE * SIDE; i++)
+	{
+		physData.m_initialPosition = { (i % SIDE) * 2.0f + 0.5f, 0.5f, (i / SIDE) * 2.0f + 0.5f };
+		boxes.push_back(new Physics(&box, physData));
+	}
+
+	auto timeSteps = [&]()
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (int step = 0; step < NUM_STEPS; step++)
+		{
+			Physics_Update(DT);
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / NUM_STEPS;
+	};
+
+	PhysicsSolverSettings settings = Physics_GetSolverSettings();
+	const PhysicsSolverSettings oldSettings = settings;
+	settings.allowSleeping = false;
+	Physics_SetSolverSettings(settings);
+	Physics_Update(DT);
+	const double awakeMs = timeSteps();
+
+	settings.allowSleeping = true;
+	Physics_SetSolverSettings(settings);
+	for (int step = 0; step < 60; step++)
+	{
+		Physics_Update(DT);
+	}
+	int asleep = 0;
+	for (Physics* phys : boxes)
+	{
+		asleep += phys->IsSleeping() ? 1 : 0;
+	}
+	const double asleepMs = timeSteps();
+	printf("Resting boxes, %d bodies: %.3f ms/step awake, %.3f ms/step with %d asleep\n", SIDE * SIDE, awakeMs, asleepMs, asleep);
+
+	Physics_SetSolverSettings(oldSettings);
+	for (auto it = boxes.rbegin(); it != boxes.rend(); ++it)
+	{
+		delete *it;
+	}
+	delete floor;
+}
+
+// saving and restoring a world of boxes sitting on the floor, a snapshot a frame as a rollback would take them
+static void BenchmarkSnapshot()
+{
+	constexpr int SIDE = 100;
+	constexpr int NUM_REPEATS = 100;
+	constexpr float DT = 1.0f / 60.0f;
+
+	PhysicsWorld world;
+	BoxPhysicsShape box(1.0f, 1.0f, 1.0f);
+	BoxPhysicsShape floorShape(SIDE * 2.0f, SIDE * 2.0f, 1.0f);
+	StaticPhysicsData floorData;
+	floorData.m_initialPosition = { SIDE, -0.5f, SIDE };
+	world.AddBody(&floorShape, floorData);
+	StaticPhysicsData physData;
+	physData.m_gravity = { 0.0f, -9.8f, 0.0f };
+	physData.m_mass = 1.0f;
+	physData.m_inertiaTensor = matrix3(1.0f / 6.0f, 0.0f, 0.0f, 0.0f, 1.0f / 6.0f, 0.0f, 0.0f, 0.0f, 1.0f / 6.0f);
+	physData.m_inverseInertiaTensor = physData.m_inertiaTensor.inv();
+	physData.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+	for (int i = 0; i < SIDE * SIDE; i++)
+	{
+		physData.m_initialPosition = { (i % SIDE) * 2.0f + 0.5f, 0.5f, (i / SIDE) * 2.0f + 0.5f };
+		world.AddBody(&box, physData);
+	}
+	for (int step = 0; step < 10; step++)
+	{
+		world.Update(DT); // so there are contacts to keep
+	}
+
+	PhysicsSnapshotRing ring(8);
+	ring.Save(world, 0); // the first save into each buffer allocates it
+	double saveMs = 0.0;
+	double restoreMs = 0.0;
+	for (int i = 0; i < NUM_REPEATS; i++)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		ring.Save(world, i);
+		const auto saved = std::chrono::high_resolution_clock::now();
+		ring.Restore(&world, i);
+		const auto end = std::chrono::high_resolution_clock::now();
+		saveMs += std::chrono::duration<double, std::milli>(saved - start).count();
+		restoreMs += std::chrono::duration<double, std::milli>(end - saved).count();
+	}
+	PhysicsSnapshot snapshot;
+	world.SaveSnapshot(&snapshot);
+	printf("Snapshot, %d bodies (%.0f KB): save %.1f us, restore %.1f us\n", world.GetBodyCount(), snapshot.GetSize() / 1024.0,
+	       saveMs * 1000.0 / NUM_REPEATS, restoreMs * 1000.0 / NUM_REPEATS);
+}
+
+void TestBenchmark()
+{
+	BenchmarkStep(BROADPHASE_SWEEP_AND_PRUNE, "sweep and prune");
+	BenchmarkStep(BROADPHASE_AABB_TREE, "aabb tree");
+	BenchmarkStep(BROADPHASE_SPATIAL_HASH, "spatial hash");
+	BenchmarkTreeTick();
+	BenchmarkSleeping();
+	BenchmarkIntegrator();
+	BenchmarkSnapshot();
+	Physics_SetBroadphase(BROADPHASE_SWEEP_AND_PRUNE);
+}
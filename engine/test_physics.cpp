@@ -42,9 +42,13 @@ static void Update(float dt)
 {
     HandleInput(dt);
 
-    if (s_run || s_tickOnce)
+    if (s_run)
     {
-        Physics_Update(dt);
+        Physics_Advance(dt);
+    }
+    else if (s_tickOnce)
+    {
+        Physics_Advance(Physics_GetWorld()->GetStepSettings().fixedDt);
     }
     
     s_tickOnce = false;
@@ -53,13 +57,13 @@ static void Update(float dt)
 static void Draw()
 {
     {
-        matrix4 m = s_circle.m_phys->GetTransform();
+        matrix4 m = s_circle.m_phys->GetInterpolatedTransform();
         m.transpose();
         s_circle.m_shape->Draw(m);
     }
     
     {
-        matrix4 m = s_board.m_phys->GetTransform();
+        matrix4 m = s_board.m_phys->GetInterpolatedTransform();
         m.transpose();
         DrawParams p;
         p.drawType = DrawType_Triangles;
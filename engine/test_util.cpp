@@ -1,5 +1,70 @@
 #include "test.h"
 #include "util.h"
+#include "physics.h"
+#include "physics_shape.h"
+#include "physics_util.h"
+#include "simplex.h"
+#include "broadphase.h"
+#include "aabb_tree.h"
+#include "spatial_hash.h"
+#include "contact_solver.h"
+#include "worker_pool.h"
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <algorithm>
+
+// Count every heap allocation the test program makes, so hot paths can be checked for allocations.
+// Worker threads allocate too, so the count is atomic.
+static std::atomic<size_t> s_allocationCount(0);
+void* operator new(size_t size)
+{
+	++s_allocationCount;
+	if (void* p = malloc(size))
+	{
+		return p;
+	}
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+#ifdef __cpp_aligned_new
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	++s_allocationCount;
+#ifdef _MSC_VER
+	if (void* p = _aligned_malloc(size, (size_t)alignment))
+	{
+		return p;
+	}
+#else
+	void* p = nullptr;
+	if (posix_memalign(&p, max((size_t)alignment, sizeof(void*)), size) == 0)
+	{
+		return p;
+	}
+#endif
+	throw std::bad_alloc();
+}
+void operator delete(void* p, std::align_val_t) noexcept
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(p, alignment);
+}
+#endif
 
 void TestUtil()
 {
@@ -58,4 +123,1386 @@ void TestUtil()
 		vector3 p = a + (b - a) * u + (c - a) * v + (d - a) * w;
 		assert(r == TetrahedronRegion_ABCD && p.magnitude() == 0.0f && u == v && w > u);
 	}
-}
\ No newline at end of file
+
+	// a full narrowphase query (GJK + EPA) should never touch the heap
+	{
+		MeshPhysicsShape sphere;
+		sphere.CreateSphere(5.0f);
+		MeshPhysicsShape board;
+		board.CreateBox(50.f, 50.f, 0.1f);
+		CollisionParams params;
+		params.a = &sphere;
+		params.aTransform.translate({ 0.f, 3.f, 0.f });
+		params.b = &board;
+		CollisionData data;
+		const size_t allocationsBefore = s_allocationCount;
+		bool overlap = DetectCollision(params, true, &data);
+		assert(overlap && data.success);
+		assert(s_allocationCount == allocationsBefore);
+	}
+
+	// analytic shapes answer support queries exactly, in local and world space
+	{
+		SpherePhysicsShape sphere(2.0f);
+		BoxPhysicsShape box(2.f, 4.f, 6.f);
+		CapsulePhysicsShape capsule(1.0f, 4.0f);
+		CylinderPhysicsShape cylinder(1.0f, 4.0f);
+		RoundedPhysicsShape rounded(&box, 1.0f);
+		const matrix4 identity;
+		assert(sphere.GetPointFurthestInDirection({ 0.f, 0.f, -3.f }, identity, true) == vector3(0.f, 0.f, -2.f));
+		assert(box.GetPointFurthestInDirection({ 1.f, -1.f, 1.f }, identity, true) == vector3(1.f, -3.f, 2.f));
+		assert(capsule.GetPointFurthestInDirection({ 0.f, -1.f, 0.f }, identity, true) == vector3(0.f, -3.f, 0.f));
+		assert(cylinder.GetPointFurthestInDirection({ 2.f, 1.f, 0.f }, identity, true) == vector3(1.f, 2.f, 0.f));
+		assert(rounded.GetPointFurthestInDirection({ 1.f, 0.f, 0.f }, identity, true) == vector3(2.f, 3.f, 2.f));
+
+		matrix4 transform;
+		transform.translate({ 0.f, 10.f, 0.f });
+		assert(vector3::Equals(sphere.GetPointFurthestInDirection({ 0.f, 1.f, 0.f }, transform, true), vector3(0.f, 12.f, 0.f), 0.0001f));
+
+		BoxPhysicsShape board(50.f, 50.f, 0.1f);
+		CollisionParams params;
+		params.a = &sphere;
+		params.aTransform.translate({ 0.f, 1.f, 0.f });
+		params.b = &board;
+		CollisionData data;
+		const size_t allocationsBefore = s_allocationCount;
+		bool overlap = DetectCollision(params, true, &data);
+		assert(overlap && data.success);
+		assert(s_allocationCount == allocationsBefore);
+	}
+
+	// EPA should find the exact way out from any tetrahedron around the origin
+	{
+		SpherePhysicsShape sphere(2.0f);
+		BoxPhysicsShape box(3.f, 2.f, 4.f);
+		CollisionParams params;
+		params.a = &sphere;
+		params.aTransform.translate({ 0.f, 2.5f, 0.f });
+		params.b = &box;
+		Simplex simplex;
+		const vector3 dirs[4] = { { 1,1,1 }, { -1,-1,1 }, { -1,1,-1 }, { 1,-1,-1 } };
+		for (int i = 0; i < 4; i++)
+		{
+			SimplexPoint p;
+			p.A = sphere.GetPointFurthestInDirection(dirs[i], params.aTransform, true);
+			p.B = box.GetPointFurthestInDirection(-dirs[i], params.bTransform, true);
+			p.p = p.A - p.B;
+			simplex.verts.push_back(p);
+		}
+		simplex.m_containsOrigin = true;
+		simplex.SetupForEPA();
+		CollisionData data;
+		assert(FindIntersectionPoints(params, simplex, SIMPLEX_MAX_VERTS, true, &data));
+		assert(FloatEquals(data.depth, 1.5f, 0.01f));
+		assert(vector3::Equals(data.penetrationDirection, vector3(0.f, 1.f, 0.f), 0.01f));
+	}
+
+	// a warm-started query should give the same answers as a cold one, whichever way the pair moves
+	{
+		SpherePhysicsShape a(2.0f);
+		BoxPhysicsShape b(4.f, 4.f, 4.f);
+		CollisionParams params;
+		params.a = &a;
+		params.b = &b;
+		params.aTransform.translate({ 10.f, 0.f, 0.f });
+		CollisionCache cache;
+		assert(!DetectCollision(params, true, nullptr, &cache));
+		assert(cache.valid);
+		assert(!DetectCollision(params, true, nullptr, &cache)); // still separated, early-outs on the cached axis
+
+		params.aTransform = matrix4();
+		params.aTransform.translate({ 3.f, 0.f, 0.f });
+		CollisionData data;
+		assert(DetectCollision(params, true, &data, &cache) && data.success);
+		assert(cache.valid);
+
+		params.aTransform = matrix4();
+		params.aTransform.translate({ 0.f, 10.f, 0.f });
+		assert(!DetectCollision(params, true, nullptr, &cache));
+
+		// the cached support vertices are the ones on the cached axis, separated or overlapping
+		MeshPhysicsShape meshA, meshB;
+		meshA.CreateSphere(2.0f);
+		meshB.CreateBox(4.f, 4.f, 4.f);
+		params.a = &meshA;
+		params.b = &meshB;
+		const vector3 offsets[2] = { { 7.f, 2.f, 1.f }, { 2.5f, 1.f, 0.5f } };
+		for (const vector3& offset : offsets)
+		{
+			params.aTransform = matrix4();
+			params.aTransform.rotate(vector3(0.3f, 0.7f, 0.1f));
+			params.aTransform.translate(offset);
+			CollisionCache meshCache;
+			DetectCollision(params, true, &data, &meshCache);
+			assert(meshCache.valid);
+			int a_index = -1, b_index = -1;
+			meshA.GetPointFurthestInDirection(meshCache.axis, params.aTransform, true, &a_index);
+			meshB.GetPointFurthestInDirection(-meshCache.axis, params.bTransform, true, &b_index);
+			const Mesh& a_mesh = meshA.GetSupportMesh();
+			const Mesh& b_mesh = meshB.GetSupportMesh();
+			assert(FloatEquals(meshCache.axis.dot(params.aTransform * a_mesh.m_vertexPos[meshCache.a_index]), meshCache.axis.dot(params.aTransform * a_mesh.m_vertexPos[a_index])));
+			assert(FloatEquals(meshCache.axis.dot(params.bTransform * b_mesh.m_vertexPos[meshCache.b_index]), meshCache.axis.dot(params.bTransform * b_mesh.m_vertexPos[b_index])));
+		}
+	}
+
+	// the batched narrowphase should give exactly the same answers as one query at a time
+	{
+		SpherePhysicsShape sphere(2.0f);
+		BoxPhysicsShape box(3.f, 2.f, 4.f);
+		CapsulePhysicsShape capsule(1.0f, 3.0f);
+		const PhysicsShape* shapes[3] = { &sphere, &box, &capsule };
+		constexpr int NUM_PAIRS = 200;
+		CollisionParams pairs[NUM_PAIRS];
+		for (int i = 0; i < NUM_PAIRS; i++)
+		{
+			pairs[i].a = shapes[i % 3];
+			pairs[i].b = shapes[(i / 3) % 3];
+			pairs[i].aTransform.translate({ (i % 7) * 0.8f - 2.4f, (i % 5) * 0.9f - 1.8f, (i % 11) * 0.5f - 2.5f });
+		}
+		CollisionData batched[NUM_PAIRS];
+		DetectCollisionBatch(pairs, NUM_PAIRS, batched);
+		for (int i = 0; i < NUM_PAIRS; i++)
+		{
+			CollisionData serial;
+			const bool overlap = DetectCollision(pairs[i], true, &serial);
+			assert(batched[i].overlap == overlap && batched[i].success == serial.success);
+			assert(!serial.success || (batched[i].depth == serial.depth && batched[i].penetrationDirection == serial.penetrationDirection));
+		}
+	}
+
+	// the distance query should find the closest features of separated shapes, and stop early past maxDistance
+	{
+		SpherePhysicsShape sphere(2.0f);
+		BoxPhysicsShape box(4.f, 4.f, 4.f);
+		CollisionParams params;
+		params.a = &sphere;
+		params.aTransform.translate({ 10.f, 0.f, 0.f });
+		params.b = &box;
+		DistanceData data;
+		assert(GetClosestPoints(params, true, FLT_MAX, &data));
+		assert(FloatEquals(data.distance, 6.0f, 0.001f));
+		assert(vector3::Equals(data.a_point, vector3(8.f, 0.f, 0.f), 0.001f));
+		assert(vector3::Equals(data.b_point, vector3(2.f, 0.f, 0.f), 0.001f));
+		assert(vector3::Equals(data.normal, vector3(-1.f, 0.f, 0.f), 0.001f));
+
+		// corner to corner
+		BoxPhysicsShape other(2.f, 2.f, 2.f);
+		params.a = &other;
+		params.aTransform = matrix4();
+		params.aTransform.translate({ 4.f, 4.f, 4.f });
+		assert(GetClosestPoints(params, true, FLT_MAX, &data));
+		assert(FloatEquals(data.distance, sqrtf(3.f), 0.001f));
+		assert(vector3::Equals(data.a_point, vector3(3.f, 3.f, 3.f), 0.001f));
+		assert(vector3::Equals(data.b_point, vector3(2.f, 2.f, 2.f), 0.001f));
+
+		assert(!GetClosestPoints(params, true, 1.0f, &data) && !data.overlap);
+		assert(data.distance > 1.0f && data.distance <= sqrtf(3.f) + 0.001f);
+
+		params.aTransform = matrix4();
+		params.aTransform.translate({ 1.f, 1.f, 1.f });
+		assert(!GetClosestPoints(params, true, FLT_MAX, &data) && data.overlap);
+	}
+
+	// a sphere resting in a wide flat box should come out straight up
+	{
+		SpherePhysicsShape sphere(5.0f);
+		BoxPhysicsShape board(50.f, 50.f, 2.f);
+		CollisionParams params;
+		params.a = &sphere;
+		params.b = &board;
+		for (int i = 0; i < 5; i++)
+		{
+			params.aTransform = matrix4();
+			params.aTransform.translate({ 0.f, (float)i, 0.f });
+			CollisionData data;
+			assert(DetectCollision(params, true, &data) && data.success);
+			assert(FloatEquals(data.depth, 6.0f - i, 0.01f));
+		}
+	}
+
+	// a bullet fired at a thin wall should be stopped at the wall, not found on the far side of it
+	{
+		SpherePhysicsShape bullet(0.5f);
+		BoxPhysicsShape wall(0.1f, 10.f, 10.f);
+		SweepParams a = { &bullet, { -5.f, 0.f, 0.f }, quaternion(), { 100.f, 0.f, 0.f }, vector3() };
+		SweepParams b = { &wall, vector3(), quaternion(), vector3(), vector3() };
+		float toi;
+		DistanceData contact;
+		assert(GetTimeOfImpact(a, b, 0.1f, &toi, &contact));
+		assert(FloatEquals(toi, 4.45f / 100.f, CCD_TOLERANCE / 100.f));
+		assert(contact.distance <= CCD_TOLERANCE && vector3::Equals(contact.normal, vector3(1.f, 0.f, 0.f), 0.001f));
+
+		assert(!GetTimeOfImpact(a, b, 0.04f, &toi, &contact)); // doesn't get there this step
+		a.velocity = { -100.f, 0.f, 0.f };
+		assert(!GetTimeOfImpact(a, b, 0.1f, &toi, &contact)); // going the other way
+
+		// spinning in place close to the wall still hits it
+		BoxPhysicsShape plank(0.2f, 0.2f, 4.f);
+		a = { &plank, { -1.5f, 0.f, 0.f }, quaternion(), vector3(), { 0.f, 0.f, 20.f } };
+		assert(GetTimeOfImpact(a, b, 0.1f, &toi, &contact) && toi > 0.0f);
+
+		// and in a world it bounces off the near side, without being left inside the wall or past it,
+		// whatever else is in the world off to one side of its path
+		StaticPhysicsData wallData;
+		StaticPhysicsData bulletData;
+		bulletData.m_mass = 1.f;
+		bulletData.m_elasticity = 1.f;
+		bulletData.m_inertiaTensor = matrix3(0.1f, 0.f, 0.f, 0.f, 0.1f, 0.f, 0.f, 0.f, 0.1f);
+		bulletData.m_inverseInertiaTensor = bulletData.m_inertiaTensor.inv();
+		bulletData.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+		bulletData.m_continuousCollision = true;
+		PhysicsWorld world;
+		world.AddBody(&wall, wallData);
+		for (int i = 0; i < 20; i++)
+		{
+			bulletData.m_initialPosition = { -5.f + i, 0.f, 30.f };
+			world.AddBody(&bullet, bulletData);
+		}
+		bulletData.m_initialPosition = { -5.f, 0.f, 0.f };
+		const PhysicsHandle shot = world.AddBody(&bullet, bulletData);
+		bulletData.m_elasticity = 0.f; // and one that stops dead against it
+		bulletData.m_initialPosition = { -5.f, 3.f, 0.f };
+		const PhysicsHandle stopped = world.AddBody(&bullet, bulletData);
+		world.ApplyImpulse(shot, { 100.f, 0.f, 0.f }, world.GetPosition(shot));
+		world.ApplyImpulse(stopped, { 100.f, 0.f, 0.f }, world.GetPosition(stopped));
+		world.Update(0.1f);
+		assert(world.GetPosition(stopped).x < -0.55f + 0.25f * CCD_TOLERANCE && world.GetPosition(stopped).x > -0.55f - 2.f * CCD_TOLERANCE);
+		for (int step = 0; step < 5; step++)
+		{
+			assert(world.GetPosition(shot).x < -0.55f && world.GetPosition(stopped).x < -0.55f + CCD_TOLERANCE);
+			world.Update(0.1f);
+		}
+		assert(world.GetLinearVelocity(shot).x < 0.f);
+
+		// one that's swept every step still gets pushed back out when it starts the step inside the wall
+		PhysicsWorld sunkWorld;
+		sunkWorld.AddBody(&wall, wallData);
+		bulletData.m_initialPosition = { -0.45f, 0.f, 0.f };
+		const PhysicsHandle sunk = sunkWorld.AddBody(&bullet, bulletData);
+		for (int step = 0; step < 10; step++)
+		{
+			sunkWorld.Update(1.f / 60.f);
+		}
+		assert(sunkWorld.GetPosition(sunk).x < -0.5f);
+	}
+
+	// every broadphase should find exactly the pairs a brute force test does, report what changed, and answer queries
+	for (int type = 0; type < 3; type++)
+	{
+		unsigned int seed = 777;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24); };
+		constexpr int NUM_BOXES = 200;
+		aabb boxes[NUM_BOXES];
+		int proxies[NUM_BOXES];
+		AABBTree* tree = (type == 1) ? new AABBTree() : nullptr;
+		Broadphase* broadphase = tree ? (Broadphase*)tree : (type == 2) ? (Broadphase*)new SpatialHashGrid() : new SweepAndPrune();
+		for (int i = 0; i < NUM_BOXES; i++)
+		{
+			const vector3 p = vector3(random(), random(), random()) * 20.0f;
+			boxes[i] = { p, p + vector3(random(), random(), random()) * 2.0f + vector3(0.5f) };
+			if (i == 1)
+			{
+				boxes[i].upper = boxes[i].upper + vector3(15.0f, 0.0f, 15.0f); // a floor, too big for the hash grid's cells
+			}
+			proxies[i] = broadphase->AddProxy(boxes[i], &boxes[i]);
+		}
+
+		std::vector<BroadphasePair> previous;
+		for (int frame = 0; frame < 10; frame++)
+		{
+			if (frame == 5)
+			{
+				broadphase->RemoveProxy(proxies[0]);
+				proxies[0] = -1;
+			}
+			for (int i = 0; i < NUM_BOXES; i++)
+			{
+				if ((i + frame) % 3 == 0)
+				{
+					continue; // some sit still
+				}
+				// mostly small moves that stay inside the tree's margins, some big ones that don't
+				const float scale = (i % 7 == 0) ? 3.0f : 0.1f;
+				const vector3 move = (vector3(random(), random(), random()) - vector3(0.5f)) * scale;
+				boxes[i] = { boxes[i].lower + move, boxes[i].upper + move };
+				if (proxies[i] >= 0)
+				{
+					broadphase->MoveProxy(proxies[i], boxes[i]);
+				}
+			}
+			broadphase->Update();
+			if (tree)
+			{
+				tree->Validate();
+			}
+
+			std::vector<BroadphasePair> expected;
+			for (int i = 0; i < NUM_BOXES; i++)
+			{
+				for (int j = i + 1; j < NUM_BOXES; j++)
+				{
+					if (proxies[i] >= 0 && proxies[j] >= 0 && boxes[i].Overlaps(boxes[j]))
+					{
+						expected.push_back({ min(proxies[i], proxies[j]), max(proxies[i], proxies[j]) });
+					}
+				}
+			}
+			std::sort(expected.begin(), expected.end());
+			assert(broadphase->GetPairs() == expected);
+
+			// last frame's pairs + added - removed = this frame's pairs
+			const std::vector<BroadphasePair>& removed = broadphase->GetRemovedPairs();
+			std::vector<BroadphasePair> rebuilt;
+			for (const BroadphasePair& pair : previous)
+			{
+				if (std::find(removed.begin(), removed.end(), pair) == removed.end())
+				{
+					rebuilt.push_back(pair);
+				}
+			}
+			rebuilt.insert(rebuilt.end(), broadphase->GetAddedPairs().begin(), broadphase->GetAddedPairs().end());
+			std::sort(rebuilt.begin(), rebuilt.end());
+			assert(rebuilt == expected);
+			previous = expected;
+
+			// queries see the same boxes
+			const vector3 corner = vector3(random(), random(), random()) * 20.0f;
+			const aabb region = { corner, corner + vector3(5.0f) };
+			const vector3 from = vector3(random(), random(), random()) * 20.0f;
+			const vector3 to = vector3(random(), random(), random()) * 20.0f;
+			std::vector<int> found, foundRay, expectedFound, expectedRay;
+			broadphase->Query(region, [](int proxy, void* userData) { ((std::vector<int>*)userData)->push_back(proxy); return true; }, &found);
+			broadphase->RayCast(from, to, [](int proxy, float maxFraction, void* userData) { ((std::vector<int>*)userData)->push_back(proxy); return maxFraction; }, &foundRay);
+			for (int i = 0; i < NUM_BOXES; i++)
+			{
+				if (proxies[i] >= 0 && boxes[i].Overlaps(region))
+				{
+					expectedFound.push_back(proxies[i]);
+				}
+				if (proxies[i] >= 0 && boxes[i].IntersectsSegment(from, to, 1.0f))
+				{
+					expectedRay.push_back(proxies[i]);
+				}
+			}
+			std::sort(found.begin(), found.end());
+			std::sort(foundRay.begin(), foundRay.end());
+			std::sort(expectedFound.begin(), expectedFound.end());
+			std::sort(expectedRay.begin(), expectedRay.end());
+			assert(found == expectedFound && foundRay == expectedRay);
+		}
+		delete broadphase;
+	}
+
+	// the hash grid sizes its cells from the boxes that go in them, a floor kept on its own list doesn't stretch them
+	{
+		SpatialHashGrid grid;
+		for (int i = 0; i < 20; i++)
+		{
+			grid.AddProxy({ vector3(i * 2.f, 0.f, 0.f), vector3(i * 2.f + 1.f, 1.f, 1.f) }, nullptr);
+		}
+		grid.AddProxy({ vector3(-500.f, -1.f, -500.f), vector3(500.f, 0.5f, 500.f) }, nullptr);
+		grid.Update();
+		assert(grid.GetCellSize() == 1.f && grid.GetPairs().size() == 20);
+	}
+
+	// ray and region queries against objects in the sim, through every broadphase
+	const BROADPHASE_TYPE broadphaseTypes[] = { BROADPHASE_SWEEP_AND_PRUNE, BROADPHASE_AABB_TREE, BROADPHASE_SPATIAL_HASH };
+	for (BROADPHASE_TYPE type : broadphaseTypes)
+	{
+		Physics_SetBroadphase(type);
+		SpherePhysicsShape sphere(2.0f);
+		BoxPhysicsShape box(2.f, 2.f, 2.f);
+		StaticPhysicsData data;
+		data.m_initialPosition = { 10.f, 0.f, 0.f };
+		Physics* a = new Physics(&sphere, data);
+		data.m_initialPosition = { 20.f, 0.f, 0.f };
+		Physics* b = new Physics(&box, data);
+
+		float fraction;
+		assert(Physics_RayCast({ 0.f, 0.f, 0.f }, { 30.f, 0.f, 0.f }, &fraction) == a);
+		assert(FloatEquals(fraction * 30.f, 8.f, CCD_TOLERANCE));
+		assert(Physics_RayCast({ 30.f, 0.f, 0.f }, { 0.f, 0.f, 0.f }, &fraction) == b);
+		assert(FloatEquals(fraction * 30.f, 9.f, CCD_TOLERANCE));
+		assert(Physics_RayCast({ 0.f, 5.f, 0.f }, { 30.f, 5.f, 0.f }) == nullptr);
+
+		std::vector<Physics*> found;
+		Physics_QueryAABB({ { 15.f, -1.f, -1.f }, { 25.f, 1.f, 1.f } }, &found);
+		assert(found.size() == 1 && found[0] == b);
+
+		delete b;
+		delete a;
+	}
+	Physics_SetBroadphase(BROADPHASE_SWEEP_AND_PRUNE);
+
+	// switching broadphase lets go of the pairs the old one hadn't reported yet the same way Update would have,
+	// so a box asleep on a platform that's just been removed still wakes up and falls
+	{
+		BoxPhysicsShape box(1.f, 1.f, 1.f);
+		BoxPhysicsShape platformShape(4.f, 4.f, 1.f);
+		StaticPhysicsData platformData;
+		platformData.m_initialPosition = { 0.f, -0.5f, 0.f };
+		StaticPhysicsData data;
+		data.m_gravity = { 0.f, -9.8f, 0.f };
+		data.m_initialPosition = { 0.f, 0.5f, 0.f };
+		data.m_mass = 1.0f;
+		data.m_inertiaTensor = matrix3(1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f);
+		data.m_inverseInertiaTensor = data.m_inertiaTensor.inv();
+		data.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+		PhysicsWorld world;
+		const PhysicsHandle platform = world.AddBody(&platformShape, platformData);
+		const PhysicsHandle resting = world.AddBody(&box, data);
+		for (int step = 0; step < 120; step++)
+		{
+			world.Update(1.0f / 60.0f);
+		}
+		assert(world.IsSleeping(resting));
+		world.RemoveBody(platform);
+		world.SetBroadphase(BROADPHASE_AABB_TREE);
+		assert(!world.IsSleeping(resting));
+		const float y = world.GetPosition(resting).y;
+		world.Update(1.0f / 60.0f);
+		assert(world.GetPosition(resting).y < y);
+	}
+
+	// the cached transform and bounds follow the object, whether it moves by itself or gets moved
+	{
+		BoxPhysicsShape box(2.f, 2.f, 2.f);
+		StaticPhysicsData data;
+		data.m_mass = 1.0f;
+		data.m_gravity = { 0.f, -10.f, 0.f };
+		data.m_inverseInertiaTensor = matrix3(1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f);
+		Physics* phys = new Physics(&box, data);
+		assert(FloatEquals(phys->GetWorldAABB().lower.y, -1.f));
+
+		phys->Update(0.1f);
+		matrix4 expected;
+		expected.translate(phys->GetPosition());
+		expected.rotate(phys->GetRotation());
+		assert(phys->GetTransform().translation_get() == expected.translation_get());
+		assert(phys->GetPosition().y < 0.f && FloatEquals(phys->GetWorldAABB().upper.y, phys->GetPosition().y + 1.f));
+
+		phys->SetPosition({ 5.f, 0.f, 0.f });
+		assert(phys->GetTransform().translation_get() == vector3(5.f, 0.f, 0.f));
+		assert(FloatEquals(phys->GetWorldAABB().lower.x, 4.f) && FloatEquals(phys->GetWorldAABB().upper.x, 6.f));
+
+		std::vector<Physics*> found;
+		Physics_QueryAABB({ { 4.5f, -0.5f, -0.5f }, { 5.5f, 0.5f, 0.5f } }, &found);
+		assert(found.empty()); // the broadphase hears about it on the next step
+		phys->UpdateBroadphase();
+		Physics_QueryAABB({ { 4.5f, -0.5f, -0.5f }, { 5.5f, 0.5f, 0.5f } }, &found);
+		assert(found.size() == 1 && found[0] == phys);
+		delete phys;
+	}
+
+	// the narrowphase says where they touch: the bottom of the sphere and the top of the board
+	{
+		SpherePhysicsShape sphere(5.0f);
+		BoxPhysicsShape board(50.f, 50.f, 2.f);
+		CollisionParams params;
+		params.a = &sphere;
+		params.b = &board;
+		params.aTransform.translate({ 3.f, 5.5f, -2.f });
+		CollisionData data;
+		assert(DetectCollision(params, true, &data) && data.success);
+		assert(vector3::Equals(data.penetrationDirection, vector3(0.f, 1.f, 0.f), 0.01f));
+		// EPA's face is only a flat approximation of the sphere, the point can be off to the side a little
+		assert(vector3::Equals(data.a_point, vector3(3.f, 0.5f, -2.f), 0.05f) && FloatEquals(data.a_point.y, 0.5f, 0.01f));
+		assert(vector3::Equals(data.b_point, vector3(3.f, 1.0f, -2.f), 0.05f) && FloatEquals(data.b_point.y, 1.0f, 0.01f));
+	}
+
+	// islands: bodies that touch are solved together, touching the same static body doesn't count
+	{
+		SolverBody bodies[5];
+		for (int i = 0; i < 4; i++)
+		{
+			bodies[i].invMass = 1.0f;
+			bodies[i].invInertia = matrix3();
+		}
+		const int pairs[4][2] = { { 0, 1 }, { 2, 4 }, { 1, 4 }, { 3, 4 } };
+		ContactManifold manifolds[4];
+		ContactManifold* manifoldList[4];
+		for (int i = 0; i < 4; i++)
+		{
+			manifolds[i].bodyA = pairs[i][0];
+			manifolds[i].bodyB = pairs[i][1];
+			manifolds[i].normal = { 0.f, 1.f, 0.f };
+			manifolds[i].numPoints = 1;
+			manifoldList[i] = &manifolds[i];
+		}
+		ContactSolver solver;
+		solver.Solve(bodies, 5, manifoldList, 4, 1.0f / 60.0f, Physics_GetSolverSettings());
+		const std::vector<ContactIsland>& islands = solver.GetIslands();
+		assert(islands.size() == 3 && bodies[4].island == -1);
+		assert(bodies[0].island == 0 && bodies[1].island == 0 && bodies[2].island == 1 && bodies[3].island == 2);
+		assert(islands[0].numBodies == 2 && islands[0].numManifolds == 2);
+		assert(islands[1].numBodies == 1 && islands[1].numManifolds == 1);
+		assert(solver.GetIslandBody(islands[0].firstBody) == 0 && solver.GetIslandBody(islands[0].firstBody + 1) == 1);
+	}
+
+	// a stack of boxes should settle and stay put, and friction should hold a box on a slope
+	// it's steep enough to slide down without (and slow down one that's slippery, by the right amount)
+	{
+		auto makeBody = [](const vector3& position, const vector3& rotation, float friction)
+		{
+			StaticPhysicsData data;
+			data.m_gravity = { 0.f, -9.8f, 0.f };
+			data.m_initialPosition = position;
+			data.m_initialRotation = rotation;
+			data.m_mass = 1.0f;
+			data.m_staticFrictionCoeff = friction;
+			data.m_dynamicFrictionCoeff = friction;
+			data.m_momentOfInertia = 1.0f / 6.0f;
+			data.m_inertiaTensor = matrix3(1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f);
+			data.m_inverseInertiaTensor = data.m_inertiaTensor.inv();
+			data.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+			return data;
+		};
+		BoxPhysicsShape box(1.f, 1.f, 1.f);
+		BoxPhysicsShape floorShape(40.f, 40.f, 1.f);
+		StaticPhysicsData floorData;
+		floorData.m_initialPosition = { 0.f, -0.5f, 0.f };
+
+		{
+			Physics floor(&floorShape, floorData);
+			std::vector<Physics*> stack;
+			for (int i = 0; i < 5; i++)
+			{
+				stack.push_back(new Physics(&box, makeBody({ 0.f, 0.5f + i, 0.f }, vector3(), 0.5f)));
+			}
+			for (int step = 0; step < 180; step++)
+			{
+				Physics_Update(1.0f / 60.0f);
+			}
+			for (int i = 0; i < 5; i++)
+			{
+				const vector3 p = stack[i]->GetPosition();
+				assert(fabsf(p.x) < 0.01f && fabsf(p.z) < 0.01f && p.y < 0.5f + i && p.y > 0.5f + i - 0.05f);
+				assert(fabsf(stack[i]->GetRotation().w) > cosf(0.005f) && stack[i]->GetLinearVelocity().magnitude() < 0.05f); // turned less than 0.01 rad
+			}
+			for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+			{
+				delete *it;
+			}
+		}
+
+		{
+			const float angle = 0.3f;
+			floorData.m_initialRotation = { 0.f, 0.f, angle };
+			Physics floor(&floorShape, floorData);
+			const vector3 up = { -sinf(angle), cosf(angle), 0.f };
+			Physics* grippy = new Physics(&box, makeBody(up * 0.5f + vector3(0.f, 0.f, -3.f), { 0.f, 0.f, angle }, 0.6f));
+			Physics* slippery = new Physics(&box, makeBody(up * 0.5f + vector3(0.f, 0.f, 3.f), { 0.f, 0.f, angle }, 0.1f));
+			const vector3 grippyStart = grippy->GetPosition();
+			const vector3 slipperyStart = slippery->GetPosition();
+			for (int step = 0; step < 120; step++)
+			{
+				Physics_Update(1.0f / 60.0f);
+			}
+			const float expected = 0.5f * 9.8f * (sinf(angle) - 0.1f * cosf(angle)) * 2.0f * 2.0f;
+			assert((grippy->GetPosition() - grippyStart).magnitude() < 0.05f);
+			assert(FloatEquals((slippery->GetPosition() - slipperyStart).magnitude(), expected, 0.1f * expected));
+			delete slippery;
+			delete grippy;
+		}
+	}
+
+	// a settled stack goes to sleep as a whole and stops moving, anything landing on it wakes all of it
+	{
+		auto makeBody = [](const vector3& position)
+		{
+			StaticPhysicsData data;
+			data.m_gravity = { 0.f, -9.8f, 0.f };
+			data.m_initialPosition = position;
+			data.m_mass = 1.0f;
+			data.m_staticFrictionCoeff = 0.5f;
+			data.m_dynamicFrictionCoeff = 0.5f;
+			data.m_inertiaTensor = matrix3(1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f);
+			data.m_inverseInertiaTensor = data.m_inertiaTensor.inv();
+			data.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+			return data;
+		};
+		BoxPhysicsShape box(1.f, 1.f, 1.f);
+		BoxPhysicsShape floorShape(40.f, 40.f, 1.f);
+		StaticPhysicsData floorData;
+		floorData.m_initialPosition = { 0.f, -0.5f, 0.f };
+		Physics floor(&floorShape, floorData);
+		std::vector<Physics*> stack;
+		for (int i = 0; i < 3; i++)
+		{
+			stack.push_back(new Physics(&box, makeBody({ 0.f, 0.5f + i, 0.f })));
+		}
+		Physics* loner = new Physics(&box, makeBody({ 10.f, 0.5f, 0.f }));
+
+		// never, if it's not allowed
+		PhysicsSolverSettings settings = Physics_GetSolverSettings();
+		settings.allowSleeping = false;
+		Physics_SetSolverSettings(settings);
+		for (int step = 0; step < 120; step++)
+		{
+			Physics_Update(1.0f / 60.0f);
+		}
+		assert(!loner->IsSleeping() && !stack[0]->IsSleeping());
+		settings.allowSleeping = true;
+		Physics_SetSolverSettings(settings);
+
+		for (int step = 0; step < 60; step++)
+		{
+			Physics_Update(1.0f / 60.0f);
+		}
+		std::vector<vector3> positions;
+		for (Physics* phys : stack)
+		{
+			assert(phys->IsSleeping());
+			positions.push_back(phys->GetPosition());
+		}
+		assert(loner->IsSleeping());
+		for (int step = 0; step < 60; step++)
+		{
+			Physics_Update(1.0f / 60.0f);
+		}
+		for (size_t i = 0; i < stack.size(); i++)
+		{
+			assert(stack[i]->IsSleeping() && stack[i]->GetPosition() == positions[i] && stack[i]->GetLinearVelocity().IsNone());
+		}
+
+		// landing on the top box wakes the bottom one too, but not the one off on its own
+		Physics* dropped = new Physics(&box, makeBody({ 0.f, 4.f, 0.f }));
+		bool woken = false;
+		for (int step = 0; step < 60 && !woken; step++)
+		{
+			Physics_Update(1.0f / 60.0f);
+			woken = !stack[2]->IsSleeping();
+		}
+		assert(woken && !stack[0]->IsSleeping() && !stack[1]->IsSleeping() && loner->IsSleeping());
+
+		// so does a push
+		loner->ApplyImpulse({ 3.f, 0.f, 0.f }, loner->GetPosition());
+		assert(!loner->IsSleeping());
+		const float x = loner->GetPosition().x;
+		Physics_Update(1.0f / 60.0f);
+		assert(loner->GetPosition().x > x);
+
+		delete dropped;
+		delete loner;
+		for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+		{
+			delete *it;
+		}
+	}
+
+	// something static put somewhere by hand wakes what was resting on it and what it's been put under
+	{
+		BoxPhysicsShape box(1.f, 1.f, 1.f);
+		BoxPhysicsShape floorShape(4.f, 4.f, 1.f);
+		StaticPhysicsData floorData;
+		floorData.m_initialPosition = { 0.f, -0.5f, 0.f };
+		StaticPhysicsData data;
+		data.m_gravity = { 0.f, -9.8f, 0.f };
+		data.m_initialPosition = { 0.f, 0.5f, 0.f };
+		data.m_mass = 1.0f;
+		data.m_inertiaTensor = matrix3(1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f);
+		data.m_inverseInertiaTensor = data.m_inertiaTensor.inv();
+		data.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+		PhysicsWorld world;
+		const PhysicsHandle floor = world.AddBody(&floorShape, floorData);
+		const PhysicsHandle resting = world.AddBody(&box, data);
+		floorData.m_initialPosition = { 20.f, 0.f, 0.f };
+		const PhysicsHandle platform = world.AddBody(&box, floorData);
+		auto settle = [&]()
+		{
+			for (int step = 0; step < 120 && !world.IsSleeping(resting); step++)
+			{
+				world.Update(1.0f / 60.0f);
+			}
+			assert(world.IsSleeping(resting));
+		};
+		settle();
+		world.SetPosition(platform, { 0.f, 0.4f, 0.f });
+		assert(!world.IsSleeping(resting));
+		settle();
+		world.SetPosition(platform, { 20.f, 0.f, 0.f });
+		world.SetPosition(floor, { 20.f, -10.f, 0.f });
+		assert(!world.IsSleeping(resting));
+		const float y = world.GetPosition(resting).y;
+		world.Update(1.0f / 60.0f);
+		assert(world.GetPosition(resting).y < y);
+	}
+
+	// worlds: handles outlive the body they point at without reaching whatever takes its slot, removal keeps
+	// the rest where they were, and two worlds don't see each other
+	{
+		SpherePhysicsShape sphere(0.5f);
+		StaticPhysicsData data;
+		data.m_mass = 1.0f;
+		data.m_gravity = { 0.f, -9.8f, 0.f };
+		data.m_inverseInertiaTensor = matrix3(1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f);
+		data.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+
+		PhysicsWorld world;
+		PhysicsHandle handles[4];
+		for (int i = 0; i < 4; i++)
+		{
+			data.m_initialPosition = { i * 10.f, 0.f, 0.f };
+			handles[i] = world.AddBody(&sphere, data);
+		}
+		world.RemoveBody(handles[1]);
+		assert(world.GetBodyCount() == 3 && !world.IsValid(handles[1]));
+		for (int i : { 0, 2, 3 })
+		{
+			assert(world.IsValid(handles[i]) && world.GetPosition(handles[i]) == vector3(i * 10.f, 0.f, 0.f));
+		}
+		data.m_initialPosition = { 50.f, 0.f, 0.f };
+		const PhysicsHandle reused = world.AddBody(&sphere, data);
+		assert(reused.index == handles[1].index && reused != handles[1] && !world.IsValid(handles[1]));
+
+		std::vector<PhysicsHandle> found;
+		world.QueryAABB({ { 19.f, -1.f, -1.f }, { 51.f, 1.f, 1.f } }, &found);
+		assert(found.size() == 3);
+		float fraction;
+		assert(world.RayCast({ 45.f, 0.f, 0.f }, { 60.f, 0.f, 0.f }, &fraction) == reused);
+
+		// a body in the default world is on its own over there
+		data.m_initialPosition = { 0.f, 0.f, 0.f };
+		Physics* other = new Physics(&sphere, data);
+		assert(other->GetWorld() == Physics_GetWorld() && other->GetWorld()->GetBodyCount() == 1);
+		data.m_initialPosition = { -10.f, 0.f, 0.f };
+		Physics mine(&sphere, data, &world);
+		assert(mine.GetWorld() == &world && world.GetBodyCount() == 5);
+		for (int step = 0; step < 10; step++)
+		{
+			world.Update(1.0f / 60.0f);
+		}
+		assert(other->GetPosition().IsNone() && mine.GetPosition().y < 0.f);
+		assert(world.GetPosition(handles[0]).y == mine.GetPosition().y); // both falling, with nothing to land on
+		delete other;
+		assert(Physics_GetWorld()->GetBodyCount() == 0);
+	}
+
+	// orientation: quaternions agree with the euler angles they're made from, spin turns them about the
+	// world axis whichever way up they started, and the inertia turns with the body
+	{
+		unsigned int seed = 12345;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24) * 2.0f - 1.0f; };
+		for (int i = 0; i < 100; i++)
+		{
+			const vector3 euler = vector3(random(), random(), random()) * 3.f;
+			matrix4 expected;
+			expected.rotate(euler);
+			matrix4 fromQuaternion;
+			fromQuaternion.rotate(quaternion::from_euler(euler.x, euler.y, euler.z));
+			const vector3 v = vector3(random(), random(), random());
+			assert(vector3::Equals(expected * v, fromQuaternion * v, 0.0001f));
+		}
+
+		SpherePhysicsShape sphere(0.5f);
+		BoxPhysicsShape box(1.f, 2.f, 3.f);
+		StaticPhysicsData data;
+		data.m_mass = 1.0f;
+		data.m_inertiaTensor = matrix3(1.f, 0.f, 0.f, 0.f, 2.f, 0.f, 0.f, 0.f, 4.f);
+		data.m_inverseInertiaTensor = data.m_inertiaTensor.inv();
+		data.m_initialRotation = { 0.5f * PI, 0.f, 0.f };
+		PhysicsWorld world;
+		const PhysicsHandle turned = world.AddBody(&box, data);
+		data.m_inertiaTensor = matrix3(2.f, 0.f, 0.f, 0.f, 2.f, 0.f, 0.f, 0.f, 2.f);
+		data.m_inverseInertiaTensor = data.m_inertiaTensor.inv();
+		data.m_initialPosition = { 10.f, 0.f, 0.f };
+		const PhysicsHandle spinner = world.AddBody(&sphere, data);
+
+		// the body's z axis (the heaviest way to turn) points down world y after the quarter turn about x,
+		// so spinning it about world y takes four times the angular momentum it would about world x
+		world.ApplyImpulse(turned, { 0.f, 0.f, 1.f }, world.GetPosition(turned) + vector3(1.f, 0.f, 0.f)); // L = (0, -1, 0)
+		assert(vector3::Equals(world.GetAngularVelocity(turned), { 0.f, -0.25f, 0.f }, 0.0001f));
+
+		// spun about world y for a second at 1 rad/s, the first order step only loses a little
+		world.ApplyImpulse(spinner, { 0.f, 0.f, 2.f }, world.GetPosition(spinner) + vector3(-1.f, 0.f, 0.f)); // L = (0, 2, 0)
+		assert(vector3::Equals(world.GetAngularVelocity(spinner), { 0.f, 1.f, 0.f }, 0.0001f));
+		for (int step = 0; step < 60; step++)
+		{
+			world.Update(1.0f / 60.0f);
+		}
+		const quaternion expected = quaternion::from_axis_angle(0.f, 1.f, 0.f, 1.f) * quaternion::from_euler(0.5f * PI, 0.f, 0.f);
+		const quaternion q = world.GetRotation(spinner);
+		assert(fabsf(fabsf(q.x * expected.x + q.y * expected.y + q.z * expected.z + q.w * expected.w) - 1.f) < 0.0001f);
+
+		// big steps stay unit length and keep turning about the same axis
+		for (int step = 0; step < 100; step++)
+		{
+			world.Update(0.25f);
+		}
+		const quaternion spun = world.GetRotation(spinner) * quaternion::from_euler(0.5f * PI, 0.f, 0.f).inverse();
+		assert(FloatEquals(world.GetRotation(spinner).magnitude(), 1.f, 0.0001f) && fabsf(spun.x) < 0.0001f && fabsf(spun.z) < 0.0001f);
+
+		// set up with only the inverse tensor, it keeps spinning on a frictionless floor through the contact solver
+		BoxPhysicsShape floorShape(20.f, 20.f, 1.f);
+		StaticPhysicsData floorData;
+		floorData.m_initialPosition = { 0.f, -0.5f, 0.f };
+		StaticPhysicsData inverseOnly;
+		inverseOnly.m_gravity = { 0.f, -9.8f, 0.f };
+		inverseOnly.m_mass = 1.0f;
+		inverseOnly.m_inverseInertiaTensor = matrix3(0.5f, 0.f, 0.f, 0.f, 0.5f, 0.f, 0.f, 0.f, 0.5f);
+		inverseOnly.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+		inverseOnly.m_initialPosition = { 0.f, 0.5f, 0.f };
+		PhysicsWorld floorWorld;
+		floorWorld.AddBody(&floorShape, floorData);
+		const PhysicsHandle top = floorWorld.AddBody(&sphere, inverseOnly);
+		floorWorld.ApplyImpulse(top, { 0.f, 0.f, 1.f }, floorWorld.GetPosition(top) + vector3(-1.f, 0.f, 0.f)); // L = (0, 1, 0)
+		floorWorld.ApplyImpulse(top, { 0.f, 0.f, -1.f }, floorWorld.GetPosition(top) + vector3(1.f, 0.f, 0.f)); // and again, without pushing it along
+		for (int step = 0; step < 30; step++)
+		{
+			floorWorld.Update(1.0f / 60.0f);
+		}
+		assert(vector3::Equals(floorWorld.GetAngularVelocity(top), { 0.f, 1.f, 0.f }, 0.01f));
+	}
+
+	// fixed timestep: the same time in different sized frames runs the same steps and ends up in the same place,
+	// the leftover time interpolates, and a long frame only runs maxSubsteps
+	{
+		SpherePhysicsShape sphere(0.5f);
+		BoxPhysicsShape floorShape(20.f, 20.f, 1.f);
+		StaticPhysicsData floorData;
+		floorData.m_initialPosition = { 0.f, -0.5f, 0.f };
+		StaticPhysicsData ballData;
+		ballData.m_gravity = { 0.f, -9.8f, 0.f };
+		ballData.m_mass = 1.f;
+		ballData.m_elasticity = 0.5f;
+		ballData.m_inertiaTensor = matrix3(0.1f, 0.f, 0.f, 0.f, 0.1f, 0.f, 0.f, 0.f, 0.1f);
+		ballData.m_inverseInertiaTensor = ballData.m_inertiaTensor.inv();
+		ballData.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+		ballData.m_initialPosition = { 0.f, 3.f, 0.f };
+
+		PhysicsStepSettings stepSettings;
+		stepSettings.fixedDt = 1.0f / 64.0f; // and frames in 64ths too, so the sums come out exact
+		PhysicsWorld worlds[2];
+		PhysicsHandle balls[2];
+		for (int w = 0; w < 2; w++)
+		{
+			worlds[w].SetStepSettings(stepSettings);
+			worlds[w].AddBody(&floorShape, floorData);
+			balls[w] = worlds[w].AddBody(&sphere, ballData);
+			worlds[w].ApplyImpulse(balls[w], { 1.f, 0.f, 0.5f }, worlds[w].GetPosition(balls[w]) + vector3(0.f, 0.1f, 0.f));
+		}
+		int steps[2] = { 0, 0 };
+		for (int frame = 0; frame < 128; frame++)
+		{
+			steps[0] += worlds[0].Advance(1.0f / 64.0f);
+		}
+		for (int frame = 0; frame < 64; frame++)
+		{
+			steps[1] += worlds[1].Advance((frame % 2) ? 3.0f / 64.0f : 1.0f / 64.0f);
+		}
+		assert(steps[0] == 128 && steps[1] == 128);
+		const vector3 position[2] = { worlds[0].GetPosition(balls[0]), worlds[1].GetPosition(balls[1]) };
+		const quaternion rotation[2] = { worlds[0].GetRotation(balls[0]), worlds[1].GetRotation(balls[1]) };
+		assert(memcmp(&position[0], &position[1], sizeof(vector3)) == 0 && memcmp(&rotation[0], &rotation[1], sizeof(quaternion)) == 0);
+		assert(position[0].y > 0.4f && position[0].y < 3.f); // landed on the floor rather than falling past it
+
+		// half a step on, it's drawn half way through the last step
+		PhysicsWorld& world = worlds[0];
+		const PhysicsHandle ball = balls[0];
+		const vector3 before = world.GetPosition(ball);
+		assert(world.Advance(0.5f / 64.0f) == 0 && world.Advance(1.0f / 64.0f) == 1);
+		assert(FloatEquals(world.GetInterpolationAlpha(), 0.5f, 0.0001f));
+		const vector3 halfway = (before + world.GetPosition(ball)) * 0.5f;
+		assert(vector3::Equals(world.GetInterpolatedTransform(ball).translation_get(), halfway, 0.0001f));
+
+		// a second's stall runs maxSubsteps and drops the rest, rather than trying to catch up
+		assert(world.Advance(1.0f) == stepSettings.maxSubsteps);
+		assert(FloatEquals(world.GetDroppedTime(), (64 - stepSettings.maxSubsteps) / 64.0f, 0.0001f));
+		assert(FloatEquals(world.GetInterpolationAlpha(), 0.5f, 0.0001f));
+	}
+
+	// deterministic maths: the software trig is as good as the C library's, worlds that are given the same things
+	// to do hash the same after every step, and a world that's a bit different hashes differently
+	{
+		for (int i = 0; i <= 20000; i++)
+		{
+			const float x = (i - 10000) * 0.01f;
+			const float y = (i % 201 - 100) * 0.1f;
+			float s, c;
+			Math_SoftSinCos(x, &s, &c);
+			assert(fabs(s - sin((double)x)) < 2e-7 && fabs(c - cos((double)x)) < 2e-7);
+			assert(fabs(Math_SoftAtan2(y, x) - atan2((double)y, (double)x)) < 5e-7);
+		}
+
+		SpherePhysicsShape sphere(0.5f);
+		BoxPhysicsShape box(1.f, 1.f, 1.f);
+		BoxPhysicsShape floorShape(20.f, 20.f, 1.f);
+		StaticPhysicsData floorData;
+		floorData.m_initialPosition = { 0.f, -0.5f, 0.f };
+		StaticPhysicsData data;
+		data.m_gravity = { 0.f, -9.8f, 0.f };
+		data.m_mass = 1.f;
+		data.m_elasticity = 0.3f;
+		data.m_staticFrictionCoeff = 0.5f;
+		data.m_dynamicFrictionCoeff = 0.3f;
+		data.m_inertiaTensor = matrix3(1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f);
+		data.m_inverseInertiaTensor = data.m_inertiaTensor.inv();
+		data.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+		PhysicsWorld worlds[2];
+		for (PhysicsWorld& world : worlds)
+		{
+			world.AddBody(&floorShape, floorData);
+			for (int i = 0; i < 16; i++)
+			{
+				data.m_initialPosition = { (i % 4) * 1.2f - 1.8f, 1.f + (i / 4) * 1.5f, (i % 3) * 0.4f };
+				data.m_initialRotation = { i * 0.3f, i * 0.7f, i * 1.1f };
+				world.AddBody((i & 1) ? (PhysicsShape*)&sphere : &box, data);
+			}
+			assert(world.GetStateHash() == worlds[0].GetStateHash());
+		}
+		for (int step = 0; step < 120; step++)
+		{
+			worlds[0].Update(1.0f / 60.0f);
+			worlds[1].Update(1.0f / 60.0f);
+			assert(worlds[0].GetStateHash() == worlds[1].GetStateHash());
+		}
+#ifdef DETERMINISTIC_MATH
+		// what every compiler and platform has to get, if this changes so does the simulation.  So far only
+		// checked with GCC on x86-64 Linux (with and without FMA), MSVC and Clang still need to confirm it
+		assert(worlds[0].GetStateHash() == 0x289cbe141d071151ull);
+#endif
+
+		PhysicsWorld& world = worlds[1];
+		std::vector<PhysicsHandle> all;
+		world.QueryAABB({ vector3(-100.f), vector3(100.f) }, &all);
+		for (PhysicsHandle handle : all)
+		{
+			world.ApplyImpulse(handle, { 0.f, 0.f, 1e-6f }, world.GetPosition(handle));
+		}
+		world.Update(1.0f / 60.0f);
+		worlds[0].Update(1.0f / 60.0f);
+		assert(worlds[0].GetStateHash() != worlds[1].GetStateHash());
+	}
+
+	// snapshots: rolling back to any of the saved frames and stepping on again retraces the same steps to the bit,
+	// contacts and sleeping included, and a snapshot that doesn't fit the world is turned down
+	{
+		SpherePhysicsShape sphere(0.5f);
+		BoxPhysicsShape box(1.f, 1.f, 1.f);
+		BoxPhysicsShape floorShape(20.f, 20.f, 1.f);
+		StaticPhysicsData floorData;
+		floorData.m_initialPosition = { 0.f, -0.5f, 0.f };
+		StaticPhysicsData data;
+		data.m_gravity = { 0.f, -9.8f, 0.f };
+		data.m_mass = 1.f;
+		data.m_elasticity = 0.2f;
+		data.m_staticFrictionCoeff = 0.5f;
+		data.m_dynamicFrictionCoeff = 0.3f;
+		data.m_inertiaTensor = matrix3(1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f, 0.f, 0.f, 0.f, 1.f / 6.f);
+		data.m_inverseInertiaTensor = data.m_inertiaTensor.inv();
+		data.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+		PhysicsWorld world;
+		world.AddBody(&floorShape, floorData);
+		std::vector<PhysicsHandle> bodies;
+		for (int i = 0; i < 12; i++)
+		{
+			// the balls keep rolling, the boxes drop onto the floor (two onto other boxes) and settle
+			const vector3 boxPosition = (i < 10) ? vector3((i - 2) % 4 * 2.f - 3.f, 0.6f, (i - 2) / 4 * 2.f) : vector3((i - 10) * 2.f - 3.f, 1.7f, 0.f);
+			data.m_initialPosition = (i < 2) ? vector3(5.f + i * 2.f, 0.5f, 0.f) : boxPosition;
+			data.m_initialRotation = { 0.f, i * 0.4f, 0.f };
+			bodies.push_back(world.AddBody((i < 2) ? (PhysicsShape*)&sphere : &box, data));
+			if (i < 2)
+			{
+				world.ApplyImpulse(bodies.back(), { 0.f, 0.f, 1.f }, world.GetPosition(bodies.back()));
+			}
+		}
+
+		// long enough for the boxes to land and go to sleep
+		constexpr int NUM_FRAMES = 240;
+		constexpr int RING_SIZE = 8;
+		PhysicsSnapshotRing ring(RING_SIZE);
+		uint64_t hashes[NUM_FRAMES];
+		for (int frame = 0; frame < NUM_FRAMES; frame++)
+		{
+			ring.Save(world, frame);
+			world.Advance(1.0f / 60.0f);
+			hashes[frame] = world.GetStateHash();
+		}
+		assert(!world.IsSleeping(bodies[0]) && world.IsSleeping(bodies[11]));
+		assert(!ring.Has(NUM_FRAMES - RING_SIZE - 1) && !ring.Restore(&world, NUM_FRAMES - RING_SIZE - 1));
+		for (int back = 1; back <= RING_SIZE; back++)
+		{
+			const int from = NUM_FRAMES - back;
+			assert(ring.Restore(&world, from));
+			for (int frame = from; frame < NUM_FRAMES; frame++)
+			{
+				world.Advance(1.0f / 60.0f);
+				assert(world.GetStateHash() == hashes[frame]);
+			}
+		}
+
+		// and with a different past: knock a box into its neighbours, then undo it
+		PhysicsSnapshot before;
+		world.SaveSnapshot(&before);
+		uint64_t expected[60];
+		for (uint64_t& hash : expected)
+		{
+			world.Advance(1.0f / 60.0f);
+			hash = world.GetStateHash();
+		}
+		assert(world.RestoreSnapshot(before));
+		world.ApplyImpulse(bodies[4], { 8.f, 2.f, 0.f }, world.GetPosition(bodies[4]) + vector3(0.f, 0.3f, 0.f));
+		for (int step = 0; step < 30; step++)
+		{
+			world.Advance(1.0f / 60.0f);
+		}
+		assert(world.GetStateHash() != expected[29]);
+		assert(world.RestoreSnapshot(before));
+		for (uint64_t hash : expected)
+		{
+			world.Advance(1.0f / 60.0f);
+			assert(world.GetStateHash() == hash);
+		}
+		PhysicsWorld other;
+
+		// snapshots belong to one world, with one set of bodies
+		assert(!other.RestoreSnapshot(before));
+		world.RemoveBody(world.AddBody(&sphere, data));
+		assert(!world.RestoreSnapshot(before));
+
+		// not even a new world with the same bodies, built where the one that saved it used to be
+		alignas(PhysicsWorld) unsigned char storage[sizeof(PhysicsWorld)];
+		PhysicsWorld* first = new (storage) PhysicsWorld();
+		first->AddBody(&sphere, data);
+		PhysicsSnapshot saved;
+		first->SaveSnapshot(&saved);
+		first->~PhysicsWorld();
+		PhysicsWorld* second = new (storage) PhysicsWorld();
+		second->AddBody(&sphere, data);
+		assert(!second->RestoreSnapshot(saved));
+		second->~PhysicsWorld();
+	}
+
+	// quickhull: a cube with points inside, on its faces and edges, and repeated, is still just a cube
+	{
+		std::vector<vector3> points;
+		for (int x = -1; x <= 1; x++)
+			for (int y = -1; y <= 1; y++)
+				for (int z = -1; z <= 1; z++)
+				{
+					points.push_back({ (float)x, (float)y, (float)z });
+					points.push_back({ x * 0.5f, y * 0.5f, z * 0.5f });
+				}
+		points.push_back({ 1.f, 1.f, 1.f });
+		ConvexHull hull;
+		assert(PhysUtil_BuildConvexHull(points, &hull));
+		assert(hull.vertices.size() == 8 && hull.faces.size() == 6 && hull.triangles.size() == 36);
+		for (const ConvexHullFace& face : hull.faces)
+		{
+			assert(face.numIndices == 4 && FloatEquals(face.distance, 1.0f));
+		}
+		for (unsigned int v = 0; v < 8; v++)
+		{
+			assert(hull.adjacencyStart[v + 1] - hull.adjacencyStart[v] == 3);
+		}
+
+		// flat input has no hull
+		std::vector<vector3> flat = { { 0.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 1.f, 1.f, 0.f } };
+		assert(!PhysUtil_BuildConvexHull(flat, &hull) && hull.vertices.empty());
+	}
+	// random clouds: everything inside every face, a closed surface (V - E + F = 2), and the cooked
+	// shape's support matches a scan over every input point
+	{
+		unsigned int seed = 4242;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24) * 2.0f - 1.0f; };
+		for (int cloud = 0; cloud < 5; cloud++)
+		{
+			MeshPhysicsShape shape;
+			for (int i = 0; i < 500; i++)
+			{
+				vector3 v = { random(), random(), random() };
+				if (cloud & 1)
+				{
+					v = v.normalize() * (2.0f + cloud); // all on a sphere, nearly every point is a corner
+				}
+				shape.m_mesh.m_vertexPos.push_back(v);
+			}
+			ConvexHull hull;
+			assert(PhysUtil_BuildConvexHull(shape.m_mesh.m_vertexPos, &hull));
+			size_t numEdges = 0;
+			for (const ConvexHullFace& face : hull.faces)
+			{
+				numEdges += face.numIndices;
+				for (const vector3& p : shape.m_mesh.m_vertexPos)
+				{
+					assert(face.normal.dot(p) - face.distance < 0.0001f);
+				}
+			}
+			assert(hull.vertices.size() + hull.faces.size() == numEdges / 2 + 2);
+
+			shape.CookHull();
+			assert(shape.GetSupportMesh().m_vertexPos.size() == hull.vertices.size());
+			int hint = -1;
+			for (int i = 0; i < 200; i++)
+			{
+				const vector3 dir = { random(), random(), random() };
+				const vector3 cooked = shape.GetPointFurthestInDirection(dir, matrix4(), true, &hint);
+				const vector3 raw = PhysUtil_GetPointFurthestInDirection(shape.m_mesh.m_vertexPos, dir, matrix4(), nullptr);
+				assert(FloatEquals(cooked.dot(dir), raw.dot(dir)));
+			}
+		}
+	}
+
+	// every SIMD support kernel should pick exactly the same vertex as the scalar one, ties included
+	{
+		Mesh mesh;
+		unsigned int seed = 12345;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24) * 2.0f - 1.0f; };
+		for (int i = 0; i < 37; i++)
+		{
+			vector3 v = { random(), random(), random() };
+			mesh.m_vertexPos.push_back(v);
+			mesh.m_vertexPos.push_back(v); // duplicates to force ties
+		}
+		mesh.m_vertexPos.push_back({ 1.0f, 0.0f, 0.0f });
+		mesh.m_vertexPos.push_back({ 1.0f, 0.5f, 0.0f });
+		mesh.BuildSoA();
+
+		const float* x = &mesh.m_vertexSoA[0];
+		const float* y = x + mesh.m_soaStride;
+		const float* z = y + mesh.m_soaStride;
+		const SIMD_LEVEL supported = PhysUtil_GetSupportedSimdLevel();
+		for (int i = 0; i < 1000; i++)
+		{
+			const vector3 dir = (i == 0) ? vector3(1.0f, 0.0f, 0.0f) : vector3(random(), random(), random());
+			PhysUtil_SetSimdLevel(SIMD_LEVEL_SCALAR);
+			const int expected = PhysUtil_GetIndexFurthestInDirectionSoA(x, y, z, mesh.m_soaStride, dir);
+			int aos_index = -1;
+			PhysUtil_GetPointFurthestInDirection(mesh.m_vertexPos, dir, matrix4(), &aos_index);
+			assert(expected == aos_index);
+			for (int level = SIMD_LEVEL_SSE; level <= supported; level++)
+			{
+				PhysUtil_SetSimdLevel((SIMD_LEVEL)level);
+				assert(PhysUtil_GetIndexFurthestInDirectionSoA(x, y, z, mesh.m_soaStride, dir) == expected);
+			}
+		}
+		PhysUtil_SetSimdLevel(supported);
+	}
+
+	// hill climbing over a convex mesh's adjacency finds as far a vertex as scanning all of them,
+	// from any starting vertex and under any transform (a random rotation, translation and scale)
+	{
+		unsigned int seed = 2468;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24) * 2.0f - 1.0f; };
+		MeshPhysicsShape shape;
+		shape.CreateSphere(2.0f);
+		const Mesh& mesh = shape.GetSupportMesh();
+		assert(mesh.HasAdjacency());
+		for (int t = 0; t < 20; t++)
+		{
+			matrix4 world;
+			world.rotate(vector3(random(), random(), random()) * PI);
+			world.scale(1.5f + random(), 1.5f + random(), 1.5f + random());
+			world.translate(vector3(random(), random(), random()) * 10.f);
+			int hint = -1;
+			for (int i = 0; i < 100; i++)
+			{
+				const vector3 dir = { random(), random(), random() };
+				float bruteForce = -FLT_MAX;
+				for (const vector3& p : mesh.m_vertexPos)
+				{
+					bruteForce = max(bruteForce, dir.dot(world * p));
+				}
+				int start = int((random() * 0.5f + 0.5f) * (mesh.m_vertexPos.size() - 1));
+				const vector3 climbed = PhysUtil_GetPointFurthestInDirectionHillClimb(mesh.m_vertexPos, mesh.m_adjacencyStart, mesh.m_adjacency, dir, world, &start);
+				assert(FloatEquals(climbed.dot(dir), bruteForce, 0.0001f));
+				assert(vector3::Equals(climbed, world * mesh.m_vertexPos[start], 0.0001f));
+				const vector3 warmStarted = shape.GetPointFurthestInDirection(dir, world, true, &hint);
+				assert(FloatEquals(warmStarted.dot(dir), bruteForce, 0.0001f));
+			}
+		}
+	}
+
+	// scanning in local space (turning the direction into the mesh's space once) picks the same vertex
+	// as transforming every vertex into world space and comparing there
+	{
+		unsigned int seed = 13579;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24) * 2.0f - 1.0f; };
+		Mesh mesh;
+		for (int i = 0; i < 100; i++)
+		{
+			mesh.m_vertexPos.push_back({ random() * 3.f, random(), random() * 2.f });
+		}
+		mesh.BuildSoA();
+		for (int t = 0; t < 20; t++)
+		{
+			matrix4 world;
+			world.rotate(vector3(random(), random(), random()) * PI);
+			world.scale(1.5f + random(), 1.5f + random(), 1.5f + random());
+			world.translate(vector3(random(), random(), random()) * 10.f);
+			for (int i = 0; i < 100; i++)
+			{
+				const vector3 dir = { random(), random(), random() };
+				float bruteForce = -FLT_MAX;
+				for (const vector3& p : mesh.m_vertexPos)
+				{
+					bruteForce = max(bruteForce, dir.dot(world * p));
+				}
+				int index = -1;
+				const vector3 scanned = PhysUtil_GetPointFurthestInDirection(mesh.m_vertexPos, dir, world, &index);
+				assert(FloatEquals(scanned.dot(dir), bruteForce, 0.0001f));
+				assert(vector3::Equals(scanned, world * mesh.m_vertexPos[index], 0.0001f));
+				const vector3 scannedSoA = PhysUtil_GetPointFurthestInDirection(mesh, dir, world, nullptr);
+				assert(FloatEquals(scannedSoA.dot(dir), bruteForce, 0.0001f));
+			}
+		}
+	}
+
+	// the batch integrator gives the same bits at every SIMD level, so a world stepped with the widest kernel
+	// stays exactly in step with one stepped with the scalar one (37 bodies, so every kernel has leftovers)
+	{
+		unsigned int seed = 12345;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24) * 2.0f - 1.0f; };
+		SpherePhysicsShape sphere(0.5f);
+		BoxPhysicsShape floorShape(40.f, 40.f, 1.f);
+		StaticPhysicsData floorData;
+		floorData.m_initialPosition = { 0.f, -0.5f, 0.f };
+		StaticPhysicsData data;
+		data.m_gravity = { 0.f, -9.8f, 0.f };
+		data.m_elasticity = 0.3f;
+		data.m_staticFrictionCoeff = 0.4f;
+		data.m_dynamicFrictionCoeff = 0.3f;
+		data.m_collisionResponseType = COLLISION_RESPONSE_IMPULSE;
+
+		PhysicsWorld worlds[2];
+		std::vector<PhysicsHandle> handles[2];
+		std::vector<vector3> initialPositions;
+		for (PhysicsWorld& world : worlds)
+		{
+			world.AddBody(&floorShape, floorData);
+		}
+		for (int i = 0; i < 37; i++)
+		{
+			data.m_mass = (i % 9 == 0) ? 0.0f : 1.0f + random() * 0.5f;
+			const float inertia = 0.4f * data.m_mass * 0.25f;
+			data.m_inertiaTensor = matrix3(inertia, inertia * 0.1f, 0.f, inertia * 0.1f, inertia * 1.5f, inertia * 0.05f, 0.f, inertia * 0.05f, inertia);
+			data.m_inverseInertiaTensor = data.m_inertiaTensor.inv();
+			data.m_initialPosition = { random() * 5.f, 1.f + (random() + 1.f) * 5.f, random() * 5.f };
+			data.m_initialRotation = { random(), random(), random() };
+			initialPositions.push_back(data.m_initialPosition);
+			const vector3 impulse = vector3(random(), random(), random()) * 2.f;
+			const vector3 offset = vector3(random(), random(), random()) * 0.5f;
+			for (int w = 0; w < 2; w++)
+			{
+				handles[w].push_back(worlds[w].AddBody(&sphere, data));
+				worlds[w].ApplyImpulse(handles[w].back(), impulse, data.m_initialPosition + offset);
+			}
+		}
+
+		const SIMD_LEVEL supported = PhysUtil_GetSupportedSimdLevel();
+		for (int step = 0; step < 120; step++)
+		{
+			PhysUtil_SetSimdLevel(SIMD_LEVEL_SCALAR);
+			worlds[0].Update(1.0f / 60.0f);
+			PhysUtil_SetSimdLevel(supported);
+			worlds[1].Update(1.0f / 60.0f);
+		}
+		for (size_t i = 0; i < handles[0].size(); i++)
+		{
+			const vector3 state[2][3] =
+			{
+				{ worlds[0].GetPosition(handles[0][i]), worlds[0].GetLinearVelocity(handles[0][i]), worlds[0].GetAngularVelocity(handles[0][i]) },
+				{ worlds[1].GetPosition(handles[1][i]), worlds[1].GetLinearVelocity(handles[1][i]), worlds[1].GetAngularVelocity(handles[1][i]) },
+			};
+			const quaternion rotation[2] = { worlds[0].GetRotation(handles[0][i]), worlds[1].GetRotation(handles[1][i]) };
+			assert(memcmp(state[0], state[1], sizeof(state[0])) == 0 && memcmp(&rotation[0], &rotation[1], sizeof(quaternion)) == 0);
+			assert((state[0][0] == initialPositions[i]) == (i % 9 == 0)); // only the massless ones stayed put
+		}
+	}
+
+	// welding: an icosphere's shared corners collapse back to 162 vertices, and with an epsilon set anything
+	// within it welds (across cell boundaries too) and nothing further away does
+	{
+		MeshPhysicsShape sphere;
+		sphere.CreateSphere(1.0f);
+		const Mesh& mesh = sphere.m_mesh;
+		assert(mesh.m_vertexPos.size() == 162);
+		assert(mesh.m_indices.size() == 320 * 3);
+		for (int i = 0; i < (int)mesh.m_vertexPos.size(); i++)
+		{
+			for (int j = i + 1; j < (int)mesh.m_vertexPos.size(); j++)
+			{
+				assert((mesh.m_vertexPos[i] - mesh.m_vertexPos[j]).magnitude() > MESH_WELD_EPSILON);
+			}
+		}
+
+		Mesh welded;
+		welded.SetWeldEpsilon(MESH_WELD_EPSILON);
+		const vector3 n = { 0.0f, 1.0f, 0.0f };
+		const vector3 p = { 4.0f * MESH_WELD_EPSILON, 0.0f, 1.0f }; // right on a cell boundary
+		welded.AddVertex(p, n);
+		welded.AddVertex(p - vector3(MESH_WELD_EPSILON * 0.5f, 0.0f, 0.0f), n);
+		welded.AddVertex(p + vector3(0.0f, MESH_WELD_EPSILON * 0.5f, -MESH_WELD_EPSILON * 0.5f), n);
+		welded.AddVertex(p + vector3(MESH_WELD_EPSILON * 3.0f, 0.0f, 0.0f), n);
+		assert(welded.m_vertexPos.size() == 2);
+		assert(welded.m_indices[0] == 0 && welded.m_indices[1] == 0 && welded.m_indices[2] == 0 && welded.m_indices[3] == 1);
+
+		// vertices pushed straight in still get welded against
+		welded.m_vertexPos.push_back({ 5.0f, 5.0f, 5.0f });
+		welded.m_vertexNormals.push_back(n);
+		welded.AddVertex({ 5.0f, 5.0f, 5.0f }, n);
+		assert(welded.m_vertexPos.size() == 3 && welded.m_indices.back() == 2);
+
+		// and so do ones moved there, while where they used to be is free again
+		welded.m_vertexPos[2] = { 7.0f, 5.0f, 5.0f };
+		welded.AddVertex({ 7.0f, 5.0f, 5.0f }, n);
+		assert(welded.m_vertexPos.size() == 3 && welded.m_indices.back() == 2);
+		welded.AddVertex({ 5.0f, 5.0f, 5.0f }, n);
+		assert(welded.m_vertexPos.size() == 4 && welded.m_indices.back() == 3);
+
+		// without one only exact copies weld
+		Mesh exact;
+		exact.AddVertex(p, n);
+		exact.AddVertex(p, n);
+		exact.AddVertex(p + vector3(MESH_WELD_EPSILON * 0.5f, 0.0f, 0.0f), n);
+		assert(exact.m_vertexPos.size() == 2 && exact.m_indices[1] == 0);
+
+		// the bulk path gives the same mesh as adding one vertex at a time
+		std::vector<vector3> positions;
+		std::vector<unsigned int> indices;
+		for (int i = 0; i < (int)mesh.m_indices.size(); i++)
+		{
+			positions.push_back(mesh.m_vertexPos[mesh.m_indices[i]]);
+			indices.push_back(i);
+		}
+		Mesh one, bulk;
+		for (const vector3& v : positions)
+		{
+			one.AddVertex(v, v);
+		}
+		bulk.Reserve((int)positions.size(), (int)indices.size());
+		bulk.AppendTriangles(positions.data(), positions.data(), (int)positions.size(), indices.data(), (int)indices.size());
+		assert(one.m_vertexPos.size() == 162 && one.m_vertexPos == bulk.m_vertexPos && one.m_indices == bulk.m_indices && one.m_indices == mesh.m_indices);
+	}
+
+	// the ranges are never bigger than grainSize, including when a call from inside a job runs inline
+	{
+		struct Ranges
+		{
+			std::atomic<int> covered;
+			std::atomic<int> largest;
+
+			static void Inner(int begin, int end, int, void* userData)
+			{
+				Ranges* r = (Ranges*)userData;
+				r->covered += end - begin;
+				int largest = r->largest;
+				while (end - begin > largest && !r->largest.compare_exchange_weak(largest, end - begin)) {}
+			}
+			static void Outer(int begin, int end, int, void* userData)
+			{
+				for (int i = begin; i < end; i++)
+				{
+					WorkerPool_ParallelFor(100, 7, Inner, userData);
+				}
+			}
+		};
+		Ranges ranges;
+		ranges.covered = 0;
+		ranges.largest = 0;
+		WorkerPool_ParallelFor(100, 7, Ranges::Inner, &ranges);
+		assert(ranges.covered == 100 && ranges.largest == 7);
+		WorkerPool_ParallelFor(4, 1, Ranges::Outer, &ranges);
+		assert(ranges.covered == 500 && ranges.largest == 7);
+	}
+}
@@ -79,7 +79,7 @@ public:
     }
     float    magnitude(void)        const
     {
-        return sqrt(x * x + y * y + z * z + w * w);
+        return Math_Sqrt(x * x + y * y + z * z + w * w);
     }
     vector4  normalize(void)        const
     {
@@ -206,7 +206,7 @@ public:
     }
     float    magnitude(void)        const
     {
-        return sqrt(magnitude_sq());
+        return Math_Sqrt(magnitude_sq());
     }
     vector3  normalize(void)        const
     {
@@ -0,0 +1,179 @@
+#include "worker_pool.h"
+#include "lib.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+struct WorkerPoolJob
+{
+	WorkerPoolFn     fn = nullptr;
+	void*            userData = nullptr;
+	int              count = 0;
+	int              grainSize = 1;
+	std::atomic<int> nextBegin;
+	std::atomic<int> chunksRemaining;
+};
+
+static std::vector<std::thread> s_threads;
+static std::mutex               s_mutex;
+static std::condition_variable  s_wakeWorkers;
+static std::condition_variable  s_jobDone;
+static std::mutex               s_callMutex;        // one ParallelFor at a time
+static WorkerPoolJob            s_job;
+static unsigned int             s_jobGeneration = 0; // bumped for every job so sleeping workers know there is new work
+static int                      s_activeWorkers = 0; // workers that may still be reading s_job
+static bool                     s_quit = false;
+static std::atomic<int>         s_numThreads(1);    // s_threads plus the caller, read without taking any lock
+static std::once_flag           s_autoStart;
+static thread_local int         s_threadIndex = -1; // -1 unless this thread is inside a job
+
+// joins the workers at exit, before the statics above are destroyed under them (std::thread
+// terminates the program if it's destroyed while still joinable)
+static struct WorkerPoolExitGuard
+{
+	~WorkerPoolExitGuard() { WorkerPool_Shutdown(); }
+} s_exitGuard;
+
+//******************************************************************************
+static void RunChunks(WorkerPoolJob& job, int threadIndex)
+{
+	for (;;)
+	{
+		const int begin = job.nextBegin.fetch_add(job.grainSize);
+		if (begin >= job.count)
+		{
+			return;
+		}
+		const int end = min(begin + job.grainSize, job.count);
+		job.fn(begin, end, threadIndex, job.userData);
+
+		if (job.chunksRemaining.fetch_sub(1) == 1)
+		{
+			std::lock_guard<std::mutex> lock(s_mutex);
+			s_jobDone.notify_all();
+		}
+	}
+}
+//******************************************************************************
+static void WorkerMain(int threadIndex)
+{
+	s_threadIndex = threadIndex;
+	unsigned int seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(s_mutex);
+			s_wakeWorkers.wait(lock, [&seenGeneration]() { return s_quit || s_jobGeneration != seenGeneration; });
+			if (s_quit)
+			{
+				return;
+			}
+			seenGeneration = s_jobGeneration;
+			++s_activeWorkers;
+		}
+		RunChunks(s_job, threadIndex);
+		{
+			std::lock_guard<std::mutex> lock(s_mutex);
+			--s_activeWorkers;
+			s_jobDone.notify_all();
+		}
+	}
+}
+//******************************************************************************
+void WorkerPool_Init(int numThreads)
+{
+	std::lock_guard<std::mutex> callLock(s_callMutex);
+	if (!s_threads.empty())
+	{
+		return;
+	}
+
+	if (numThreads <= 0)
+	{
+		numThreads = (int)std::thread::hardware_concurrency();
+	}
+	numThreads = max(numThreads, 1);
+
+	s_quit = false;
+	s_threads.reserve(numThreads - 1);
+	for (int i = 1; i < numThreads; i++) // the calling thread is thread 0
+	{
+		s_threads.emplace_back(WorkerMain, i);
+	}
+	s_numThreads = numThreads;
+}
+//******************************************************************************
+// starts the default pool the first time it's needed, unless WorkerPool_Init already has
+static void AutoStart()
+{
+	std::call_once(s_autoStart, []() { WorkerPool_Init(); });
+}
+//******************************************************************************
+void WorkerPool_Shutdown()
+{
+	std::lock_guard<std::mutex> callLock(s_callMutex);
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_quit = true;
+	}
+	s_wakeWorkers.notify_all();
+	for (std::thread& t : s_threads)
+	{
+		t.join();
+	}
+	s_threads.clear();
+	s_numThreads = 1;
+}
+//******************************************************************************
+int WorkerPool_GetNumThreads()
+{
+	AutoStart();
+	return s_numThreads;
+}
+//******************************************************************************
+void WorkerPool_ParallelFor(int count, int grainSize, WorkerPoolFn fn, void* userData)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	grainSize = max(grainSize, 1);
+
+	AutoStart();
+	if (s_threadIndex >= 0 || count <= grainSize || s_numThreads == 1)
+	{
+		// already inside a job (the pool is busy with our caller), not worth waking anyone up, or no one to wake.
+		// Same chunks the workers would have had, fn can count on never seeing more than grainSize at once
+		const int threadIndex = max(s_threadIndex, 0);
+		for (int begin = 0; begin < count; begin += grainSize)
+		{
+			fn(begin, min(begin + grainSize, count), threadIndex, userData);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> callLock(s_callMutex);
+	{
+		// a worker that woke up late for the last job could still be looking at it
+		std::unique_lock<std::mutex> lock(s_mutex);
+		s_jobDone.wait(lock, []() { return s_activeWorkers == 0; });
+
+		s_job.fn = fn;
+		s_job.userData = userData;
+		s_job.count = count;
+		s_job.grainSize = grainSize;
+		s_job.nextBegin = 0;
+		s_job.chunksRemaining = (count + grainSize - 1) / grainSize;
+		++s_jobGeneration;
+	}
+	s_wakeWorkers.notify_all();
+
+	// help out, then wait for whatever the workers are still chewing on
+	s_threadIndex = 0;
+	RunChunks(s_job, 0);
+	s_threadIndex = -1;
+	std::unique_lock<std::mutex> lock(s_mutex);
+	s_jobDone.wait(lock, []() { return s_job.chunksRemaining.load() == 0; });
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+//******************************************************************************
+// WorkerPool - a handful of threads that split loops with the calling thread
+//   Started on first use with one thread per core (the caller counts as one).
+//   Work is handed out in chunks from a shared counter, so there is no per-call
+//   allocation and results only depend on the index, not which thread ran it.
+//******************************************************************************
+
+// fn is called with [begin, end) ranges of at most grainSize until [0, count) is covered.
+// Blocks until every range is done.  Calls made from inside a worker run inline on that worker.
+typedef void (*WorkerPoolFn)(int begin, int end, int threadIndex, void* userData);
+void WorkerPool_ParallelFor(int count, int grainSize, WorkerPoolFn fn, void* userData);
+
+// Number of threads that can be inside fn at once (threadIndex is always less than this),
+// use it to size per-thread scratch memory.
+int  WorkerPool_GetNumThreads();
+
+// Optional: pick the number of threads before the first ParallelFor (0 = one per core), or
+// stop the threads.  After a shutdown everything runs on the calling thread until the next
+// Init.  The threads are shut down at exit if nothing else does it first.
+void WorkerPool_Init(int numThreads = 0);
+void WorkerPool_Shutdown();
@@ -132,6 +132,7 @@ void HandleInputs_Standalone(int inputMask)
 // Called before every frame
 //-------------------------------------------------------------------------------------------------
 static std::chrono::steady_clock::time_point s_now;
+static FixedTimestep s_physicsClock(PHYSICS_STEP, PHYSICS_MAX_STEPS);
 void Update(int pause)
 {
     auto start = std::chrono::high_resolution_clock::now();
@@ -140,24 +141,24 @@ void Update(int pause)
 
     if (s_standaloneMode)
     {
-        constexpr float MAX_TICK = 1.0f / 30.0f; // max tick 30fps
-        if (dt > MAX_TICK)
-        {
-            dt = MAX_TICK;
-        }
-
         if (!pause)
         {
             HandleInputs_Standalone(s_inputMask);
             s_inputMask = 0;
-            World::Get()->Update(dt);
+            const int steps = s_physicsClock.Advance(dt / 1000.f);
+            for (int i = 0; i < steps; i++)
+            {
+                World::Get()->Update(PHYSICS_STEP);
+            }
         }
     }
     else
     {
         if (s_inputMask)
         {
+            // meant for the tick the server is on as the key goes down, it'll be simulated by the time this gets there and the server rolls back
             ServerInputPacket inputPacket;
+            inputPacket.PutFrameNum(World_C_GetServerFrame());
             inputPacket.PutMask(s_inputMask);
             inputPacket.Finalize();
             Net_C_Send(&inputPacket);
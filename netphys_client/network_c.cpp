@@ -296,6 +296,10 @@ static bool ProcessPacket(Packet* p)
         case CLIENT_NEW_CONNECTION_ID:
         {
             ClientNewConnection* msg = (ClientNewConnection*)(p);
+            if (s_state == CONNECTION_STATE_CREATED)
+            {
+                World_C_SetRoundTrip(GetTickCount() - s_connectionStateTime);
+            }
             FrameNum frameID = World_C_HandleNewConnection(msg);
             s_state = CONNECTION_STATE_SENT_ACK;
             s_connectionAckServerFrame = frameID;
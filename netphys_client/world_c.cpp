@@ -21,6 +21,8 @@ static double s_lastTime = 0.0f;
 static double s_clientTime = 0.0f;
 static double s_clientTimeToServerTime = 0.0f;
 static DWORD s_connectionStartTime = 0;
+static DWORD s_latestFrameReceivedTime = 0; // GetTickCount() when the newest server frame came in
+static unsigned int s_roundTripMs = 0;
 constexpr DWORD TIME_DELAY_MS = 100;
 
 
@@ -99,6 +101,7 @@ FrameNum World_C_HandleNewConnection(ClientNewConnection* msg)
 
 	s_clientTimeToServerTime = newFrame.timeMs;
 	s_connectionStartTime = GetTickCount();
+	s_latestFrameReceivedTime = s_connectionStartTime;
 
 	return newFrame.id;
 }
@@ -131,10 +134,31 @@ FrameNum World_C_HandleUpdate(ClientWorldStateUpdatePacket* msg)
 		newFrame.objects.push_back(*object);
 	}
 	s_serverFrames.push_back(newFrame);
+	s_latestFrameReceivedTime = GetTickCount();
 
 	return newFrame.id;
 }
 
+// measured from the first new connection message going out to the server's answer
+void World_C_SetRoundTrip(unsigned int roundTripMs)
+{
+	s_roundTripMs = roundTripMs;
+}
+
+// the tick the server is on right now, going by a clock synced to the newest server frame plus half
+// the round trip it took to get here.  0 before we've heard from the server
+FrameNum World_C_GetServerFrame()
+{
+	if (!s_serverFrames.size())
+	{
+		return 0;
+	}
+	const CommandFrame& latest = s_serverFrames.back();
+	const double serverTime = latest.timeMs + (GetTickCount() - s_latestFrameReceivedTime) + s_roundTripMs / 2.0;
+	const double ticksSince = (serverTime - latest.timeMs) / (PHYSICS_STEP * 1000.0);
+	return latest.id + (FrameNum)ticksSince;
+}
+
 static double GetNextServerTime(float dt)
 {
 	double nextClientTime = s_clientTime + dt;
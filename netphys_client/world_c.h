@@ -4,6 +4,8 @@
 
 FrameNum World_C_HandleNewConnection(ClientNewConnection* msg);
 FrameNum World_C_HandleUpdate(ClientWorldStateUpdatePacket* msg);
+void World_C_SetRoundTrip(unsigned int roundTripMs);
+FrameNum World_C_GetServerFrame();
 
 void World_C_Init();
 void World_C_Deinit();
@@ -62,6 +62,8 @@ static constexpr float GRAVITY = 9.8f; // m/s^2
 static constexpr float BOX_SIZE = 0.5f;
 static constexpr float DENSITY = 5.0f;
 static constexpr float TOTAL_MASS = DENSITY * BOX_SIZE * BOX_SIZE * BOX_SIZE;
+static constexpr float PHYSICS_STEP = 1.0f / 60.0f; // World::Update is always stepped by this much (see FixedTimestep)
+static constexpr int   PHYSICS_MAX_STEPS = 4;       // per frame, a frame that needs more drops the rest
 
 //
 // Packets
@@ -201,6 +203,9 @@ struct ServerInputPacket : public Packet
 {
     ServerInputPacket() : Packet(SERVER_INPUT_PACKET_ID) {}
 
+    // the server tick the input goes in, if that's already been simulated the server rolls back to it
+    void PutFrameNum(FrameNum f) { data.PushUint(f); }
     void PutMask(FrameNum f) { data.PushInt(f); }
+    FrameNum GetFrameNum() { return data.GetUint(); }
     int GetMask() { return data.GetInt(); }
 };
@@ -75,6 +75,45 @@ private:
     bool  m_finalized = false;
 };
 //******************************************************************************
+// Fixed timestep clock: feed it each frame's real time and it says how many
+// steps of exactly Step() to simulate.  It won't ask for more than maxSteps in
+// one frame, anything past that is dropped so a slow frame can't snowball into
+// slower ones.  GetAlpha() is how far into the next step the leftover time is,
+// for drawing between the last two steps.
+//******************************************************************************
+class FixedTimestep
+{
+public:
+    FixedTimestep(float step, int maxSteps) : m_step(step), m_maxSteps(maxSteps) {}
+
+    int Advance(float dt)
+    {
+        m_accumulator += dt;
+        int steps = (int)(m_accumulator / m_step);
+        if (steps > m_maxSteps)
+        {
+            const double dropped = double(steps - m_maxSteps) * m_step;
+            m_droppedTime += dropped;
+            m_accumulator -= dropped;
+            steps = m_maxSteps;
+        }
+        m_accumulator -= double(steps) * m_step;
+        if (m_accumulator < 0.0) // the division rounded up
+        {
+            m_accumulator = 0.0;
+        }
+        return steps;
+    }
+    float  GetStep() const        { return m_step; }
+    float  GetAlpha() const       { return float(m_accumulator / m_step); }
+    double GetDroppedTime() const { return m_droppedTime; }
+private:
+    float  m_step;
+    int    m_maxSteps;
+    double m_accumulator = 0.0;
+    double m_droppedTime = 0.0;
+};
+//******************************************************************************
 template <class T>
 class CyclicalList
 {
@@ -21,6 +21,8 @@ static const char* LISTEN_ADDR = "127.0.0.1";
 
 static SOCKET s_listenSocket = INVALID_SOCKET;
 static constexpr DWORD STATE_TIMEOUT = 2000;
+static constexpr float ROUND_TRIP_SMOOTHING = 0.1f;  // how much of each new round trip sample goes into the estimate
+static constexpr int INPUT_LATE_SLACK_FRAMES = 2;    // jitter on top of the round trip before a late input gets clamped
 
 //-------------------------------------------------------------------------------------------------
 static std::vector<Connection*> s_connections;
@@ -135,6 +137,16 @@ void Connection::Update()
     Send(&msg);
 }
 //-------------------------------------------------------------------------------------------------
+// How many ticks late an input from this client can honestly be, a stamp older than that gets clamped
+int Connection::GetMaxInputLateFrames() const
+{
+    if (m_roundTripFrames < 0.f)
+    {
+        return -1;
+    }
+    return (int)ceilf(m_roundTripFrames) + INPUT_LATE_SLACK_FRAMES;
+}
+//-------------------------------------------------------------------------------------------------
 bool Connection::Write()
 {
     if (!m_bytesToSend)
@@ -223,6 +235,12 @@ bool Connection::ProcessPacket(Packet* p)
             ServerWorldUpdateAck* msg = (ServerWorldUpdateAck*)(p);
             FrameNum frameNum = msg->GetFrameNum();
             LOG("Player " F_GUID " acked update at frame=%d", VA_GUID(m_owner->GetGUID()), frameNum);
+            if (frameNum > m_lastAckedFrame)
+            {
+                // the update went out right after its tick was simulated
+                const float roundTrip = float(World_S_GetFrame() - 1 - frameNum);
+                m_roundTripFrames = m_roundTripFrames < 0.f ? roundTrip : m_roundTripFrames + (roundTrip - m_roundTripFrames) * ROUND_TRIP_SMOOTHING;
+            }
             m_lastAckedFrame = frameNum;
             return true;
         }
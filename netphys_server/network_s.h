@@ -36,6 +36,7 @@ struct Connection
     void AddRecvBytes(char* data, int length);
 
     void Send(struct Packet* p);
+    int GetMaxInputLateFrames() const;
 
 private:
     class Player_S* m_owner;
@@ -53,6 +54,7 @@ private:
     void SendNewConnection();
     bool ProcessPacket(struct Packet* p);
     FrameNum m_lastAckedFrame = 0;
+    float m_roundTripFrames = -1.f; // smoothed ticks from sending a world update to its ack, < 0 until the first one
 };
 
 //bool Net_S_SendToAllClients(char* bytes, int numBytes);
\ No newline at end of file
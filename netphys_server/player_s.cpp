@@ -3,6 +3,7 @@
 #include "../netphys_common/log.h"
 #include "../netphys_common/world.h"
 #include "network_s.h"
+#include "world_s.h"
 
 //-------------------------------------------------------------------------------------------------
 bool Player_S::ProcessPacket(Packet* p)
@@ -12,8 +13,9 @@ bool Player_S::ProcessPacket(Packet* p)
         case SERVER_INPUT_PACKET_ID:
         {
             ServerInputPacket* msg = (ServerInputPacket*)(p);
+            FrameNum frame = msg->GetFrameNum();
             int inputMask = msg->GetMask();
-            HandleInputs(inputMask);
+            HandleInputs(frame, inputMask);
             return true;
         }
         break;
@@ -21,11 +23,13 @@ bool Player_S::ProcessPacket(Packet* p)
     return false; // didn't handle the packet
 }
 //-------------------------------------------------------------------------------------------------
-void Player_S::HandleInputs(int inputMask)
+void Player_S::HandleInputs(FrameNum frame, int inputMask)
 {
+    // creating and destroying bodies can't be taken back, those happen now and nothing before can be resimulated
     if (inputMask & INPUT_RESET_WORLD)
     {
         World::Get()->Reset();
+        World_S_ResetHistory();
         ClientHandleWorldStateResetPacket p;
         p.Finalize();
         m_connection->Send(&p);
@@ -42,7 +46,8 @@ void Player_S::HandleInputs(int inputMask)
             dBodySetMass(m_bodyID, &mass);
             m_geomID = World::Get()->CreateSphere(PLAYER_SIZE);
             dGeomSetBody(m_geomID, m_bodyID);
+            World_S_ResetHistory();
         }
     }
-    Player::HandleInputsInternal(m_bodyID, inputMask);
+    World_S_QueueInput(GetGUID(), frame, inputMask, m_connection->GetMaxInputLateFrames());
 }
\ No newline at end of file
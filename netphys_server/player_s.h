@@ -18,7 +18,7 @@ public:
 	bool ProcessPacket(Packet* p);
 
 private:
-	void HandleInputs(int inputMask);
+	void HandleInputs(FrameNum frame, int inputMask);
 
 public:
 	virtual dBodyID GetBodyID() const override { return m_bodyID; }
@@ -17,6 +17,7 @@ static constexpr DWORD TICK_RATE = 100; // milliseconds
 static bool s_running = true;
 static std::chrono::steady_clock::time_point s_startTime;
 static std::chrono::steady_clock::time_point s_now;
+static FixedTimestep s_physicsClock(PHYSICS_STEP, PHYSICS_MAX_STEPS);
 
 //-------------------------------------------------------------------------------------------------
 // main
@@ -31,6 +32,7 @@ int main(int argc, char* argv)
     Net_S_Init();
 
     World::Get()->Start();
+    World_S_ResetHistory();
 
     s_startTime = std::chrono::high_resolution_clock::now();
     s_now = s_startTime;
@@ -45,8 +47,12 @@ int main(int argc, char* argv)
         
         // do updates
         Net_S_Update();
-        World_S_Update(now);
-        World::Get()->Update(dt); 
+        World_S_Resimulate(now);
+        const int steps = s_physicsClock.Advance(dt);
+        for (int i = 0; i < steps; i++)
+        {
+            World_S_Update(now - (steps - 1 - i) * PHYSICS_STEP * 1000.0); // space the ticks out, the clients interpolate by time
+        }
         
 
         auto end = std::chrono::high_resolution_clock::now();
@@ -7,8 +7,11 @@
 
 #include "network_s.h"
 #include "objectmanager_s.h"
+#include "../netphys_common/player.h"
 #include <vector>
 
+#include <chrono>
+
 struct CommandFrame
 {
     FrameNum id;
@@ -17,18 +20,74 @@ struct CommandFrame
 };
 
 std::vector<CommandFrame> s_commandFrames;
-static int s_frameCounter = 1;
+static int s_frameCounter = 1; // the next tick to simulate, command frame N is the state after tick N
 static constexpr float MAX_COMMAND_FRAME_TIME = 5000.f; // only keep 5 seconds of command frames
+
+//
+// Rollback
+//
+// Inputs are stamped with the tick they're meant for.  One that shows up after that tick was
+// simulated rewinds the world to the state before it, and the ticks since are simulated again
+// with it included.  Only the last MAX_ROLLBACK_FRAMES ticks can be redone, and no further back
+// than the sender's measured round trip, anything older is moved up to the oldest one that still
+// can be.  0 turns rollback off, late inputs then just go in the next tick.
+//
+// A replay matches the first run to rounding, not bit for bit: dBodySetQuaternion renormalizes
+// the rotation it's given, and ODE keeps state we can't read back (the auto disable countdown).
+//
+static constexpr int MAX_ROLLBACK_FRAMES = 30; // half a second at 60Hz
+static constexpr int ROLLBACK_RING_SIZE = MAX_ROLLBACK_FRAMES + 1;
+
+// everything ODE needs to carry on from where a body was, the command frames only have what the clients draw
+struct RollbackBody
+{
+    dBodyID bodyID;
+    dVector3 pos;
+    dQuaternion rot;
+    dVector3 linearVel;
+    dVector3 angularVel;
+    bool isEnabled;
+};
+struct RollbackState
+{
+    FrameNum id = 0; // the state after this tick
+    unsigned long seed = 0; // dRand's, QuickStep shuffles its constraints with it
+    std::vector<RollbackBody> bodies;
+};
+struct PlayerInput
+{
+    NPGUID player;
+    int inputMask;
+};
+struct FrameInputs
+{
+    FrameNum id = 0;
+    size_t numSimulated = 0; // how many of the inputs the tick was last simulated with, the rest came in late
+    std::vector<PlayerInput> inputs;
+};
+static RollbackState s_rollbackStates[ROLLBACK_RING_SIZE];
+static FrameInputs s_frameInputs[ROLLBACK_RING_SIZE];
+static FrameNum s_historyStart = 1;    // nothing before this tick can be redone (players spawned, world reset)
+static FrameNum s_resimulateFrom = 0;  // the earliest tick a late input went into, 0 if none
+
+struct RollbackStats
+{
+    int rollbacks = 0;
+    int resimulatedTicks = 0;
+    int lateInputs = 0;
+    int clampedToCap = 0;       // older than MAX_ROLLBACK_FRAMES
+    int clampedToRoundTrip = 0; // older than the sender's round trip
+    int clampedToHistory = 0;   // from before s_historyStart, a spawn or world reset since
+    double resimulateMs = 0.0;
+};
+static RollbackStats s_rollbackStats;
+static double s_rollbackStatsTime = 0.0;
+static constexpr double ROLLBACK_STATS_INTERVAL = 1000.0; // ms
+
 //-------------------------------------------------------------------------------------------------
-void World_S_Update(double now)
+static void CaptureCommandFrame(CommandFrame* frame)
 {
-    // TODO: need better/real data structures eventually
-    //
-    // store off the state of the world
-    //
-    CommandFrame newFrame;
-    newFrame.id = s_frameCounter++; // hope this never overflows... at 10ms frames it'll take >400 days don't expect servers to be up that long
-    newFrame.timeMs = now;
+    frame->objects.clear();
     for (Object* obj = ObjectManager_S_GetFirst(); obj != nullptr; obj = ObjectManager_S_GetNext(obj))
     {
         dBodyID bodyID = obj->GetBodyID();
@@ -46,9 +105,219 @@ void World_S_Update(double now)
             frameObj.rot[2] = (float)rot[2];
             frameObj.rot[3] = (float)rot[3];
             frameObj.isEnabled = dBodyIsEnabled(bodyID);
-            newFrame.objects.push_back(frameObj);
+            frame->objects.push_back(frameObj);
+        }
+    }
+}
+//-------------------------------------------------------------------------------------------------
+static void CaptureRollbackState(FrameNum id)
+{
+    RollbackState& state = s_rollbackStates[id % ROLLBACK_RING_SIZE];
+    state.id = id;
+    state.seed = dRandGetSeed();
+    state.bodies.clear(); // keeps its memory, so this doesn't allocate once the ring has filled up
+    for (Object* obj = ObjectManager_S_GetFirst(); obj != nullptr; obj = ObjectManager_S_GetNext(obj))
+    {
+        dBodyID bodyID = obj->GetBodyID();
+        if (bodyID)
+        {
+            RollbackBody body;
+            body.bodyID = bodyID;
+            dCopyVector3(body.pos, dBodyGetPosition(bodyID));
+            dCopyVector4(body.rot, dBodyGetQuaternion(bodyID));
+            dCopyVector3(body.linearVel, dBodyGetLinearVel(bodyID));
+            dCopyVector3(body.angularVel, dBodyGetAngularVel(bodyID));
+            body.isEnabled = dBodyIsEnabled(bodyID) != 0;
+            state.bodies.push_back(body);
+        }
+    }
+}
+//-------------------------------------------------------------------------------------------------
+static bool RestoreRollbackState(FrameNum id)
+{
+    const RollbackState& state = s_rollbackStates[id % ROLLBACK_RING_SIZE];
+    if (state.id != id)
+    {
+        return false;
+    }
+    dRandSetSeed(state.seed);
+    for (const RollbackBody& body : state.bodies)
+    {
+        dBodySetPosition(body.bodyID, body.pos[0], body.pos[1], body.pos[2]);
+        dBodySetQuaternion(body.bodyID, body.rot); // renormalizes, can be off from what was saved in the last bit
+        dBodySetLinearVel(body.bodyID, body.linearVel[0], body.linearVel[1], body.linearVel[2]);
+        dBodySetAngularVel(body.bodyID, body.angularVel[0], body.angularVel[1], body.angularVel[2]);
+        dBodySetForce(body.bodyID, 0, 0, 0);
+        dBodySetTorque(body.bodyID, 0, 0, 0);
+        // ODE doesn't let us read the auto disable countdown, enabling starts it over
+        if (body.isEnabled)
+        {
+            dBodyEnable(body.bodyID);
+        }
+        else
+        {
+            dBodyDisable(body.bodyID);
+        }
+    }
+    return true;
+}
+//-------------------------------------------------------------------------------------------------
+static FrameInputs& GetFrameInputs(FrameNum id)
+{
+    FrameInputs& frameInputs = s_frameInputs[id % ROLLBACK_RING_SIZE];
+    if (frameInputs.id != id)
+    {
+        frameInputs.id = id;
+        frameInputs.numSimulated = 0;
+        frameInputs.inputs.clear();
+    }
+    return frameInputs;
+}
+//-------------------------------------------------------------------------------------------------
+// applies the inputs for the tick and steps the world over it
+static void SimulateTick(FrameNum id)
+{
+    FrameInputs& frameInputs = s_frameInputs[id % ROLLBACK_RING_SIZE];
+    if (frameInputs.id == id)
+    {
+        frameInputs.numSimulated = frameInputs.inputs.size();
+        for (const PlayerInput& input : frameInputs.inputs)
+        {
+            Object* player = ObjectManager_S_LookupObject(input.player);
+            if (player)
+            {
+                Player::HandleInputsInternal(player->GetBodyID(), input.inputMask);
+            }
+        }
+    }
+    World::Get()->Update(PHYSICS_STEP);
+}
+//-------------------------------------------------------------------------------------------------
+// maxLateFrames is how far back the sender could have meant, its round trip in ticks, < 0 if not known yet
+void World_S_QueueInput(const NPGUID& player, FrameNum frame, int inputMask, int maxLateFrames)
+{
+    const FrameNum current = s_frameCounter;
+    if (frame == 0 || frame > current)
+    {
+        frame = current; // unstamped, or claims to be from the future
+    }
+    else if (frame < current)
+    {
+        s_rollbackStats.lateInputs++;
+
+        // whichever limit is tightest is the one it gets clamped to
+        FrameNum oldest = s_historyStart;
+        int* clampedCount = &s_rollbackStats.clampedToHistory;
+        const bool roundTripLimited = maxLateFrames >= 0 && maxLateFrames < MAX_ROLLBACK_FRAMES;
+        const int maxRollback = roundTripLimited ? maxLateFrames : MAX_ROLLBACK_FRAMES;
+        if (current - oldest > (FrameNum)maxRollback)
+        {
+            oldest = current - maxRollback;
+            clampedCount = roundTripLimited ? &s_rollbackStats.clampedToRoundTrip : &s_rollbackStats.clampedToCap;
+        }
+        if (frame < oldest)
+        {
+            (*clampedCount)++;
+            frame = oldest;
+        }
+        if (frame < current && (!s_resimulateFrom || frame < s_resimulateFrom))
+        {
+            s_resimulateFrom = frame;
         }
     }
+    GetFrameInputs(frame).inputs.push_back({ player, inputMask });
+}
+//-------------------------------------------------------------------------------------------------
+// Bodies were created or destroyed, the saved states don't have them so nothing before now can be redone.
+// Late inputs still waiting on a resimulate go in the next tick instead of being dropped.
+void World_S_ResetHistory()
+{
+    if (s_resimulateFrom)
+    {
+        FrameInputs& next = GetFrameInputs(s_frameCounter);
+        size_t insertAt = 0; // ahead of what's already there, they were meant for earlier ticks
+        for (FrameNum id = s_resimulateFrom; id < (FrameNum)s_frameCounter; id++)
+        {
+            FrameInputs& late = s_frameInputs[id % ROLLBACK_RING_SIZE];
+            if (late.id == id && late.inputs.size() > late.numSimulated)
+            {
+                next.inputs.insert(next.inputs.begin() + insertAt, late.inputs.begin() + late.numSimulated, late.inputs.end());
+                insertAt += late.inputs.size() - late.numSimulated;
+                late.inputs.erase(late.inputs.begin() + late.numSimulated, late.inputs.end());
+            }
+        }
+    }
+    s_historyStart = s_frameCounter;
+    s_resimulateFrom = 0;
+    CaptureRollbackState(s_frameCounter - 1);
+}
+//-------------------------------------------------------------------------------------------------
+// The next tick to be simulated
+FrameNum World_S_GetFrame()
+{
+    return s_frameCounter;
+}
+//-------------------------------------------------------------------------------------------------
+// Redoes the ticks since the earliest late input, call once all of this frame's packets are in
+void World_S_Resimulate(double now)
+{
+    if (s_resimulateFrom)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        const FrameNum from = s_resimulateFrom;
+        s_resimulateFrom = 0;
+        if (RestoreRollbackState(from - 1))
+        {
+            const FrameNum firstCommandFrame = s_commandFrames.size() ? s_commandFrames.front().id : s_frameCounter;
+            for (FrameNum id = from; id < (FrameNum)s_frameCounter; id++)
+            {
+                SimulateTick(id);
+                CaptureRollbackState(id);
+                if (id >= firstCommandFrame && id - firstCommandFrame < s_commandFrames.size())
+                {
+                    CaptureCommandFrame(&s_commandFrames[id - firstCommandFrame]);
+                }
+            }
+            s_rollbackStats.rollbacks++;
+            s_rollbackStats.resimulatedTicks += s_frameCounter - from;
+        }
+        else
+        {
+            LOG_ERROR("Lost the state before frame %d, late inputs go in late", from);
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        s_rollbackStats.resimulateMs += (end - start).count() / (1000.0 * 1000.0);
+    }
+
+    if (now - s_rollbackStatsTime >= ROLLBACK_STATS_INTERVAL)
+    {
+        if (s_rollbackStats.lateInputs)
+        {
+            const double seconds = (now - s_rollbackStatsTime) / 1000.0;
+            LOG("Rollback: %.1f resimulated ticks/s (%.2f ms/s) over %d rollbacks, %d late inputs, clamped: %d past the %d tick cap, %d past the sender's round trip, %d from before a spawn or reset",
+                s_rollbackStats.resimulatedTicks / seconds, s_rollbackStats.resimulateMs / seconds, s_rollbackStats.rollbacks,
+                s_rollbackStats.lateInputs, s_rollbackStats.clampedToCap, MAX_ROLLBACK_FRAMES, s_rollbackStats.clampedToRoundTrip,
+                s_rollbackStats.clampedToHistory);
+        }
+        s_rollbackStats = RollbackStats();
+        s_rollbackStatsTime = now;
+    }
+}
+//-------------------------------------------------------------------------------------------------
+// Simulates the next tick and stores off the state of the world
+void World_S_Update(double now)
+{
+    // TODO: need better/real data structures eventually
+    const FrameNum id = s_frameCounter++; // hope this never overflows... at 60Hz ticks it'll take >2 years don't expect servers to be up that long
+    SimulateTick(id);
+    CaptureRollbackState(id);
+
+    CommandFrame newFrame;
+    newFrame.id = id;
+    newFrame.timeMs = now;
+    CaptureCommandFrame(&newFrame);
     s_commandFrames.push_back(newFrame);
 
     //
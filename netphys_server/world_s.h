@@ -1,7 +1,11 @@
 #pragma once
 
+#include "../netphys_common/common.h"
 
-void World_S_HandleInputs(int inputMask);
+void World_S_QueueInput(const NPGUID& player, FrameNum frame, int inputMask, int maxLateFrames);
+void World_S_ResetHistory();
+FrameNum World_S_GetFrame();
+void World_S_Resimulate(double now);
 void World_S_Update(double now);
 
 void World_S_FillNewConnectionMessage(struct ClientNewConnection*);